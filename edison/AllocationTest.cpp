@@ -0,0 +1,173 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AllocationTest.h"
+#include "AllocationTracker.h"
+#include "FlightService.h"
+#include "Simulation.h"
+#include "SimulatedVehicle.h"
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Sample rate of the simulation, in Hz
+#define SAMPLE_RATE 400
+
+// Samples flown before the tracker is armed
+#define WARMUP_SAMPLES 400
+
+// Samples between two commands
+#define COMMAND_PERIOD 20
+
+// Samples between two configurations
+#define CONFIG_PERIOD 200
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Called through pointers so that the calls are not optimized out
+static void *(*volatile allocate)(size_t) = malloc;
+static void *(*volatile allocate_cleared)(size_t, size_t) = calloc;
+static void *(*volatile reallocate)(void *, size_t) = realloc;
+static void *(*volatile allocate_aligned)(size_t, size_t) = memalign;
+static void *(*volatile allocate_c11)(size_t, size_t) = aligned_alloc;
+static int (*volatile allocate_posix)(void **, size_t, size_t) = posix_memalign;
+static void (*volatile release)(void *) = free;
+
+// Checks that each allocation function is tracked
+static bool checkTracking()
+{
+    unsigned int allocations = AllocationTracker::getAllocations();
+    unsigned int frees = AllocationTracker::getFrees();
+    void *pointers[6];
+    pointers[0] = allocate(16);
+    pointers[1] = allocate_cleared(4, 4);
+    pointers[2] = reallocate(NULL, 16);
+    pointers[3] = allocate_aligned(64, 16);
+    pointers[4] = allocate_c11(64, 64);
+    if (allocate_posix(&pointers[5], 64, 16) != 0) {
+        pointers[5] = NULL;
+    }
+    for (int i = 0; i < 6; i++) {
+        release(pointers[i]);
+    }
+    allocations = AllocationTracker::getAllocations() - allocations;
+    frees = AllocationTracker::getFrees() - frees;
+    fprintf(stderr, "AllocationTest: %u of 6 allocations and %u of 6 releases tracked\n", allocations, frees);
+    return allocations == 6 && frees == 6;
+}
+
+// Serialized packet, built before the tracker is armed
+struct Packet {
+    char data[Receiver::MAX_PACKET_SIZE];
+    int size;
+
+    void set(const CommandPacket &packet) {
+        size = packet.SerializeToArray(data, sizeof(data)) ? packet.GetCachedSize() : 0;
+    }
+};
+
+// Command packet
+static void setCommand(Packet &packet, float roll)
+{
+    CommandPacket command;
+    command.mutable_command()->set_roll(roll);
+    command.mutable_command()->set_pitch(0.f);
+    command.mutable_command()->set_yaw_rate(0.f);
+    command.mutable_command()->set_timestamp(0.);
+    packet.set(command);
+}
+
+// Configuration packet, with every telemetry value enabled
+static void setConfig(Packet &packet, float accel_lowpass_constant, int divisor)
+{
+    CommandPacket config;
+    Simulation::getDefaultConfig(config);
+    config.mutable_sensors_config()->set_accel_lowpass_constant(accel_lowpass_constant);
+    // The values are stored but not sent, the host is empty
+    CommandPacket::TelemetryConfig *telemetry = config.mutable_telemetry_config();
+    telemetry->set_host("");
+    telemetry->set_port(FlightService::DEFAULT_TELEMETRY_PORT);
+    telemetry->set_commandenabled(true);
+    telemetry->set_attitudeenabled(true);
+    telemetry->set_controlenabled(true);
+    telemetry->set_switchesenabled(true);
+    telemetry->set_vibrationenabled(true);
+    telemetry->set_latencyenabled(true);
+    CommandPacket::TelemetryConfig::FieldRate *rate = telemetry->add_field_rates();
+    rate->set_field(CommandPacket::TelemetryConfig::ATTITUDE);
+    rate->set_divisor(divisor);
+    packet.set(config);
+}
+
+bool AllocationTest::run(int samples)
+{
+    if (!checkTracking()) {
+        return false;
+    }
+
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    SimulatedVehicle vehicle(parameters, 1);
+    FlightService service(&vehicle);
+    service.motors.begin();
+
+    // Hover and roll step, and two configurations applied in turn
+    Packet commands[2];
+    setCommand(commands[0], 0.f);
+    setCommand(commands[1], .1f);
+    Packet configs[2];
+    setConfig(configs[0], 1.f, 1);
+    setConfig(configs[1], .5f, 2);
+    if (!configs[0].size || !configs[1].size) {
+        fprintf(stderr, "AllocationTest: Cannot serialize the configuration\n");
+        return false;
+    }
+    service.receiver.dispatch(configs[0].data, configs[0].size);
+
+    const float dt = 1.f / SAMPLE_RATE;
+    unsigned int allocations = 0;
+    unsigned int frees = 0;
+    for (int i = 0; i < WARMUP_SAMPLES + samples; i++) {
+        if (i == WARMUP_SAMPLES) {
+            allocations = AllocationTracker::getAllocations();
+            frees = AllocationTracker::getFrees();
+            AllocationTracker::arm();
+        }
+        if (i % COMMAND_PERIOD == 0) {
+            const Packet & command = commands[(i / COMMAND_PERIOD) % 2];
+            service.receiver.dispatch(command.data, command.size);
+        }
+        if (i % CONFIG_PERIOD == CONFIG_PERIOD / 2) {
+            const Packet & config = configs[(i / CONFIG_PERIOD) % 2];
+            service.receiver.dispatch(config.data, config.size);
+        }
+        vehicle.advance(dt);
+        service.sensors.step();
+    }
+    AllocationTracker::disarm();
+    allocations = AllocationTracker::getAllocations() - allocations;
+    frees = AllocationTracker::getFrees() - frees;
+    fprintf(stderr, "AllocationTest: %d samples, %u allocations, %u releases\n", samples, allocations, frees);
+    return allocations == 0 && frees == 0;
+}
+
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ALLOCATIONTEST_H_
+#define _ALLOCATIONTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the heap operations of the control path.
+ *
+ * <p>
+ * It first checks that each allocation function of the C library is counted
+ * by AllocationTracker, then flies a simulated vehicle with every telemetry
+ * value enabled, a command every few samples and two configurations applied
+ * in turn: after the warm-up, the thread is armed as the control thread is in
+ * flight, and no heap operation may happen any more.
+ * </p>
+ */
+class AllocationTest {
+public:
+    /**
+     * Flies the given number of samples with the tracker armed.
+     *
+     * @return false if an allocation function is not tracked, or if the
+     *         control path used the heap.
+     */
+    static bool run(int samples);
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,162 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AllocationTracker.h"
+#include <atomic>
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// glibc allocator entry points
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void __libc_free(void *ptr);
+}
+
+// Per thread state, in static TLS so that accessing it never allocates
+static __thread unsigned int allocations;
+static __thread unsigned int frees;
+static __thread bool armed;
+static __thread bool reported;
+
+static std::atomic<unsigned int> violations(0);
+
+static void violation()
+{
+    violations++;
+    if (!reported) {
+        // Nothing which may allocate here
+        static const char message[] = "AllocationTracker: Heap operation in a real-time thread\n";
+        reported = true;
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+            // Nothing else to do
+        }
+#ifdef ALLOCATION_TRACKER_ABORT
+        abort();
+#endif
+    }
+}
+
+static inline void allocated()
+{
+    allocations++;
+    if (armed) {
+        violation();
+    }
+}
+
+static inline void freed()
+{
+    frees++;
+    if (armed) {
+        violation();
+    }
+}
+
+extern "C" {
+
+void *malloc(size_t size)
+{
+    allocated();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocated();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    allocated();
+    return __libc_realloc(ptr, size);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    allocated();
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    allocated();
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    allocated();
+    // A power of two multiple of sizeof(void *)
+    if (alignment % sizeof(void *) || (alignment & (alignment - 1))) {
+        return EINVAL;
+    }
+    void *p = __libc_memalign(alignment, size);
+    if (!p) {
+        return ENOMEM;
+    }
+    *ptr = p;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    if (ptr) {
+        freed();
+    }
+    __libc_free(ptr);
+}
+
+}
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+void AllocationTracker::arm()
+{
+    armed = true;
+}
+
+void AllocationTracker::disarm()
+{
+    armed = false;
+}
+
+unsigned int AllocationTracker::getAllocations()
+{
+    return allocations;
+}
+
+unsigned int AllocationTracker::getFrees()
+{
+    return frees;
+}
+
+unsigned int AllocationTracker::getViolations()
+{
+    return violations;
+}
+
+}
+}
+}
@@ -0,0 +1,72 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ALLOCATIONTRACKER_H_
+#define _ALLOCATIONTRACKER_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Heap allocations accounting.
+ *
+ * <p>
+ * malloc, calloc, realloc, memalign, posix_memalign, aligned_alloc and free
+ * are replaced by functions which count the calls of each thread before
+ * forwarding them to the C library. A real-time
+ * thread arms the tracker once its startup is done: any further heap
+ * operation in this thread is a violation, which is reported once on stderr.
+ * When built with ALLOCATION_TRACKER_ABORT defined, a violation aborts the
+ * program instead, so that the core dump shows the culprit.
+ * </p>
+ */
+class AllocationTracker {
+
+public:
+    /**
+     * Forbids the heap operations in the calling thread.
+     */
+    static void arm();
+
+    /**
+     * Allows the heap operations in the calling thread again.
+     */
+    static void disarm();
+
+    /**
+     * Number of allocations done by the calling thread.
+     */
+    static unsigned int getAllocations();
+
+    /**
+     * Number of releases done by the calling thread.
+     */
+    static unsigned int getFrees();
+
+    /**
+     * Number of heap operations done by armed threads, in all the threads.
+     */
+    static unsigned int getViolations();
+};
+
+}
+}
+}
+
+#endif
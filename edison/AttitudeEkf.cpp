@@ -0,0 +1,193 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AttitudeEkf.h"
+#include "FastMath.h"
+#include <math.h>
+
+#define GRAVITY 9.80665f
+
+// Initial standard deviations
+#define INITIAL_ANGLE_STD .1f
+#define INITIAL_BIAS_STD .05f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Wraps an angle difference in [-PI, PI]
+static inline float wrap(float a)
+{
+    return a - 2.f * FAST_PI * floorf((a + FAST_PI) / (2.f * FAST_PI));
+}
+
+AttitudeEkf::AttitudeEkf() :
+    gyro_noise(.01f),
+    bias_noise(.0005f),
+    angle_noise(.05f),
+    accel_noise(.5f),
+    vertical_time_constant(5.f)
+{
+    reset();
+}
+
+void AttitudeEkf::setNoise(float gyro_noise, float bias_noise, float angle_noise,
+                           float accel_noise, float vertical_time_constant)
+{
+    this->gyro_noise = gyro_noise;
+    this->bias_noise = bias_noise;
+    this->angle_noise = angle_noise;
+    this->accel_noise = accel_noise;
+    this->vertical_time_constant = vertical_time_constant;
+}
+
+void AttitudeEkf::reset()
+{
+    x = State::zeros();
+    P = Covariance::zeros();
+    P(ROLL, ROLL) = P(PITCH, PITCH) = INITIAL_ANGLE_STD * INITIAL_ANGLE_STD;
+    P(ROLL_BIAS, ROLL_BIAS) = P(PITCH_BIAS, PITCH_BIAS) = INITIAL_BIAS_STD * INITIAL_BIAS_STD;
+    initialized = false;
+}
+
+void AttitudeEkf::predict(float p, float q, float r, float fx, float fy, float fz, float dt)
+{
+    if (!initialized || isnan(dt)) {
+        return;
+    }
+
+    float phi = x(ROLL, 0);
+    float theta = x(PITCH, 0);
+    float sphi = sinf(phi), cphi = cosf(phi);
+    float stheta = sinf(theta), ctheta = cosf(theta);
+    float ttheta = stheta / ctheta;
+
+    // Unbiased rates
+    p -= x(ROLL_BIAS, 0);
+    q -= x(PITCH_BIAS, 0);
+
+    // Euler angles kinematics
+    float phi_dot = p + (q * sphi + r * cphi) * ttheta;
+    float theta_dot = q * cphi - r * sphi;
+
+    // Vertical acceleration, up
+    float up_accel = stheta * fx - sphi * ctheta * fy - cphi * ctheta * fz - GRAVITY;
+
+    float k = vertical_time_constant > 0.f ? 1.f / vertical_time_constant : 0.f;
+    float v = x(VERTICAL_SPEED, 0);
+    float h = x(ALTITUDE, 0);
+
+    x(ROLL, 0) = wrap(phi + phi_dot * dt);
+    x(PITCH, 0) = theta + theta_dot * dt;
+    x(VERTICAL_SPEED, 0) = v + (up_accel - k * v) * dt;
+    x(ALTITUDE, 0) = h + (v - k * h) * dt;
+
+    // Jacobian of the transition
+    Covariance F = Covariance::identity();
+    F(ROLL, ROLL) += (q * cphi - r * sphi) * ttheta * dt;
+    F(ROLL, PITCH) += (q * sphi + r * cphi) / (ctheta * ctheta) * dt;
+    F(ROLL, ROLL_BIAS) = -dt;
+    F(ROLL, PITCH_BIAS) = -sphi * ttheta * dt;
+    F(PITCH, ROLL) += (-q * sphi - r * cphi) * dt;
+    F(PITCH, PITCH_BIAS) = -cphi * dt;
+    F(VERTICAL_SPEED, ROLL) = (-cphi * ctheta * fy + sphi * ctheta * fz) * dt;
+    F(VERTICAL_SPEED, PITCH) = (ctheta * fx + sphi * stheta * fy + cphi * stheta * fz) * dt;
+    F(VERTICAL_SPEED, VERTICAL_SPEED) -= k * dt;
+    F(ALTITUDE, VERTICAL_SPEED) = dt;
+    F(ALTITUDE, ALTITUDE) -= k * dt;
+
+    // Process noise
+    Covariance Q = Covariance::zeros();
+    Q(ROLL, ROLL) = Q(PITCH, PITCH) = gyro_noise * gyro_noise * dt;
+    Q(ROLL_BIAS, ROLL_BIAS) = Q(PITCH_BIAS, PITCH_BIAS) = bias_noise * bias_noise * dt;
+    Q(VERTICAL_SPEED, VERTICAL_SPEED) = accel_noise * accel_noise * dt;
+
+    P = F * P * F.transpose() + Q;
+    P.symmetrize();
+}
+
+void AttitudeEkf::updateGravity(float fx, float fy, float fz)
+{
+    // At rest, the specific force is the opposite of the gravity
+    float roll = fastAtan2f(-fy, -fz);
+    float pitch = fastAtan2f(fx, sqrtf(fy * fy + fz * fz));
+
+    if (!initialized) {
+        x(ROLL, 0) = roll;
+        x(PITCH, 0) = pitch;
+        initialized = true;
+        return;
+    }
+
+    // The accelerometer only measures the gravity when the vehicle is not
+    // accelerating, so we trust it less when the norm is not 1g
+    float norm = sqrtf(fx * fx + fy * fy + fz * fz) / GRAVITY - 1.f;
+    float variance = angle_noise * angle_noise * (1.f + 100.f * norm * norm);
+
+    // H selects the roll and the pitch, so H.P.Ht is the upper left corner of
+    // P and P.Ht its first two columns
+    Matrix<2, 2> S;
+    S(0, 0) = P(ROLL, ROLL) + variance;
+    S(0, 1) = P(ROLL, PITCH);
+    S(1, 0) = P(PITCH, ROLL);
+    S(1, 1) = P(PITCH, PITCH) + variance;
+    Matrix<2, 2> Si;
+    if (!invert(S, Si)) {
+        return;
+    }
+    Matrix<STATES, 2> PHt;
+    for (int i = 0; i < STATES; i++) {
+        PHt(i, 0) = P(i, ROLL);
+        PHt(i, 1) = P(i, PITCH);
+    }
+    Matrix<STATES, 2> K = PHt * Si;
+
+    Matrix<2, 1> y;
+    y(0, 0) = wrap(roll - x(ROLL, 0));
+    y(1, 0) = pitch - x(PITCH, 0);
+    x = x + K * y;
+    x(ROLL, 0) = wrap(x(ROLL, 0));
+
+    // P = (I - K.H).P, where K.H.P = K times the first two rows of P
+    P = P - K * PHt.transpose();
+    P.symmetrize();
+}
+
+void AttitudeEkf::updateAltitude(float altitude, float variance)
+{
+    float s = P(ALTITUDE, ALTITUDE) + variance;
+    if (s <= 0.f) {
+        return;
+    }
+    State K;
+    for (int i = 0; i < STATES; i++) {
+        K(i, 0) = P(i, ALTITUDE) / s;
+    }
+    float y = altitude - x(ALTITUDE, 0);
+    x = x + K * y;
+    Matrix<1, STATES> HP;
+    for (int j = 0; j < STATES; j++) {
+        HP(0, j) = P(ALTITUDE, j);
+    }
+    P = P - K * HP;
+    P.symmetrize();
+}
+
+}
+}
+}
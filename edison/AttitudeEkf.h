@@ -0,0 +1,143 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ATTITUDEEKF_H_
+#define _ATTITUDEEKF_H_
+
+#include "Matrix.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Extended Kalman filter for the attitude, the gyroscope biases and the
+ * vertical motion.
+ *
+ * <p>
+ * The state is the roll, the pitch, the roll and pitch gyroscope biases, the
+ * vertical velocity (up) and the altitude. The prediction integrates the
+ * gyroscope and the vertical acceleration, and the roll and pitch are
+ * corrected by the direction of the gravity measured by the accelerometer.
+ * </p>
+ *
+ * <p>
+ * There is no absolute altitude sensor on the vehicle yet, so the vertical
+ * velocity and the altitude decay with a configurable time constant to bound
+ * the drift of the accelerometer integration. updateAltitude() is the entry
+ * point for such a sensor.
+ * </p>
+ *
+ * <p>
+ * All vectors are expressed in the vehicle body frame: x forward, y right,
+ * z down.
+ * </p>
+ */
+class AttitudeEkf {
+
+public:
+    enum {
+        ROLL,
+        PITCH,
+        ROLL_BIAS,
+        PITCH_BIAS,
+        VERTICAL_SPEED,
+        ALTITUDE,
+        STATES
+    };
+
+    typedef Matrix<STATES, 1> State;
+    typedef Matrix<STATES, STATES> Covariance;
+
+    AttitudeEkf();
+
+    /**
+     * Sets the noise parameters.
+     *
+     * @param gyro_noise
+     *            Gyroscope noise density, in rad/s/sqrt(Hz).
+     * @param bias_noise
+     *            Gyroscope bias random walk, in rad/s^2/sqrt(Hz).
+     * @param angle_noise
+     *            Standard deviation of the accelerometer angles, in rad.
+     * @param accel_noise
+     *            Accelerometer noise density, in m/s^2/sqrt(Hz).
+     * @param vertical_time_constant
+     *            Decay time constant of the vertical velocity and altitude,
+     *            in seconds, 0 to disable the decay.
+     */
+    void setNoise(float gyro_noise, float bias_noise, float angle_noise,
+                  float accel_noise, float vertical_time_constant);
+
+    /**
+     * Restarts the estimation, the next update initializes the attitude from
+     * the accelerometer.
+     */
+    void reset();
+
+    /**
+     * Prediction step.
+     *
+     * @param p, q, r
+     *            Angular rates in rad/s.
+     * @param fx, fy, fz
+     *            Specific force measured by the accelerometer, in m/s^2.
+     * @param dt
+     *            Time since the previous prediction in seconds.
+     */
+    void predict(float p, float q, float r, float fx, float fy, float fz, float dt);
+
+    /**
+     * Update step with the gravity direction measured by the accelerometer.
+     *
+     * @param fx, fy, fz
+     *            Specific force measured by the accelerometer, in m/s^2.
+     */
+    void updateGravity(float fx, float fy, float fz);
+
+    /**
+     * Update step with an altitude measurement.
+     *
+     * @param altitude
+     *            Altitude in meters.
+     * @param variance
+     *            Variance of the measurement, in m^2.
+     */
+    void updateAltitude(float altitude, float variance);
+
+    float get(int state) const {
+        return x.m[state][0];
+    }
+
+private:
+    State x;
+    Covariance P;
+
+    float gyro_noise;
+    float bias_noise;
+    float angle_noise;
+    float accel_noise;
+    float vertical_time_constant;
+    bool initialized;
+};
+
+}
+}
+}
+
+#endif
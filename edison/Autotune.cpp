@@ -0,0 +1,237 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Autotune.h"
+#include "Timestamp.h"
+#include <math.h>
+#include <stdio.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float Autotune::OVERSHOOT_WEIGHT;
+constexpr float Autotune::EFFORT_WEIGHT;
+constexpr float Autotune::CRASH_COST;
+
+// Smallest simplex, in log of the gains, under which the search stops
+#define MIN_SIZE 1.e-3f
+
+// Logarithm of a gain, the zero gains start from a small value
+static inline float logGain(float gain)
+{
+    return logf(gain > 1.e-3f ? gain : 1.e-3f);
+}
+
+void Autotune::Task::execute(int index)
+{
+    int candidate = index / autotune->vehicles;
+    int vehicle = index % autotune->vehicles;
+    VehicleParameters parameters;
+    VehicleParameters::randomize(vehicle, parameters);
+    Simulation simulation(parameters, vehicle);
+    simulation.send(autotune->packets[candidate], autotune->sizes[candidate]);
+    simulation.fly(autotune->duration, autotune->results[index]);
+}
+
+Autotune::Autotune(int vehicles, float duration) :
+    vehicles(vehicles),
+    duration(duration),
+    simulated(0.)
+{
+    task.autotune = this;
+    results = new SimulationResult[MAX_CANDIDATES * vehicles];
+}
+
+Autotune::~Autotune()
+{
+    delete[] results;
+}
+
+void Autotune::apply(const float point[PARAMETERS], CommandPacket &config) const
+{
+    CommandPacket::ControllerConfig *c = config.mutable_controller_config();
+    c->mutable_roll_pid()->set_kp(expf(point[0]));
+    c->mutable_pitch_pid()->set_kp(expf(point[0]));
+    c->mutable_roll_rate_pid()->set_kp(expf(point[1]));
+    c->mutable_pitch_rate_pid()->set_kp(expf(point[1]));
+    c->mutable_roll_rate_pid()->set_ki(expf(point[2]));
+    c->mutable_pitch_rate_pid()->set_ki(expf(point[2]));
+    c->mutable_yaw_rate_pid()->set_kp(expf(point[3]));
+}
+
+void Autotune::evaluate(const float points[][PARAMETERS], int count, float costs[])
+{
+    for (int c = 0; c < count; c++) {
+        CommandPacket candidate(config);
+        apply(points[c], candidate);
+        candidate.SerializeToArray(packets[c], sizeof(packets[c]));
+        sizes[c] = candidate.GetCachedSize();
+    }
+
+    runner.run(task, count * vehicles);
+
+    for (int c = 0; c < count; c++) {
+        float sum = 0.;
+        for (int v = 0; v < vehicles; v++) {
+            const SimulationResult & r = results[c * vehicles + v];
+            if (r.crashed) {
+                sum += CRASH_COST;
+            } else {
+                sum += r.rms_error / Simulation::STEP + OVERSHOOT_WEIGHT * r.overshoot + EFFORT_WEIGHT * r.effort;
+            }
+            simulated += r.duration;
+        }
+        costs[c] = sum / vehicles;
+    }
+}
+
+bool Autotune::run(CommandPacket &config, int iterations)
+{
+    const int n = PARAMETERS;
+    const CommandPacket::ControllerConfig & c = config.controller_config();
+    if (!c.has_roll_rate_pid() || !c.has_pitch_rate_pid()) {
+        fprintf(stderr, "Autotune: The configuration must use the cascaded loops\n");
+        return false;
+    }
+    // The schedule would override the searched gains
+    this->config.CopyFrom(config);
+    this->config.mutable_controller_config()->clear_gain_schedule();
+
+    float simplex[n + 1][n];
+    float costs[n + 1];
+    simplex[0][0] = logGain(c.roll_pid().kp());
+    simplex[0][1] = logGain(c.roll_rate_pid().kp());
+    simplex[0][2] = logGain(c.roll_rate_pid().ki());
+    simplex[0][3] = logGain(c.yaw_rate_pid().kp());
+    for (int i = 1; i <= n; i++) {
+        for (int j = 0; j < n; j++) {
+            // Twice the initial gains
+            simplex[i][j] = simplex[0][j] + (i - 1 == j ? (float)M_LN2 : 0.f);
+        }
+    }
+
+    Timestamp start = Timestamp::now();
+    int candidates = n + 1;
+    evaluate(simplex, n + 1, costs);
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        // Sort from the best to the worst
+        for (int i = 1; i <= n; i++) {
+            for (int j = i; j > 0 && costs[j] < costs[j - 1]; j--) {
+                for (int k = 0; k < n; k++) {
+                    float t = simplex[j][k];
+                    simplex[j][k] = simplex[j - 1][k];
+                    simplex[j - 1][k] = t;
+                }
+                float t = costs[j];
+                costs[j] = costs[j - 1];
+                costs[j - 1] = t;
+            }
+        }
+
+        float size = 0.;
+        for (int i = 1; i <= n; i++) {
+            for (int k = 0; k < n; k++) {
+                size = fmaxf(size, fabsf(simplex[i][k] - simplex[0][k]));
+            }
+        }
+        if (iteration % 10 == 0) {
+            fprintf(stderr, "Autotune: Iteration %d, cost %.4f, simplex size %.4f\n", iteration, costs[0], size);
+        }
+        if (size < MIN_SIZE) {
+            break;
+        }
+
+        // Reflected, expanded, outside and inside contracted points
+        static const float COEFFICIENTS[4] = { 1.f, 2.f, .5f, -.5f };
+        float points[4][n];
+        float point_costs[4];
+        for (int k = 0; k < n; k++) {
+            float centroid = 0.;
+            for (int i = 0; i < n; i++) {
+                centroid += simplex[i][k];
+            }
+            centroid /= n;
+            for (int p = 0; p < 4; p++) {
+                points[p][k] = centroid + COEFFICIENTS[p] * (centroid - simplex[n][k]);
+            }
+        }
+        evaluate(points, 4, point_costs);
+        candidates += 4;
+
+        int accepted = -1;
+        if (point_costs[0] < costs[0]) {
+            accepted = point_costs[1] < point_costs[0] ? 1 : 0;
+        } else if (point_costs[0] < costs[n - 1]) {
+            accepted = 0;
+        } else if (point_costs[0] < costs[n]) {
+            accepted = point_costs[2] <= point_costs[0] ? 2 : -1;
+        } else {
+            accepted = point_costs[3] < costs[n] ? 3 : -1;
+        }
+
+        if (accepted != -1) {
+            for (int k = 0; k < n; k++) {
+                simplex[n][k] = points[accepted][k];
+            }
+            costs[n] = point_costs[accepted];
+        } else {
+            // Shrink towards the best point
+            for (int i = 1; i <= n; i++) {
+                for (int k = 0; k < n; k++) {
+                    simplex[i][k] = simplex[0][k] + .5f * (simplex[i][k] - simplex[0][k]);
+                }
+            }
+            evaluate(simplex + 1, n, costs + 1);
+            candidates += n;
+        }
+    }
+
+    int best = 0;
+    for (int i = 1; i <= n; i++) {
+        if (costs[i] < costs[best]) {
+            best = i;
+        }
+    }
+
+    // Check the best candidate again, its flights give the statistics
+    evaluate(simplex + best, 1, costs);
+    float elapsed = Timestamp::now() - start;
+    int crashed = 0;
+    float rms_error = 0., overshoot = 0., effort = 0.;
+    for (int v = 0; v < vehicles; v++) {
+        crashed += results[v].crashed ? 1 : 0;
+        rms_error += results[v].rms_error / vehicles;
+        overshoot += results[v].overshoot / vehicles;
+        effort += results[v].effort / vehicles;
+    }
+    apply(simplex[best], config);
+
+    fprintf(stderr, "Autotune: Angle kp %.4f, rate kp %.4f ki %.4f, yaw rate kp %.4f\n",
+            expf(simplex[best][0]), expf(simplex[best][1]), expf(simplex[best][2]), expf(simplex[best][3]));
+    fprintf(stderr, "Autotune: Cost %.4f, RMS error %.3f rad, overshoot %.1f%%, effort %.4f, %d crashed\n",
+            costs[0], rms_error, overshoot * 100., effort, crashed);
+    fprintf(stderr, "Autotune: %d candidates, %d flights in %.1fs on %d workers, %.0f simulated seconds per second\n",
+            candidates, (candidates + 1) * vehicles, elapsed, runner.getWorkers(), simulated / elapsed);
+    return crashed == 0;
+}
+
+}
+}
+}
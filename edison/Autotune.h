@@ -0,0 +1,105 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _AUTOTUNE_H_
+#define _AUTOTUNE_H_
+
+#include "Simulation.h"
+#include "WorkStealingRunner.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Tuning of the attitude gains on simulated vehicles.
+ *
+ * <p>
+ * The gains of the cascaded roll and pitch loops, which are shared because
+ * the vehicle is symmetric, and the yaw rate gain are searched with the
+ * Nelder-Mead method, on the logarithm of the gains so that they stay
+ * positive. A candidate is scored on the same randomized vehicles as the
+ * others, by its tracking error, its overshoot and its motor effort, and a
+ * crash costs more than any flight.
+ * </p>
+ *
+ * <p>
+ * Each iteration evaluates the reflected, expanded and both contracted
+ * points at once, then keeps the one the method would have chosen, so that
+ * the flights of one iteration fill all the CPUs.
+ * </p>
+ */
+class Autotune {
+public:
+    static const int PARAMETERS = 4;
+
+    // Weights of the score
+    static constexpr float OVERSHOOT_WEIGHT = .5f;
+    static constexpr float EFFORT_WEIGHT = 1.f;
+    static constexpr float CRASH_COST = 100.f;
+
+    /**
+     * Constructor.
+     *
+     * @param vehicles
+     *            Number of randomized vehicles flown for each candidate.
+     * @param duration
+     *            Duration of each flight, in seconds.
+     */
+    Autotune(int vehicles, float duration);
+    ~Autotune();
+
+    /**
+     * Searches the gains from the configuration, and replaces them with the
+     * best ones found.
+     *
+     * @return false if no candidate flies all the vehicles without crash.
+     */
+    bool run(CommandPacket & config, int iterations);
+
+private:
+    // Most candidates evaluated at once, by the first simplex or a shrink
+    static const int MAX_CANDIDATES = PARAMETERS + 1;
+
+    class Task : public WorkStealingRunner::Task {
+    public:
+        Autotune *autotune;
+        void execute(int index);
+    };
+
+    int vehicles;
+    float duration;
+    WorkStealingRunner runner;
+    Task task;
+
+    // Candidates of the current batch, serialized, and their flights
+    CommandPacket config;
+    char packets[MAX_CANDIDATES][Receiver::MAX_PACKET_SIZE];
+    int sizes[MAX_CANDIDATES];
+    SimulationResult *results;
+    float simulated;
+
+    void evaluate(const float points[][PARAMETERS], int count, float costs[]);
+    void apply(const float point[PARAMETERS], CommandPacket & config) const;
+};
+
+}
+}
+}
+
+#endif
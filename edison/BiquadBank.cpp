@@ -0,0 +1,131 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BiquadBank.h"
+#include <math.h>
+#include <string.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+BiquadBank::BiquadBank() :
+    count(0),
+    previous_count(0),
+    rate(400.f)
+{
+    // add() compares the coefficients of the replaced sections
+    memset(sections, 0, sizeof(sections));
+}
+
+void BiquadBank::clear()
+{
+    previous_count = count;
+    count = 0;
+}
+
+void BiquadBank::setSampleRate(float rate)
+{
+    this->rate = rate;
+}
+
+int BiquadBank::addLowPass(float frequency, float q)
+{
+    const float frequencies[LANES] = { frequency, frequency, frequency, frequency };
+    return add(false, frequencies, q);
+}
+
+int BiquadBank::addNotch(float frequency, float q)
+{
+    const float frequencies[LANES] = { frequency, frequency, frequency, frequency };
+    return add(true, frequencies, q);
+}
+
+int BiquadBank::addNotch(const float frequency[LANES], float q)
+{
+    return add(true, frequency, q);
+}
+
+int BiquadBank::add(bool notch, const float frequency[LANES], float q)
+{
+    if (count == MAX_SECTIONS) {
+        return -1;
+    }
+    Section & s = sections[count];
+    for (int lane = 0; lane < LANES; lane++) {
+        // Coefficients of the replaced section
+        float b0 = s.b0[lane], b1 = s.b1[lane], b2 = s.b2[lane], a1 = s.a1[lane], a2 = s.a2[lane];
+        compute(s, lane, notch, frequency[lane], q);
+        if (count >= previous_count || b0 != s.b0[lane] || b1 != s.b1[lane] || b2 != s.b2[lane] ||
+                a1 != s.a1[lane] || a2 != s.a2[lane]) {
+            s.z1[lane] = 0.f;
+            s.z2[lane] = 0.f;
+        }
+    }
+    return count++;
+}
+
+void BiquadBank::setNotch(int section, int axis, float frequency, float q)
+{
+    compute(sections[section], axis, true, frequency, q);
+}
+
+void BiquadBank::compute(Section &s, int lane, bool notch, float frequency, float q)
+{
+    // Keep the frequency below Nyquist
+    float w0 = 2.f * (float)M_PI * fminf(frequency, .49f * rate) / rate;
+    float cw = cosf(w0);
+    float alpha = sinf(w0) / (2.f * q);
+    float a0 = 1.f + alpha;
+    if (notch) {
+        s.b0[lane] = 1.f / a0;
+        s.b1[lane] = -2.f * cw / a0;
+        s.b2[lane] = 1.f / a0;
+    } else {
+        s.b0[lane] = (1.f - cw) * .5f / a0;
+        s.b1[lane] = (1.f - cw) / a0;
+        s.b2[lane] = (1.f - cw) * .5f / a0;
+    }
+    s.a1[lane] = -2.f * cw / a0;
+    s.a2[lane] = (1.f - alpha) / a0;
+}
+
+void BiquadBank::reset()
+{
+    for (int i = 0; i < count; i++) {
+        for (int lane = 0; lane < LANES; lane++) {
+            sections[i].z1[lane] = 0.f;
+            sections[i].z2[lane] = 0.f;
+        }
+    }
+}
+
+void BiquadBank::filter(Vector &x)
+{
+    for (int i = 0; i < count; i++) {
+        Section & s = sections[i];
+        Vector y = s.b0 * x + s.z1;
+        s.z1 = s.b1 * x - s.a1 * y + s.z2;
+        s.z2 = s.b2 * x - s.a2 * y;
+        x = y;
+    }
+}
+
+}
+}
+}
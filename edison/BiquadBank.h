@@ -0,0 +1,130 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BIQUADBANK_H_
+#define _BIQUADBANK_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Cascade of biquad filters applied to the three gyroscope axes together.
+ *
+ * <p>
+ * The coefficients and the states of each section are stored as structures of
+ * arrays with one lane per axis, padded to 4 lanes, so that a section is
+ * computed with a few SIMD operations for the 3 axes. Each lane has its own
+ * coefficients, which allows retuning a notch on a single axis.
+ * </p>
+ *
+ * <p>
+ * The sections are in transposed direct form II, and the coefficients follow
+ * the Audio EQ Cookbook of R. Bristow-Johnson.
+ * </p>
+ *
+ * <p>
+ * A section added after clear() keeps the state of each lane whose
+ * coefficients are the same as those of the section it replaces, so that
+ * rebuilding the bank with an unchanged configuration does not disturb the
+ * filtered rates.
+ * </p>
+ */
+class BiquadBank {
+
+public:
+    static const int MAX_SECTIONS = 8;
+    static const int LANES = 4;
+
+    typedef float Vector __attribute__((vector_size(LANES * sizeof(float))));
+
+    BiquadBank();
+
+    /**
+     * Removes all the sections. Their states are kept for the sections added
+     * afterwards with the same coefficients.
+     */
+    void clear();
+
+    /**
+     * Sets the sample rate used to compute the coefficients of the sections
+     * added afterwards.
+     */
+    void setSampleRate(float rate);
+
+    /**
+     * Appends a low-pass section on all the axes.
+     *
+     * @return The section index, -1 if the bank is full.
+     */
+    int addLowPass(float frequency, float q);
+
+    /**
+     * Appends a notch section on all the axes.
+     *
+     * @return The section index, -1 if the bank is full.
+     */
+    int addNotch(float frequency, float q);
+
+    /**
+     * Appends a notch section with its own center frequency on each lane.
+     *
+     * @return The section index, -1 if the bank is full.
+     */
+    int addNotch(const float frequency[LANES], float q);
+
+    /**
+     * Changes the center frequency of a notch section on one axis, without
+     * resetting its state.
+     */
+    void setNotch(int section, int axis, float frequency, float q);
+
+    /**
+     * Clears the state of all the sections.
+     */
+    void reset();
+
+    /**
+     * Filters one sample of each axis, in place.
+     */
+    void filter(Vector & x);
+
+    int size() const {
+        return count;
+    }
+
+private:
+    struct Section {
+        Vector b0, b1, b2, a1, a2;
+        Vector z1, z2;
+    };
+
+    Section sections[MAX_SECTIONS];
+    int count;
+    int previous_count; // Sections before the last clear()
+    float rate;
+
+    int add(bool notch, const float frequency[LANES], float q);
+    void compute(Section & s, int lane, bool notch, float frequency, float q);
+};
+
+}
+}
+}
+
+#endif
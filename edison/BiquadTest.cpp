@@ -0,0 +1,161 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "BiquadTest.h"
+#include "BiquadBank.h"
+#include <math.h>
+#include <stdio.h>
+
+#define SAMPLE_RATE 400
+
+// Filters of the test
+#define LOWPASS_FREQUENCY 50.f
+#define LOWPASS_Q .7071f
+#define NOTCH_FREQUENCY 100.f
+#define NOTCH_Y_FREQUENCY 80.f // Notch of the second axis
+#define NOTCH_Q 2.f
+
+// Sweep step, in Hz, the sweep frequencies have a whole number of periods
+// per second
+#define SWEEP_STEP 5
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float BiquadTest::TOLERANCE;
+constexpr float BiquadTest::MIN_NOTCH_REJECTION;
+
+// Gain of a cookbook low-pass or notch section at the given frequency
+static double response(bool notch, double center, double q, double frequency)
+{
+    double w0 = 2. * M_PI * center / SAMPLE_RATE;
+    double alpha = sin(w0) / (2. * q);
+    double b0, b1, b2;
+    if (notch) {
+        b0 = 1.;
+        b1 = -2. * cos(w0);
+        b2 = 1.;
+    } else {
+        b0 = (1. - cos(w0)) / 2.;
+        b1 = 1. - cos(w0);
+        b2 = (1. - cos(w0)) / 2.;
+    }
+    double a0 = 1. + alpha, a1 = -2. * cos(w0), a2 = 1. - alpha;
+
+    // H(e^jw) = (b0 + b1 e^-jw + b2 e^-2jw) / (a0 + a1 e^-jw + a2 e^-2jw)
+    double w = 2. * M_PI * frequency / SAMPLE_RATE;
+    double nr = b0 + b1 * cos(w) + b2 * cos(2. * w), ni = -b1 * sin(w) - b2 * sin(2. * w);
+    double dr = a0 + a1 * cos(w) + a2 * cos(2. * w), di = -a1 * sin(w) - a2 * sin(2. * w);
+    return sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+}
+
+// Steady state amplitude of each axis for a unit sine: the first second is
+// skipped, the amplitude is the RMS of the second one times sqrt(2)
+static void measure(BiquadBank & bank, int frequency, float amplitudes[3])
+{
+    double sums[3] = { 0., 0., 0. };
+    bank.reset();
+    for (int i = 0; i < 2 * SAMPLE_RATE; i++) {
+        float x = sinf(2.f * (float)M_PI * frequency * i / SAMPLE_RATE);
+        BiquadBank::Vector v = { x, x, x, 0.f };
+        bank.filter(v);
+        if (i >= SAMPLE_RATE) {
+            for (int a = 0; a < 3; a++) {
+                sums[a] += v[a] * v[a];
+            }
+        }
+    }
+    for (int a = 0; a < 3; a++) {
+        amplitudes[a] = sqrt(2. * sums[a] / SAMPLE_RATE);
+    }
+}
+
+static void build(BiquadBank & bank)
+{
+    bank.clear();
+    bank.setSampleRate(SAMPLE_RATE);
+    bank.addLowPass(LOWPASS_FREQUENCY, LOWPASS_Q);
+    bank.addNotch(NOTCH_FREQUENCY, NOTCH_Q);
+}
+
+bool BiquadTest::run()
+{
+    BiquadBank lowpass;
+    lowpass.setSampleRate(SAMPLE_RATE);
+    lowpass.addLowPass(LOWPASS_FREQUENCY, LOWPASS_Q);
+    BiquadBank notch;
+    notch.setSampleRate(SAMPLE_RATE);
+    int section = notch.addNotch(NOTCH_FREQUENCY, NOTCH_Q);
+    notch.setNotch(section, 1, NOTCH_Y_FREQUENCY, NOTCH_Q);
+
+    // Sweeps, the amplitudes at the cutoff and at the notches are kept
+    float error = 0.;
+    float cutoff = 0.;
+    float rejection[2] = { 0., 0. };
+    for (int f = SWEEP_STEP; f < SAMPLE_RATE / 2; f += SWEEP_STEP) {
+        float amplitudes[3];
+        measure(lowpass, f, amplitudes);
+        for (int a = 0; a < 3; a++) {
+            error = fmaxf(error, fabsf(amplitudes[a] - response(false, LOWPASS_FREQUENCY, LOWPASS_Q, f)));
+        }
+        if (f == (int)LOWPASS_FREQUENCY) {
+            cutoff = 20.f * log10f(amplitudes[0]);
+        }
+        measure(notch, f, amplitudes);
+        for (int a = 0; a < 3; a++) {
+            float center = a == 1 ? NOTCH_Y_FREQUENCY : NOTCH_FREQUENCY;
+            error = fmaxf(error, fabsf(amplitudes[a] - response(true, center, NOTCH_Q, f)));
+        }
+        if (f == (int)NOTCH_FREQUENCY) {
+            rejection[0] = -20.f * log10f(fmaxf(amplitudes[0], 1.e-10f));
+        } else if (f == (int)NOTCH_Y_FREQUENCY) {
+            rejection[1] = -20.f * log10f(fmaxf(amplitudes[1], 1.e-10f));
+        }
+    }
+
+    // A bank rebuilt with the same sections in the middle of a signal goes
+    // on as if nothing happened
+    BiquadBank untouched, rebuilt;
+    build(untouched);
+    build(rebuilt);
+    bool continuous = true;
+    for (int i = 0; i < 2 * SAMPLE_RATE; i++) {
+        if (i == SAMPLE_RATE) {
+            build(rebuilt);
+        }
+        float x = sinf(2.f * (float)M_PI * 30.f * i / SAMPLE_RATE);
+        BiquadBank::Vector u = { x, x, x, 0.f };
+        BiquadBank::Vector r = u;
+        untouched.filter(u);
+        rebuilt.filter(r);
+        continuous = continuous && u[0] == r[0] && u[1] == r[1] && u[2] == r[2];
+    }
+
+    fprintf(stderr, "BiquadTest: largest error %.4f, low-pass %.2fdB at the cutoff, notches -%.0fdB and -%.0fdB, %s when rebuilt\n",
+            error, cutoff, rejection[0], rejection[1], continuous ? "continuous" : "discontinuous");
+    return error <= TOLERANCE
+            && fabsf(cutoff - 20.f * log10f(LOWPASS_Q)) <= 20.f * log10f(1.f + TOLERANCE)
+            && rejection[0] >= MIN_NOTCH_REJECTION
+            && rejection[1] >= MIN_NOTCH_REJECTION
+            && continuous;
+}
+
+}
+}
+}
@@ -0,0 +1,59 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _BIQUADTEST_H_
+#define _BIQUADTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the frequency response of the biquad filter bank.
+ *
+ * <p>
+ * Sine sweeps go through a low-pass bank and a notch bank, with a different
+ * notch frequency on one axis. The steady state amplitude of each axis is
+ * compared with the response of the Audio EQ Cookbook filters computed in
+ * double precision, and in particular with the -3dB of the low-pass at its
+ * cutoff frequency and the rejection of the notches at their centers. A bank
+ * rebuilt with the same sections must then give the same output as a bank
+ * which was left untouched.
+ * </p>
+ */
+class BiquadTest {
+public:
+    static constexpr float TOLERANCE = .005f; // Relative to the input amplitude
+    static constexpr float MIN_NOTCH_REJECTION = 40.f; // dB
+
+    /**
+     * Runs the sweeps and prints the largest deviations.
+     *
+     * @return false if an amplitude differs from the computed response by
+     *         more than TOLERANCE, if a notch rejects less than
+     *         MIN_NOTCH_REJECTION, or if rebuilding the bank with the same
+     *         sections changed its output.
+     */
+    static bool run();
+};
+
+}
+}
+}
+
+#endif
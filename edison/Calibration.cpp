@@ -0,0 +1,200 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Calibration.h"
+#include <fcntl.h>
+#include <libgen.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAGIC "HDC2"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+const char Calibration::DEFAULT_PATH[] = "/home/root/calibration.bin";
+constexpr float GyroCalibration::MIN_TEMPERATURE;
+constexpr float GyroCalibration::BIN_WIDTH;
+
+// Content of the calibration file
+struct CalibrationFile {
+    char magic[4];
+    GyroCalibration gyro;
+    uint32_t checksum;
+};
+
+// FNV-1a hash of the content before the checksum
+static uint32_t checksum(const CalibrationFile & file)
+{
+    const uint8_t *data = (const uint8_t *)&file;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(CalibrationFile, checksum); i++) {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+Calibration::Calibration()
+{
+    strcpy(path, DEFAULT_PATH);
+    sem_init(&saved, 0, 0);
+}
+
+bool Calibration::setPath(const char *path)
+{
+    if (strlen(path) + sizeof(".tmp") > sizeof(this->path)) {
+        fprintf(stderr, "Calibration: Path too long\n");
+        return false;
+    }
+    strcpy(this->path, path);
+    return true;
+}
+
+bool Calibration::load(GyroCalibration &calibration) const
+{
+    CalibrationFile file;
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    ssize_t size = read(fd, &file, sizeof(file));
+    close(fd);
+    if (size != sizeof(file) || memcmp(file.magic, MAGIC, 4) || file.checksum != checksum(file)) {
+        fprintf(stderr, "Calibration: %s is invalid, ignored\n", path);
+        return false;
+    }
+    calibration = file.gyro;
+    return true;
+}
+
+bool Calibration::getBias(const GyroCalibration &c, float temperature, float bias[3])
+{
+    // Nearest calibrated bins below and above the temperature
+    float position = (temperature - GyroCalibration::MIN_TEMPERATURE) / GyroCalibration::BIN_WIDTH;
+    int below = -1;
+    int above = -1;
+    for (int i = 0; i < GyroCalibration::BINS; i++) {
+        if (c.windows[i]) {
+            if (i <= position) {
+                below = i;
+            } else if (above == -1) {
+                above = i;
+            }
+        }
+    }
+    if (below == -1 && above == -1) {
+        bias[0] = bias[1] = bias[2] = 0.;
+        return false;
+    }
+    if (below == -1 || above == -1) {
+        int nearest = below == -1 ? above : below;
+        for (int axis = 0; axis < 3; axis++) {
+            bias[axis] = c.bias[nearest][axis];
+        }
+        return true;
+    }
+    float t = (position - below) / (above - below);
+    for (int axis = 0; axis < 3; axis++) {
+        bias[axis] = c.bias[below][axis] + t * (c.bias[above][axis] - c.bias[below][axis]);
+    }
+    return true;
+}
+
+void Calibration::learn(GyroCalibration &c, float temperature, const float bias[3])
+{
+    int bin = (int)lroundf((temperature - GyroCalibration::MIN_TEMPERATURE) / GyroCalibration::BIN_WIDTH);
+    if (bin < 0) {
+        bin = 0;
+    } else if (bin >= GyroCalibration::BINS) {
+        bin = GyroCalibration::BINS - 1;
+    }
+    if (c.windows[bin] < MAX_WINDOWS) {
+        c.windows[bin]++;
+    }
+    for (int axis = 0; axis < 3; axis++) {
+        c.bias[bin][axis] += (bias[axis] - c.bias[bin][axis]) / c.windows[bin];
+    }
+}
+
+void Calibration::save(const GyroCalibration &calibration)
+{
+    if (pending.publish(calibration)) {
+        sem_post(&saved);
+    }
+}
+
+bool Calibration::write(const GyroCalibration &calibration) const
+{
+    CalibrationFile file;
+    memset(&file, 0, sizeof(file));
+    memcpy(file.magic, MAGIC, 4);
+    file.gyro = calibration;
+    file.checksum = checksum(file);
+
+    char temporary[sizeof(path) + 4];
+    snprintf(temporary, sizeof(temporary), "%s.tmp", path);
+    int fd = ::open(temporary, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Calibration: Cannot create the calibration file");
+        return false;
+    }
+    bool written = ::write(fd, &file, sizeof(file)) == sizeof(file) && !fsync(fd);
+    close(fd);
+    if (!written || rename(temporary, path)) {
+        perror("Calibration: Cannot write the calibration file");
+        unlink(temporary);
+        return false;
+    }
+
+    // The rename itself must reach the flash
+    char directory[sizeof(path)];
+    strcpy(directory, path);
+    fd = ::open(dirname(directory), O_RDONLY);
+    if (fd != -1) {
+        fsync(fd);
+        close(fd);
+    }
+    return true;
+}
+
+void Calibration::run()
+{
+    fprintf(stderr, "Calibration: Thread started\n");
+    unsigned int written = 0;
+    while (true) {
+        while (pending.getVersion() == written) {
+            while (sem_wait(&saved) == -1) {
+                // Interrupted by a signal
+            }
+        }
+        written = pending.getVersion();
+        GyroCalibration calibration = *pending.get();
+        if (write(calibration)) {
+            fprintf(stderr, "Calibration: Saved\n");
+        }
+        sleep(SAVE_PERIOD);
+    }
+}
+
+}
+}
+}
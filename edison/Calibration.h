@@ -0,0 +1,127 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CALIBRATION_H_
+#define _CALIBRATION_H_
+
+#include "Thread.h"
+#include "Snapshot.h"
+#include <semaphore.h>
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Gyroscope biases measured on the vehicle, as a table of the sensor
+ * temperature.
+ *
+ * <p>
+ * Bin i holds the biases measured around MIN_TEMPERATURE + i * BIN_WIDTH.
+ * </p>
+ */
+struct GyroCalibration {
+    static const int BINS = 16;
+    static constexpr float MIN_TEMPERATURE = -10.f; // Degrees Celsius
+    static constexpr float BIN_WIDTH = 5.f; // Degrees Celsius
+
+    float bias[BINS][3]; // gx, gy and gz biases, in raw units
+    uint32_t windows[BINS]; // Number of still windows averaged, 0 if not calibrated
+};
+
+/**
+ * Calibration store, in a file of the flash.
+ *
+ * <p>
+ * The calibration is loaded once at startup, in a few microseconds, so that
+ * a restarted flight software flies again without calibrating the sensors
+ * nor waiting for the ground station. The control thread then gives the
+ * refined calibrations to save(), which publishes them as a snapshot and
+ * posts a semaphore, so that it never waits for the lock of another thread:
+ * the file is written by the calibration thread, at most every SAVE_PERIOD
+ * seconds to limit the wear of the flash, with the latest calibration.
+ * </p>
+ *
+ * <p>
+ * The file is written to a temporary file which replaces the previous one
+ * once synced, so that a power loss leaves either the previous calibration or
+ * the new one. A checksum rejects any other content.
+ * </p>
+ */
+class Calibration : public Thread {
+
+public:
+    static const char DEFAULT_PATH[];
+
+    // Minimum delay between two writes of the file, in seconds
+    static const int SAVE_PERIOD = 60;
+
+    // Windows over which a bin is averaged, the older ones are forgotten
+    static const int MAX_WINDOWS = 60;
+
+    Calibration();
+
+    /**
+     * Selects the calibration file, must be called before start().
+     */
+    bool setPath(const char *path);
+
+    /**
+     * Reads the calibration file.
+     *
+     * @return false if the file does not exist or is invalid.
+     */
+    bool load(GyroCalibration & calibration) const;
+
+    /**
+     * Biases at a temperature, interpolated between the nearest calibrated
+     * bins, or those of the only calibrated bin on one side.
+     *
+     * @return false if no bin is calibrated, the biases are then zero.
+     */
+    static bool getBias(const GyroCalibration & calibration, float temperature, float bias[3]);
+
+    /**
+     * Averages the biases of a still window in the bin of its temperature.
+     */
+    static void learn(GyroCalibration & calibration, float temperature, const float bias[3]);
+
+    /**
+     * Saves a calibration, without waiting for the file to be written nor for
+     * the calibration thread, from the control thread.
+     */
+    void save(const GyroCalibration & calibration);
+
+    // Thread entry point, do not call directly
+    void run();
+
+private:
+    char path[256];
+    // Latest calibration to write, and the semaphore posted with each one
+    Snapshot<GyroCalibration> pending;
+    sem_t saved;
+
+    bool write(const GyroCalibration & calibration) const;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,138 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ClockSync.h"
+#include <math.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr double ClockSync::MAX_ROUND_TRIP;
+constexpr double ClockSync::MIN_SKEW_SPAN;
+constexpr double ClockSync::MAX_SKEW;
+constexpr double ClockSync::OFFSET_ERROR;
+
+ClockSync::ClockSync()
+{
+    reset();
+}
+
+void ClockSync::reset()
+{
+    best_count = 0;
+    best_next = 0;
+    candidate_count = 0;
+    has_offset = false;
+    reference_time = 0.;
+    reference_offset = 0.;
+    skew = 0.;
+    round_trip = 0.;
+}
+
+bool ClockSync::add(double air_send, double ground_receive, double ground_send, double air_receive)
+{
+    Exchange e;
+    e.time = (air_send + air_receive) / 2.;
+    e.offset = ((ground_receive - air_send) + (ground_send - air_receive)) / 2.;
+    e.round_trip = (air_receive - air_send) - (ground_send - ground_receive);
+    if (!isfinite(e.offset) || !(ground_send >= ground_receive) ||
+            !(e.round_trip >= 0.) || e.round_trip > MAX_ROUND_TRIP) {
+        return false;
+    }
+
+    if (candidate_count == 0 || e.round_trip < candidate.round_trip) {
+        candidate = e;
+    }
+    if (++candidate_count == SEGMENT) {
+        best[best_next] = candidate;
+        best_next = (best_next + 1) % SEGMENTS;
+        if (best_count < SEGMENTS) {
+            best_count++;
+        }
+        candidate_count = 0;
+        fit();
+    } else if (best_count == 0) {
+        // First group
+        reference_time = candidate.time;
+        reference_offset = candidate.offset;
+        round_trip = candidate.round_trip;
+    }
+    has_offset = true;
+    return true;
+}
+
+void ClockSync::fit()
+{
+    int reference = 0;
+    for (int i = 1; i < best_count; i++) {
+        if (best[i].round_trip < best[reference].round_trip) {
+            reference = i;
+        }
+    }
+    reference_time = best[reference].time;
+    reference_offset = best[reference].offset;
+    round_trip = best[reference].round_trip;
+
+    // An offset is off by at most half the excess of its round trip over the
+    // best one, plus the unknown error of the best one
+    double first = best[0].time;
+    double last = best[0].time;
+    double weights = 0.;
+    double mean_time = 0.;
+    double mean_offset = 0.;
+    double weight[SEGMENTS];
+    for (int i = 0; i < best_count; i++) {
+        double error = (best[i].round_trip - round_trip) / 2. + OFFSET_ERROR;
+        weight[i] = 1. / (error * error);
+        first = fmin(first, best[i].time);
+        last = fmax(last, best[i].time);
+        weights += weight[i];
+        mean_time += weight[i] * best[i].time;
+        mean_offset += weight[i] * best[i].offset;
+    }
+
+    skew = 0.;
+    if (last - first >= MIN_SKEW_SPAN) {
+        mean_time /= weights;
+        mean_offset /= weights;
+        double covariance = 0.;
+        double variance = 0.;
+        for (int i = 0; i < best_count; i++) {
+            double dt = best[i].time - mean_time;
+            covariance += weight[i] * dt * (best[i].offset - mean_offset);
+            variance += weight[i] * dt * dt;
+        }
+        skew = fmax(-MAX_SKEW, fmin(MAX_SKEW, covariance / variance));
+    }
+}
+
+double ClockSync::getOffset(double air) const
+{
+    return reference_offset + skew * (air - reference_time);
+}
+
+double ClockSync::toAir(double ground) const
+{
+    // ground = air + reference_offset + skew * (air - reference_time)
+    return (ground - reference_offset + skew * reference_time) / (1. + skew);
+}
+
+}
+}
+}
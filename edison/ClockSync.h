@@ -0,0 +1,147 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CLOCKSYNC_H_
+#define _CLOCKSYNC_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Estimation of the ground clock from ping/pong exchanges, as NTP does.
+ *
+ * <p>
+ * Each exchange gives the offset of the ground clock at the middle of the
+ * round trip, with an error up to half the round trip time which is mostly
+ * due to the queuing delays. The exchanges are grouped by SEGMENT and only the
+ * one with the smallest round trip of each group is kept. The offset is the
+ * one of the exchange with the smallest round trip of the last SEGMENTS
+ * groups, and the skew is the slope of a least squares line through them,
+ * once they span MIN_SKEW_SPAN. Each offset is weighted by the inverse square
+ * of its error bound: half the excess of its round trip over the smallest
+ * one, plus OFFSET_ERROR. The skew is limited to MAX_SKEW, the drift of a
+ * poor crystal.
+ * </p>
+ *
+ * <p>
+ * All the times are in seconds. Until the first group is complete, the best
+ * exchange so far gives the offset.
+ * </p>
+ */
+class ClockSync {
+
+public:
+    static const int SEGMENT = 8;
+    static const int SEGMENTS = 16;
+
+    /**
+     * Longest accepted round trip, in seconds.
+     */
+    static constexpr double MAX_ROUND_TRIP = 1.;
+
+    static constexpr double MIN_SKEW_SPAN = 10.;
+    static constexpr double MAX_SKEW = 200.e-6;
+
+    /**
+     * Error assumed for the offset of the exchange with the smallest round
+     * trip, in seconds.
+     */
+    static constexpr double OFFSET_ERROR = .0002;
+
+    ClockSync();
+
+    /**
+     * Forgets all the exchanges.
+     */
+    void reset();
+
+    /**
+     * Adds an exchange.
+     *
+     * @param air_send
+     *            Transmission time of the ping, on the air clock.
+     * @param ground_receive
+     *            Reception time of the ping, on the ground clock.
+     * @param ground_send
+     *            Transmission time of the pong, on the ground clock.
+     * @param air_receive
+     *            Reception time of the pong, on the air clock.
+     * @return false if the exchange is inconsistent and has been ignored.
+     */
+    bool add(double air_send, double ground_receive, double ground_send, double air_receive);
+
+    bool isSynchronized() const {
+        return has_offset;
+    }
+
+    /**
+     * Converts a ground time to the air clock.
+     */
+    double toAir(double ground) const;
+
+    /**
+     * Ground clock minus air clock, at the given air time.
+     */
+    double getOffset(double air) const;
+
+    /**
+     * Drift of the ground clock, in seconds per air second.
+     */
+    double getSkew() const {
+        return skew;
+    }
+
+    /**
+     * Round trip of the best exchange in use.
+     */
+    double getRoundTrip() const {
+        return round_trip;
+    }
+
+private:
+    struct Exchange {
+        double time; // Air time at the middle of the round trip
+        double offset;
+        double round_trip;
+    };
+
+    // Best exchange of each complete group, the oldest one is replaced
+    Exchange best[SEGMENTS];
+    int best_count;
+    int best_next;
+
+    // Best exchange of the current group
+    Exchange candidate;
+    int candidate_count;
+
+    // Offset of the best exchange at its time, and skew
+    bool has_offset;
+    double reference_time;
+    double reference_offset;
+    double skew;
+    double round_trip;
+
+    void fit();
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _COMPLEMENTARYFILTER_H_
+#define _COMPLEMENTARYFILTER_H_
+
+#include "Fixed.h"
+#include "Hal.h"
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Complementary filter of one axis, from the raw sensor values.
+ *
+ * <p>
+ * The gyroscope rate, corrected by the calibration, the bias and the gain,
+ * is integrated and high-pass filtered, and added to the low-pass filtered
+ * angle of the accelerometer. Both filters have the time constant T. The
+ * integral and its low-pass are shifted together by whole turns, so that
+ * they stay bounded however long the gyroscope drifts.
+ * </p>
+ *
+ * <p>
+ * All the computations are done with numbers of type N, float or Fixed, from
+ * the integer sensor values to the angle, which is only converted to float
+ * when read. The configuration is converted when set.
+ * </p>
+ *
+ * @param N
+ *            Number type.
+ */
+template <class N>
+class ComplementaryFilter {
+
+public:
+    typedef Arithmetic<N> A;
+
+    ComplementaryFilter() :
+        gyro_factor(A::factor(RawSample::GYRO_RESOLUTION * (float)(M_PI / 180.))),
+        half(A::fromFloat(.5f)),
+        pi(A::fromFloat((float)M_PI)),
+        two_pi(A::fromFloat(2.f * (float)M_PI)),
+        filtered(false),
+        started(false),
+        coefficient(),
+        gyro_bias(),
+        gyro_gain(A::fromFloat(1.f)),
+        accel_bias(),
+        calibration(),
+        previous_rate(),
+        gyro_angle(),
+        gyro_lowpass(),
+        accel_lowpass(),
+        angle() {
+    }
+
+    /**
+     * Sets the configuration, the biases are in radians per second and
+     * radians. A time constant of 0 disables the filters, the angle is then
+     * the one of the accelerometer.
+     */
+    void setConfig(float time_constant, float gyro_bias, float gyro_gain, float accel_bias) {
+        filtered = time_constant > 0.;
+        coefficient = A::fromFloat(filtered ? 2.3f / time_constant : 0.f);
+        this->gyro_bias = A::fromFloat(gyro_bias);
+        this->gyro_gain = A::fromFloat(gyro_gain);
+        this->accel_bias = A::fromFloat(accel_bias);
+    }
+
+    /**
+     * Replaces the gyroscope bias of the configuration, in radians per
+     * second.
+     */
+    void setGyroBias(float gyro_bias) {
+        this->gyro_bias = A::fromFloat(gyro_bias);
+    }
+
+    /**
+     * Sets the calibration, in raw units of the gyroscope input.
+     */
+    void setCalibration(float offset) {
+        calibration = A::fromFloat(offset * RawSample::GYRO_RESOLUTION * (float)(M_PI / 180.));
+    }
+
+    /**
+     * Processes one sample.
+     *
+     * @param gyro
+     *            Raw gyroscope rate around the axis.
+     * @param accel_y
+     * @param accel_x
+     *            Raw accelerometer values whose atan2 is the angle.
+     * @param dt_ns
+     *            Time since the previous sample, in nanoseconds.
+     */
+    void update(int32_t gyro, int32_t accel_y, int32_t accel_x, int64_t dt_ns) {
+        N rate = (A::scale(gyro, gyro_factor) - calibration - gyro_bias) * gyro_gain;
+        N accel_angle = A::atan2(accel_y, accel_x) - accel_bias;
+        N dt = A::seconds(dt_ns);
+        if (started) {
+            gyro_angle = gyro_angle + (rate + previous_rate) * dt * half;
+        }
+        previous_rate = rate;
+        if (!started || !filtered) {
+            gyro_lowpass = gyro_angle;
+            accel_lowpass = accel_angle;
+        } else {
+            N k = dt * coefficient;
+            gyro_lowpass = gyro_lowpass + k * (gyro_angle - gyro_lowpass);
+            accel_lowpass = accel_lowpass + k * (accel_angle - accel_lowpass);
+        }
+        // Only the difference of the integral and of its low-pass is used,
+        // both are kept within one turn so that a remaining bias does not
+        // overflow a Fixed
+        if (gyro_angle > pi) {
+            gyro_angle = gyro_angle - two_pi;
+            gyro_lowpass = gyro_lowpass - two_pi;
+        } else if (gyro_angle < -pi) {
+            gyro_angle = gyro_angle + two_pi;
+            gyro_lowpass = gyro_lowpass + two_pi;
+        }
+        started = true;
+        angle = gyro_angle - gyro_lowpass + accel_lowpass;
+    }
+
+    /**
+     * Restarts the integration of the gyroscope from 0.
+     */
+    void reset() {
+        gyro_angle = N();
+        started = false;
+    }
+
+    float getAngle() const {
+        return A::toFloat(angle);
+    }
+
+private:
+    const typename A::Factor gyro_factor;
+    const N half;
+    const N pi;
+    const N two_pi;
+    bool filtered;
+    bool started;
+    N coefficient;
+    N gyro_bias;
+    N gyro_gain;
+    N accel_bias;
+    N calibration;
+    N previous_rate;
+    N gyro_angle;
+    N gyro_lowpass;
+    N accel_lowpass;
+    N angle;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,360 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ControlBenchmark.h"
+#include "FlightService.h"
+#include "Simulation.h"
+#include "SimulatedVehicle.h"
+#include <math.h>
+#include <stdio.h>
+
+// Sample period, in nanoseconds
+#define SAMPLE_PERIOD_NS 2500000
+
+// Synthetic attitudes, repeated
+#define ATTITUDES 256
+
+// Largest difference between the motor outputs of both implementations
+#define OUTPUT_TOLERANCE 1.e-6f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Timestamp of a tick
+static Timestamp tickTimestamp(int tick)
+{
+    Timestamp timestamp;
+    long long ns = 1000000000LL + (long long)tick * SAMPLE_PERIOD_NS;
+    timestamp.t.tv_sec = ns / 1000000000LL;
+    timestamp.t.tv_nsec = ns % 1000000000LL;
+    return timestamp;
+}
+
+static void setGains(hummingdroid::PID *pid, float kp, float ki, float kd, float ko, float td)
+{
+    pid->set_kp(kp);
+    pid->set_ki(ki);
+    pid->set_kd(kd);
+    pid->set_ko(ko);
+    pid->set_td(td);
+}
+
+/*
+ * Frozen copy of the control path which read the protobuf messages at each
+ * tick, before the plain structures of FlightData.h: the PIDs read their
+ * coefficients and check IsInitialized(), the controller reads the limits of
+ * its configuration message, and the attitude and the motor commands are
+ * passed as messages, copied in the telemetry packet. Only the PWM writes go
+ * to the HAL, like the current motors.
+ */
+class ProtobufPid : public Object, public Value {
+public:
+    void setParams(const hummingdroid::PID & params)
+    {
+        synchronized
+        this->params = params;
+        low_pass.setT(params.td());
+    }
+
+    void pid(Value value)
+    {
+        synchronized
+        if (!params.IsInitialized()) {
+            return;
+        }
+        propo.amplify(value, params.kp());
+        integ.integrate(value);
+        float max = 1. / params.ki();
+        integ.limit(-max, max);
+        integ_factor.amplify(integ, params.ki());
+        low_pass.lowpass(value);
+        deriv.derive(low_pass);
+        deriv_factor.amplify(deriv, params.kd());
+        this->value = propo.value + integ_factor.value + deriv_factor.value + params.ko();
+        this->timestamp = value.timestamp;
+    }
+
+private:
+    Value propo;
+    Integrator integ;
+    Value integ_factor;
+    LowPass low_pass;
+    Derivator deriv;
+    Value deriv_factor;
+    hummingdroid::PID params;
+};
+
+class ProtobufTelemetry : public Object {
+public:
+    void setConfig(const CommandPacket::TelemetryConfig & config)
+    {
+        synchronized
+        this->config = config;
+    }
+
+    void setAttitude(const Attitude & attitude)
+    {
+        synchronized
+        if (config.has_attitudeenabled() && config.attitudeenabled())
+            packet.mutable_attitude()->CopyFrom(attitude);
+    }
+
+    void setControl(const MotorsControl & control)
+    {
+        synchronized
+        if (config.has_controlenabled() && config.controlenabled())
+            packet.mutable_control()->CopyFrom(control);
+    }
+
+private:
+    CommandPacket::TelemetryConfig config;
+    TelemetryPacket packet;
+};
+
+class ProtobufController : public Object {
+public:
+    ProtobufController(Hal *hal, ProtobufTelemetry *telemetry) :
+        hal(hal),
+        telemetry(telemetry),
+        min_pwm(0.),
+        max_pwm(0.)
+    {
+        for (int i = 0; i < 4; i++) {
+            outputs[i] = 0.;
+        }
+    }
+
+    void setConfig(const CommandPacket::ControllerConfig & config, const CommandPacket::MotorsConfig & motors)
+    {
+        synchronized
+        this->config = config;
+        altitude_control.setParams(config.altitude_pid());
+        roll_control.setParams(config.roll_pid());
+        pitch_control.setParams(config.pitch_pid());
+        yaw_rate_control.setParams(config.yaw_rate_pid());
+        min_pwm = motors.min_pwm();
+        max_pwm = motors.max_pwm();
+    }
+
+    void setAttitude(const Attitude & attitude, const Timestamp & timestamp)
+    {
+        synchronized
+        bool excessive_roll, excessive_pitch, excessive_yaw_rate, excessive_altitude;
+        if (config.has_max_inclinaison()) {
+            excessive_roll = (attitude.roll() < -config.max_inclinaison()) || (attitude.roll() > config.max_inclinaison());
+            excessive_pitch = (attitude.pitch() < -config.max_inclinaison()) || (attitude.pitch() > config.max_inclinaison());
+        } else {
+            excessive_roll = false;
+            excessive_pitch = false;
+        }
+        if (config.has_max_yaw_rate()) {
+            excessive_yaw_rate = (attitude.yaw_rate() < -config.max_yaw_rate()) || (attitude.yaw_rate() > config.max_yaw_rate());
+        } else {
+            excessive_yaw_rate = false;
+        }
+        if (config.max_altitude()) {
+            excessive_altitude = attitude.altitude() > config.max_altitude();
+        } else {
+            excessive_altitude = false;
+        }
+
+        if (excessive_roll || excessive_pitch || excessive_yaw_rate || excessive_altitude) {
+            altitude_control.value = 0;
+            roll_control.value = 0;
+            pitch_control.value = 0;
+            yaw_rate_control.value = 0;
+        } else {
+            altitude_error.set(command.altitude() - attitude.altitude(), timestamp);
+            roll_error.set(command.roll() - attitude.roll(), timestamp);
+            pitch_error.set(command.pitch() - attitude.pitch(), timestamp);
+            yaw_rate_error.set(command.yaw_rate() - attitude.yaw_rate(), timestamp);
+            altitude_control.pid(altitude_error);
+            roll_control.pid(roll_error);
+            pitch_control.pid(pitch_error);
+            yaw_rate_control.pid(yaw_rate_error);
+        }
+
+        MotorsControl control;
+        control.set_altitude_throttle(altitude_control.value);
+        control.set_roll_throttle(roll_control.value);
+        control.set_pitch_throttle(pitch_control.value);
+        control.set_yaw_throttle(yaw_rate_control.value);
+        control.set_timestamp(timestamp);
+        telemetry->setControl(control);
+        setMotors(control);
+    }
+
+    float outputs[4];
+
+private:
+    Hal *hal;
+    ProtobufTelemetry *telemetry;
+    CommandPacket::ControllerConfig config;
+    Attitude command;
+    Value altitude_error, roll_error, pitch_error, yaw_rate_error;
+    ProtobufPid altitude_control, roll_control, pitch_control, yaw_rate_control;
+    float min_pwm, max_pwm;
+
+    float scale(float value)
+    {
+        return fmaxf(fminf((max_pwm - min_pwm) * value + min_pwm, max_pwm), 0.f);
+    }
+
+    void setMotors(const MotorsControl & control)
+    {
+        float g = control.altitude_throttle();
+        float r = control.roll_throttle();
+        float p = control.pitch_throttle();
+        float y = control.yaw_throttle();
+        outputs[0] = scale( r + p - y + g);
+        outputs[1] = scale(-r + p + y + g);
+        outputs[2] = scale(-r - p - y + g);
+        outputs[3] = scale( r - p + y + g);
+        hal->writeMotors(outputs);
+    }
+};
+
+// Configuration with the loops of the protobuf control path: four PIDs, no
+// rate loop, no gain schedule, the commands applied when received
+static void getComparedConfig(CommandPacket & config)
+{
+    Simulation::getDefaultConfig(config);
+    CommandPacket::ControllerConfig *controller = config.mutable_controller_config();
+    setGains(controller->mutable_roll_pid(), .3, .05, .05, 0., .01);
+    setGains(controller->mutable_pitch_pid(), .3, .05, .05, 0., .01);
+    controller->clear_roll_rate_pid();
+    controller->clear_pitch_rate_pid();
+}
+
+// Time per tick of the control path with the given configuration, and the
+// last motor outputs
+static float timeControlPath(const CommandPacket & config, const AttitudeState *attitudes, int ticks, float outputs[4])
+{
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    SimulatedVehicle vehicle(parameters, 1);
+    FlightService service(&vehicle);
+    char data[Receiver::MAX_PACKET_SIZE];
+    if (!config.SerializeToArray(data, sizeof(data))) {
+        fprintf(stderr, "ControlBenchmark: Cannot serialize the configuration\n");
+        return NAN;
+    }
+    service.receiver.dispatch(data, config.GetCachedSize());
+    service.motors.begin();
+
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < ticks; i++) {
+        AttitudeState attitude = attitudes[i % ATTITUDES];
+        attitude.timestamp = tickTimestamp(i);
+        service.controller.setAttitude(attitude, attitude.timestamp);
+        service.telemetry.setAttitude(attitude);
+    }
+    float time = Timestamp::now() - start;
+    service.motors.getOutputs(outputs);
+    return time / ticks;
+}
+
+// Time per tick of the frozen protobuf control path, and the last motor
+// outputs
+static float timeProtobufPath(const CommandPacket & config, const AttitudeState *attitudes, int ticks, float outputs[4])
+{
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    SimulatedVehicle vehicle(parameters, 1);
+    ProtobufTelemetry telemetry;
+    ProtobufController controller(&vehicle, &telemetry);
+    telemetry.setConfig(config.telemetry_config());
+    controller.setConfig(config.controller_config(), config.motors_config());
+    vehicle.beginMotors(1000000000 / 450);
+
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < ticks; i++) {
+        // The sensors filled a message for each sample
+        const AttitudeState & state = attitudes[i % ATTITUDES];
+        Timestamp timestamp = tickTimestamp(i);
+        Attitude attitude;
+        attitude.set_altitude(state.altitude);
+        attitude.set_roll(state.roll);
+        attitude.set_pitch(state.pitch);
+        attitude.set_roll_rate(state.roll_rate);
+        attitude.set_pitch_rate(state.pitch_rate);
+        attitude.set_yaw_rate(state.yaw_rate);
+        attitude.set_timestamp(timestamp);
+        controller.setAttitude(attitude, timestamp);
+        telemetry.setAttitude(attitude);
+    }
+    float time = Timestamp::now() - start;
+    for (int i = 0; i < 4; i++) {
+        outputs[i] = controller.outputs[i];
+    }
+    return time / ticks;
+}
+
+bool ControlBenchmark::run(int ticks)
+{
+    AttitudeState attitudes[ATTITUDES];
+    for (int i = 0; i < ATTITUDES; i++) {
+        float t = 2.f * (float)M_PI * i / ATTITUDES;
+        attitudes[i].altitude = 0.f;
+        attitudes[i].roll = .1f * sinf(t);
+        attitudes[i].roll_rate = .1f * cosf(t);
+        attitudes[i].pitch = .1f * cosf(t);
+        attitudes[i].pitch_rate = -.1f * sinf(t);
+        attitudes[i].yaw = 0.f;
+        attitudes[i].yaw_rate = .05f * sinf(t);
+        attitudes[i].has_yaw = false;
+    }
+
+    // The values are stored but not sent, the host is empty
+    CommandPacket config;
+    getComparedConfig(config);
+    CommandPacket::TelemetryConfig *telemetry = config.mutable_telemetry_config();
+    telemetry->set_host("");
+    telemetry->set_port(FlightService::DEFAULT_TELEMETRY_PORT);
+    telemetry->set_commandenabled(true);
+    telemetry->set_attitudeenabled(true);
+    telemetry->set_controlenabled(true);
+    telemetry->set_switchesenabled(true);
+    telemetry->set_vibrationenabled(true);
+
+    float outputs[4], protobuf_outputs[4], cascaded_outputs[4];
+    float time = timeControlPath(config, attitudes, ticks, outputs);
+    float protobuf_time = timeProtobufPath(config, attitudes, ticks, protobuf_outputs);
+
+    // Then the loops of the simulations
+    CommandPacket cascaded;
+    Simulation::getDefaultConfig(cascaded);
+    cascaded.mutable_telemetry_config()->CopyFrom(*telemetry);
+    float cascaded_time = timeControlPath(cascaded, attitudes, ticks, cascaded_outputs);
+
+    float difference = 0.;
+    bool finite = true;
+    for (int i = 0; i < 4; i++) {
+        difference = fmaxf(difference, fabsf(outputs[i] - protobuf_outputs[i]));
+        finite = finite && isfinite(cascaded_outputs[i]);
+    }
+    fprintf(stderr, "ControlBenchmark: %d ticks, plain structures %.1fns, protobuf messages %.1fns per tick, "
+            "outputs differ by %.1e\n", ticks, time * 1.e9, protobuf_time * 1.e9, difference);
+    fprintf(stderr, "ControlBenchmark: with the rate loops of the simulations %.1fns per tick\n", cascaded_time * 1.e9);
+    return difference <= OUTPUT_TOLERANCE && finite;
+}
+
+}
+}
+}
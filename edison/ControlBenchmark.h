@@ -0,0 +1,56 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CONTROLBENCHMARK_H_
+#define _CONTROLBENCHMARK_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Cost of the control path of one sample, before and after the plain
+ * structures of FlightData.h.
+ *
+ * <p>
+ * A FlightService on a simulated vehicle, with all the telemetry enabled, is
+ * given synthetic attitudes: each tick runs Controller::setAttitude(), which
+ * drives the motors and the control telemetry, and Telemetry::setAttitude().
+ * A frozen copy of the previous control path, whose PIDs and controller read
+ * the protobuf messages at each tick and which passes the attitude and the
+ * motor commands as messages, runs the same ticks with the same four PIDs,
+ * and must give the same motor outputs. The current path is then also timed
+ * with the rate loops of the simulations.
+ * </p>
+ */
+class ControlBenchmark {
+public:
+    /**
+     * Runs the given number of ticks and prints the time per tick.
+     *
+     * @return false if the motor outputs of both paths differ, or if they are
+     *         not finite.
+     */
+    static bool run(int ticks);
+};
+
+}
+}
+}
+
+#endif
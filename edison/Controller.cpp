@@ -18,64 +18,194 @@
 
 #include "Controller.h"
 #include "FlightService.h"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+typedef CommandPacket::ControllerConfig::GainPoint GainPoint;
+
+// Loads the schedule of one PID, selected by the given accessors
+static bool loadSchedule(GainSchedule & schedule, const CommandPacket::ControllerConfig & config,
+                         bool (GainPoint::*has)() const, const hummingdroid::PID & (GainPoint::*get)() const,
+                         const char *name)
+{
+    float throttle[GainSchedule::MAX_POINTS];
+    PIDGains gains[GainSchedule::MAX_POINTS];
+    int count = config.gain_schedule_size();
+
+    schedule.clear();
+    if (count == 0) {
+        return true;
+    }
+    if (count > GainSchedule::MAX_POINTS) {
+        fprintf(stderr, "Controller: Too many gain schedule points, %d max\n", GainSchedule::MAX_POINTS);
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        const GainPoint & point = config.gain_schedule(i);
+        if (!(point.*has)()) {
+            // This PID is not scheduled
+            return true;
+        }
+        throttle[i] = point.throttle();
+        if (!loadGains((point.*get)(), gains[i])) {
+            fprintf(stderr, "Controller: Invalid %s gains in the gain schedule\n", name);
+            return false;
+        }
+    }
+    if (!schedule.set(throttle, gains, count)) {
+        fprintf(stderr, "Controller: Invalid %s gain schedule, the throttle must be increasing\n", name);
+        return false;
+    }
+    return true;
+}
+
+// Returns a positive limit, infinite if disabled
+static inline bool loadLimit(bool enabled, float value, float & limit)
+{
+    limit = enabled ? value : INFINITY;
+    return limit > 0.;
+}
+
 Controller::Controller(FlightService *context) :
     motors(&context->motors),
-    telemetry(&context->telemetry)
+    telemetry(&context->telemetry),
+    settings_version(0),
+    command(),
+    cascaded(false),
+    angle_loop_count(0)
 {
 }
 
+bool Controller::loadSettings(const CommandPacket::ControllerConfig &config, ControllerSettings &s)
+{
+    // Clear the padding, so that an unchanged configuration is not published
+    memset(&s, 0, sizeof(s));
+
+    if (!loadGains(config.altitude_pid(), s.altitude_pid) ||
+            !loadGains(config.roll_pid(), s.roll_pid) ||
+            !loadGains(config.pitch_pid(), s.pitch_pid) ||
+            !loadGains(config.yaw_rate_pid(), s.yaw_rate_pid)) {
+        fprintf(stderr, "Controller: Invalid PID gains\n");
+        return false;
+    }
+    s.cascaded = config.has_roll_rate_pid() && config.has_pitch_rate_pid();
+    if (s.cascaded && (!loadGains(config.roll_rate_pid(), s.roll_rate_pid) ||
+                       !loadGains(config.pitch_rate_pid(), s.pitch_rate_pid))) {
+        fprintf(stderr, "Controller: Invalid rate PID gains\n");
+        return false;
+    }
+    s.angle_loop_divisor = config.angle_loop_divisor();
+    if (s.angle_loop_divisor < 1) {
+        fprintf(stderr, "Controller: Invalid angle loop divisor %d\n", s.angle_loop_divisor);
+        return false;
+    }
+    if (!loadLimit(config.has_max_inclinaison(), config.max_inclinaison(), s.max_inclinaison) ||
+            !loadLimit(config.max_altitude() != 0., config.max_altitude(), s.max_altitude) ||
+            !loadLimit(config.has_max_yaw_rate(), config.max_yaw_rate(), s.max_yaw_rate)) {
+        fprintf(stderr, "Controller: Invalid safety limits\n");
+        return false;
+    }
+    s.setpoint_mode = config.setpoint_mode();
+    if (!loadLimit(config.has_max_angle_slew(), config.max_angle_slew(), s.max_angle_slew) ||
+            !loadLimit(config.has_max_yaw_rate_slew(), config.max_yaw_rate_slew(), s.max_yaw_rate_slew)) {
+        fprintf(stderr, "Controller: Invalid setpoint slew limits\n");
+        return false;
+    }
+    return loadSchedule(s.roll_schedule, config, &GainPoint::has_roll_pid, &GainPoint::roll_pid, "roll") &&
+            loadSchedule(s.pitch_schedule, config, &GainPoint::has_pitch_pid, &GainPoint::pitch_pid, "pitch") &&
+            loadSchedule(s.yaw_rate_schedule, config, &GainPoint::has_yaw_rate_pid, &GainPoint::yaw_rate_pid, "yaw rate") &&
+            loadSchedule(s.roll_rate_schedule, config, &GainPoint::has_roll_rate_pid, &GainPoint::roll_rate_pid, "roll rate") &&
+            loadSchedule(s.pitch_rate_schedule, config, &GainPoint::has_pitch_rate_pid, &GainPoint::pitch_rate_pid, "pitch rate");
+}
+
 void Controller::setConfig(const CommandPacket::ControllerConfig &config)
 {
-    synchronized
-    this->config = config;
-    altitude_control.setParams(config.altitude_pid());
-    roll_control.setParams(config.roll_pid());
-    pitch_control.setParams(config.pitch_pid());
-    yaw_rate_control.setParams(config.yaw_rate_pid());
+    ControllerSettings s;
+    if (loadSettings(config, s)) {
+        settings.publish(s);
+    } else {
+        fprintf(stderr, "Controller: Configuration ignored\n");
+    }
+}
+
+void Controller::applySchedule(const GainSchedule &schedule, PID &pid, float throttle)
+{
+    if (schedule.isEnabled()) {
+        PIDGains gains;
+        schedule.lookup(throttle, gains);
+        pid.setGains(gains);
+    }
 }
 
 void Controller::setCommand(const Attitude &command)
 {
-    synchronized
-    this->command = command;
+    this->command.altitude = command.altitude();
+    this->command.roll_rate = command.roll_rate();
+    this->command.pitch_rate = command.pitch_rate();
+    this->command.yaw = command.yaw();
+    this->command.has_yaw = command.has_yaw();
+    const float values[SetpointShaper::AXES] = { command.roll(), command.pitch(), command.yaw_rate() };
+    setpoint.push(values, command.has_timestamp() ? command.timestamp() : NAN);
     if (command.has_altitude() && command.altitude() == 0.) {
         // Need to reset the integrator of the PID
         altitude_control.reset();
         roll_control.reset();
         pitch_control.reset();
+        roll_rate_control.reset();
+        pitch_rate_control.reset();
         yaw_rate_control.reset();
+        setpoint.reset();
     }
 }
 
-void Controller::setAttitude(const Attitude &attitude, const Timestamp &timestamp)
+void Controller::setAttitude(const AttitudeState &attitude, const Timestamp &timestamp)
 {
-    synchronized
-    // Check for instability
-    bool excessive_roll, excessive_pitch, excessive_yaw_rate, excessive_altitude;
-    if (config.has_max_inclinaison()) {
-        excessive_roll = (attitude.roll() < -config.max_inclinaison()) || (attitude.roll() > config.max_inclinaison());
-        excessive_pitch = (attitude.pitch() < -config.max_inclinaison()) || (attitude.pitch() > config.max_inclinaison());
-    } else {
-        excessive_roll = false;
-        excessive_pitch = false;
+    // Reload the gains when the configuration changes
+    unsigned int version = settings.getVersion();
+    const ControllerSettings & config = *settings.get();
+    if (version != settings_version) {
+        settings_version = version;
+        altitude_control.setGains(config.altitude_pid);
+        roll_control.setGains(config.roll_pid);
+        pitch_control.setGains(config.pitch_pid);
+        yaw_rate_control.setGains(config.yaw_rate_pid);
+        if (config.cascaded) {
+            roll_rate_control.setGains(config.roll_rate_pid);
+            pitch_rate_control.setGains(config.pitch_rate_pid);
+        }
+        if (config.cascaded != cascaded) {
+            // The angle loops output rates instead of throttles, and the rate
+            // loops restart from where they were left
+            roll_control.reset();
+            pitch_control.reset();
+            if (config.cascaded) {
+                roll_rate_control.reset();
+                pitch_rate_control.reset();
+            }
+            cascaded = config.cascaded;
+        }
+        angle_loop_count = 0;
+        const float max_slew[SetpointShaper::AXES] = { config.max_angle_slew, config.max_angle_slew, config.max_yaw_rate_slew };
+        setpoint.setConfig((SetpointShaper::Mode)config.setpoint_mode, max_slew);
     }
 
-    if (config.has_max_yaw_rate()) {
-        excessive_yaw_rate = (attitude.yaw_rate() < -config.max_yaw_rate()) || (attitude.yaw_rate() > config.max_yaw_rate());
-    } else {
-        excessive_yaw_rate = false;
-    }
+    // Command between the packets
+    float shaped[SetpointShaper::AXES];
+    setpoint.update(timestamp, shaped);
+    command.roll = shaped[0];
+    command.pitch = shaped[1];
+    command.yaw_rate = shaped[2];
 
-    if (config.max_altitude()) {
-        excessive_altitude = (attitude.altitude() > config.max_altitude()) || (attitude.altitude() > config.max_altitude());
-    } else {
-        excessive_altitude = false;
-    }
+    // Check for instability
+    bool excessive_roll = (attitude.roll < -config.max_inclinaison) || (attitude.roll > config.max_inclinaison);
+    bool excessive_pitch = (attitude.pitch < -config.max_inclinaison) || (attitude.pitch > config.max_inclinaison);
+    bool excessive_yaw_rate = (attitude.yaw_rate < -config.max_yaw_rate) || (attitude.yaw_rate > config.max_yaw_rate);
+    bool excessive_altitude = attitude.altitude > config.max_altitude;
 
     if (excessive_roll || excessive_pitch || excessive_yaw_rate || excessive_altitude) {
 
@@ -83,29 +213,54 @@ void Controller::setAttitude(const Attitude &attitude, const Timestamp &timestam
         altitude_control.value = 0;
         roll_control.value = 0;
         pitch_control.value = 0;
+        roll_rate_control.value = 0;
+        pitch_rate_control.value = 0;
         yaw_rate_control.value = 0;
 
     } else {
 
         // Compute the error
-        altitude_error.set(command.altitude() - attitude.altitude(), timestamp);
-        roll_error.set(command.roll() - attitude.roll(), timestamp);
-        pitch_error.set(command.pitch() - attitude.pitch(), timestamp);
-        yaw_rate_error.set(command.yaw_rate() - attitude.yaw_rate(), timestamp);
+        altitude_error.set(command.altitude - attitude.altitude, timestamp);
+        yaw_rate_error.set(command.yaw_rate - attitude.yaw_rate, timestamp);
+
+        // Schedule the gains on the last collective throttle
+        float throttle = altitude_control.value;
+        applySchedule(config.roll_schedule, roll_control, throttle);
+        applySchedule(config.pitch_schedule, pitch_control, throttle);
+        applySchedule(config.yaw_rate_schedule, yaw_rate_control, throttle);
+        applySchedule(config.roll_rate_schedule, roll_rate_control, throttle);
+        applySchedule(config.pitch_rate_schedule, pitch_rate_control, throttle);
 
         // PID
         altitude_control.pid(altitude_error);
-        roll_control.pid(roll_error);
-        pitch_control.pid(pitch_error);
         yaw_rate_control.pid(yaw_rate_error);
+
+        // Angle loops, at a lower rate in cascaded mode
+        if (!cascaded || angle_loop_count == 0) {
+            roll_error.set(command.roll - attitude.roll, timestamp);
+            pitch_error.set(command.pitch - attitude.pitch, timestamp);
+            roll_control.pid(roll_error);
+            pitch_control.pid(pitch_error);
+        }
+        if (++angle_loop_count >= config.angle_loop_divisor) {
+            angle_loop_count = 0;
+        }
+
+        // Rate loops, the angle loops output is the rate command
+        if (cascaded) {
+            roll_rate_error.set(roll_control.value - attitude.roll_rate, timestamp);
+            pitch_rate_error.set(pitch_control.value - attitude.pitch_rate, timestamp);
+            roll_rate_control.pid(roll_rate_error);
+            pitch_rate_control.pid(pitch_rate_error);
+        }
     }
 
-    MotorsControl control;
-    control.set_altitude_throttle(altitude_control.value);
-    control.set_roll_throttle(roll_control.value);
-    control.set_pitch_throttle(pitch_control.value);
-    control.set_yaw_throttle(yaw_rate_control.value);
-    control.set_timestamp(timestamp);
+    MotorsCommand control;
+    control.altitude_throttle = altitude_control.value;
+    control.roll_throttle = cascaded ? roll_rate_control.value : roll_control.value;
+    control.pitch_throttle = cascaded ? pitch_rate_control.value : pitch_control.value;
+    control.yaw_throttle = yaw_rate_control.value;
+    control.timestamp = timestamp;
 
     // Telemetry
     telemetry->setControl(control);
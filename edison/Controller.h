@@ -4,7 +4,10 @@
 #include "Motors.h"
 #include "Telemetry.h"
 #include "Value.h"
-#include "Object.h"
+#include "GainSchedule.h"
+#include "Snapshot.h"
+#include "FlightData.h"
+#include "SetpointShaper.h"
 
 namespace org {
 namespace hummingdroid {
@@ -12,24 +15,77 @@ namespace flightapp {
 
 class FlightService;
 
+/**
+ * Controller configuration, flattened from ControllerConfig.
+ */
+struct ControllerSettings {
+    PIDGains altitude_pid;
+    PIDGains roll_pid;
+    PIDGains pitch_pid;
+    PIDGains yaw_rate_pid;
+    PIDGains roll_rate_pid;
+    PIDGains pitch_rate_pid;
+    bool cascaded;
+    int angle_loop_divisor;
+    // Safety limits, infinite when disabled
+    float max_inclinaison;
+    float max_altitude;
+    float max_yaw_rate;
+    // Command shaping, the slew limits are infinite when disabled
+    int setpoint_mode;
+    float max_angle_slew;
+    float max_yaw_rate_slew;
+    GainSchedule roll_schedule;
+    GainSchedule pitch_schedule;
+    GainSchedule yaw_rate_schedule;
+    GainSchedule roll_rate_schedule;
+    GainSchedule pitch_rate_schedule;
+};
+
 /**
  * Flight controller.
  *
  * <p>
  * This class implements the closed-loop control of the vehicle attitude.
  * </p>
+ *
+ * <p>
+ * When the roll and pitch rate PIDs are configured, the roll and pitch are
+ * controlled by cascaded loops: the angle PIDs compute a rate command every
+ * angle_loop_divisor samples, and the rate PIDs follow this command on every
+ * gyroscope sample. The rate loops use the filtered gyroscope rates, without
+ * the lag of the attitude estimator.
+ * </p>
+ *
+ * <p>
+ * The roll, pitch and rate PIDs gains can be scheduled on the collective
+ * throttle computed by the altitude PID.
+ * </p>
+ *
+ * <p>
+ * The roll, pitch and yaw rate commands are shaped between two packets of
+ * the remote, see SetpointShaper.
+ * </p>
+ *
+ * <p>
+ * The configuration is published as an immutable snapshot, the control loop
+ * only reloads the PID gains when a new one has been published. The commands
+ * and the attitude are both given by the control thread, without lock.
+ * </p>
  */
-class Controller : public Object {
+class Controller {
 
 private:
     Motors* motors;
     Telemetry* telemetry;
 
     // Config
-    CommandPacket::ControllerConfig config;
+    Snapshot<ControllerSettings> settings;
+    unsigned int settings_version;
 
-    // Command
-    Attitude command;
+    // Command, with the shaped roll, pitch and yaw rate
+    AttitudeState command;
+    SetpointShaper setpoint;
 
     // Altitude control
     Value altitude_error;
@@ -43,12 +99,21 @@ private:
     Value pitch_error;
     PID pitch_control;
 
+    // Roll and pitch rate control, in cascaded mode
+    bool cascaded;
+    int angle_loop_count;
+    Value roll_rate_error;
+    PID roll_rate_control;
+    Value pitch_rate_error;
+    PID pitch_rate_control;
+
     // Yaw rate control
     Value yaw_rate_error;
     PID yaw_rate_control;
 
-    // Motors control
-    MotorsControl output;
+    void applySchedule(const GainSchedule & schedule, PID & pid, float throttle);
+
+    static bool loadSettings(const CommandPacket::ControllerConfig & config, ControllerSettings & settings);
 
 public:
     /**
@@ -62,6 +127,10 @@ public:
     /**
      * Sets the controller configuration.
      *
+     * <p>
+     * An invalid configuration is ignored.
+     * </p>
+     *
      * @param config
      *            New configuration.
      */
@@ -71,7 +140,8 @@ public:
      * Sets the new command.
      *
      * <p>
-     * The command is the attitude we want to reach.
+     * The command is the attitude we want to reach. It is applied at the
+     * next attitude, from the control thread.
      * </p>
      *
      * @param command
@@ -88,7 +158,7 @@ public:
      * @param timestamp
      *            The time in nanosecond of this measure.
      */
-    void setAttitude(const Attitude & attitude, const Timestamp & timestamp);
+    void setAttitude(const AttitudeState & attitude, const Timestamp & timestamp);
 };
 
 }
@@ -1,6 +1,9 @@
 #include "DatagramSocket.h"
 
 #include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include <errno.h>
 #include <netinet/in.h>
 #include <netinet/udp.h>
 #include <sys/types.h>
@@ -10,7 +13,8 @@
 #include <stdio.h>
 #include <unistd.h>
 
-DatagramSocket::DatagramSocket()
+DatagramSocket::DatagramSocket() :
+    error(0)
 {
     udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
     if (udp_socket == -1) {
@@ -80,7 +84,7 @@ void DatagramSocket::connect(const char *host, unsigned short port)
     }
 }
 
-void DatagramSocket::bind(unsigned short port)
+bool DatagramSocket::bind(unsigned short port)
 {
     synchronized
 
@@ -92,9 +96,10 @@ void DatagramSocket::bind(unsigned short port)
         }
     };
     if (::bind(udp_socket, (const struct sockaddr*)&addr, sizeof(struct sockaddr_in)) == -1) {
-        perror("DatagramSocket.cpp: bind() failed");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "DatagramSocket.cpp: bind() to port %d failed: %s\n", port, strerror(errno));
+        return false;
     }
+    return true;
 }
 
 bool DatagramSocket::send(const void *data, int size)
@@ -102,9 +107,23 @@ bool DatagramSocket::send(const void *data, int size)
     synchronized
 
     if (write(udp_socket, data, size) == -1) {
-        perror("DatagramSocket: sendto() failed");
-        return -1;
+        error = errno;
+        return false;
     } else {
-        return 0;
+        return true;
+    }
+}
+
+int DatagramSocket::getError() const
+{
+    return error;
+}
+
+int DatagramSocket::getQueued()
+{
+    int queued;
+    if (ioctl(udp_socket, SIOCOUTQ, &queued) == -1) {
+        return -1;
     }
+    return queued;
 }
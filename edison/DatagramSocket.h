@@ -9,9 +9,18 @@ public:
     DatagramSocket();
     ~DatagramSocket();
     void connect(const char *host, unsigned short port);
-    void bind(unsigned short port);
+    // Returns false if the port could not be bound, the error is printed
+    bool bind(unsigned short port);
+    // Returns false if the packet could not be sent, see getError()
     bool send(const void *data, int size);
+    // errno of the last failed send, ECONNREFUSED when the peer sent an ICMP
+    // port unreachable for a previous packet
+    int getError() const;
+    // Bytes waiting in the send buffer, -1 if unknown
+    int getQueued();
     int udp_socket;
+private:
+    int error;
 };
 
 #endif // DATAGRAMSOCKET_H
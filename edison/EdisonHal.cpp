@@ -0,0 +1,148 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EdisonHal.h"
+#include "mraa.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// SDO_XM and SDO_G are both grounded, so our addresses are:
+#define LSM9DS0_XM  0x1D // Would be 0x1E if SDO_XM is LOW
+#define LSM9DS0_G   0x6B // Would be 0x6A if SDO_G is LOW
+
+#define PWM_FL_PIN 0
+#define PWM_FR_PIN 14
+#define PWM_BR_PIN 20
+#define PWM_BL_PIN 21
+
+// PWM channels of pwmchip0 behind the pins above
+#define PWM_FL_CHANNEL 2
+#define PWM_FR_CHANNEL 1
+#define PWM_BR_CHANNEL 0
+#define PWM_BL_CHANNEL 3
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Output indexes in the SysfsPwm object
+enum {
+    FL,
+    FR,
+    BR,
+    BL
+};
+
+EdisonHal::EdisonHal() :
+    dof(LSM9DS0_G, LSM9DS0_XM),
+    pwm_fl(0),
+    pwm_fr(0),
+    pwm_br(0),
+    pwm_bl(0)
+{
+}
+
+Timestamp EdisonHal::now()
+{
+    return Timestamp::now();
+}
+
+void EdisonHal::beginImu()
+{
+    // The full scales of RawSample
+    dof.begin(LSM9DS0::G_SCALE_245DPS, LSM9DS0::A_SCALE_2G, LSM9DS0::M_SCALE_2GS);
+}
+
+void EdisonHal::readAccel(RawSample &sample)
+{
+    dof.readAccel();
+    sample.accel_timestamp = Timestamp::now();
+    sample.ax = dof.ax;
+    sample.ay = dof.ay;
+    sample.az = dof.az;
+}
+
+void EdisonHal::readGyro(RawSample &sample)
+{
+    dof.readGyro();
+    sample.gyro_timestamp = Timestamp::now();
+    sample.gx = dof.gx;
+    sample.gy = dof.gy;
+    sample.gz = dof.gz;
+}
+
+void EdisonHal::readMag(RawSample &sample)
+{
+    dof.readMag();
+    sample.mx = dof.mx;
+    sample.my = dof.my;
+    sample.mz = dof.mz;
+}
+
+void EdisonHal::readTemperature(RawSample &sample)
+{
+    dof.readTemp();
+    sample.temp = dof.temperature;
+}
+
+void EdisonHal::beginMotors(int period_ns)
+{
+    // mraa configures the pin multiplexing and exports the PWM channels, the
+    // duty cycles are then written directly through sysfs
+    this->pwm_fl = mraa_pwm_init(PWM_FL_PIN);
+    this->pwm_fr = mraa_pwm_init(PWM_FR_PIN);
+    this->pwm_br = mraa_pwm_init(PWM_BR_PIN);
+    this->pwm_bl = mraa_pwm_init(PWM_BL_PIN);
+
+    if (!this->pwm_fl ||
+            !this->pwm_fr ||
+            !this->pwm_br ||
+            !this->pwm_bl ||
+            !pwm.open(FL, PWM_FL_CHANNEL) ||
+            !pwm.open(FR, PWM_FR_CHANNEL) ||
+            !pwm.open(BR, PWM_BR_CHANNEL) ||
+            !pwm.open(BL, PWM_BL_CHANNEL)) {
+        printf("PWM not available.\n");
+        exit(1);
+    }
+
+    pwm.setPeriod(period_ns);
+
+    // The 4 motors are updated together
+    pwm.setUpdateMode(SysfsPwm::UPDATE_SYNCHRONIZED);
+
+    pwm.enable(true);
+}
+
+void EdisonHal::setMotorsPeriod(int period_ns)
+{
+    pwm.setPeriod(period_ns);
+}
+
+void EdisonHal::writeMotors(const float duty[4])
+{
+    pwm.write(FL, duty[FL]);
+    pwm.write(FR, duty[FR]);
+    pwm.write(BR, duty[BR]);
+    pwm.write(BL, duty[BL]);
+    pwm.update();
+}
+
+}
+}
+}
@@ -0,0 +1,65 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _EDISONHAL_H_
+#define _EDISONHAL_H_
+
+#include "Hal.h"
+#include "SysfsPwm.h"
+#include "mraa.hpp"
+#include <SFE_LSM9DS0.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Intel Edison hardware: LSM9DS0 on the I2C bus and ESC on the PWM outputs.
+ *
+ * <p>
+ * mraa must be initialized before the construction, which opens the I2C bus.
+ * </p>
+ */
+class EdisonHal : public Hal {
+public:
+    EdisonHal();
+    Timestamp now();
+    void beginImu();
+    void readAccel(RawSample & sample);
+    void readGyro(RawSample & sample);
+    void readMag(RawSample & sample);
+    void readTemperature(RawSample & sample);
+    void beginMotors(int period_ns);
+    void setMotorsPeriod(int period_ns);
+    void writeMotors(const float duty[4]);
+private:
+    // LSM3DS0 sensor
+    LSM9DS0 dof;
+
+    SysfsPwm pwm;
+    mraa_pwm_context pwm_fl;
+    mraa_pwm_context pwm_fr;
+    mraa_pwm_context pwm_br;
+    mraa_pwm_context pwm_bl;
+};
+
+}
+}
+}
+
+#endif
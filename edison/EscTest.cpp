@@ -0,0 +1,152 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "EscTest.h"
+#include "FlightService.h"
+#include "SimulatedVehicle.h"
+#include <math.h>
+#include <stdio.h>
+
+// Control period, in seconds, and the largest random delay added to it
+#define CONTROL_PERIOD .0025f
+#define CONTROL_JITTER .0005f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float EscTest::WIDTH_TOLERANCE;
+
+// Period and pulse range of each protocol, in microseconds
+static const struct {
+    CommandPacket::MotorsConfig::Protocol protocol;
+    const char *name;
+    float period;
+    float min_pulse;
+    float max_pulse;
+} PROTOCOLS[] = {
+    { CommandPacket::MotorsConfig::PWM, "PWM", 1000000.f / 450.f, 1000.f, 2000.f },
+    { CommandPacket::MotorsConfig::ONESHOT125, "OneShot125", 500.f, 125.f, 250.f },
+    { CommandPacket::MotorsConfig::ONESHOT42, "OneShot42", 168.f, 42.f, 84.f },
+};
+
+/**
+ * Simulated vehicle which computes the edges of the pulses of its motor
+ * outputs, in nanoseconds from the start of the PWM.
+ */
+class EdgeTimestampingVehicle : public SimulatedVehicle {
+public:
+    EdgeTimestampingVehicle(const VehicleParameters & parameters) :
+        SimulatedVehicle(parameters, 1),
+        origin(0.),
+        period_ns(0.),
+        writes(0),
+        written(0.),
+        rising(0.)
+    {
+        for (int i = 0; i < 4; i++) {
+            falling[i] = 0.;
+        }
+    }
+
+    void beginMotors(int period_ns)
+    {
+        setMotorsPeriod(period_ns);
+    }
+
+    void setMotorsPeriod(int period_ns)
+    {
+        // The PWM restarts with the new period
+        origin = (double)now() * 1.e9;
+        this->period_ns = period_ns;
+    }
+
+    void writeMotors(const float duty[4])
+    {
+        SimulatedVehicle::writeMotors(duty);
+        writes++;
+        written = (double)now() * 1.e9 - origin;
+        rising = (floor(written / period_ns) + 1.) * period_ns;
+        for (int i = 0; i < 4; i++) {
+            falling[i] = rising + duty[i] * period_ns;
+        }
+    }
+
+    double origin;
+    double period_ns;
+    int writes;
+
+    // Write of the last duty cycles and edges of the first pulse carrying them
+    double written;
+    double rising;
+    double falling[4];
+};
+
+bool EscTest::run(int commands)
+{
+    bool passed = true;
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    for (unsigned int p = 0; p < sizeof(PROTOCOLS) / sizeof(PROTOCOLS[0]); p++) {
+        EdgeTimestampingVehicle vehicle(parameters);
+        FlightService service(&vehicle);
+        CommandPacket::MotorsConfig config;
+        config.set_min_pwm(0.);
+        config.set_max_pwm(0.);
+        config.set_protocol(PROTOCOLS[p].protocol);
+        if (PROTOCOLS[p].protocol == CommandPacket::MotorsConfig::PWM) {
+            config.set_min_pulse(PROTOCOLS[p].min_pulse);
+            config.set_max_pulse(PROTOCOLS[p].max_pulse);
+        }
+        service.motors.setConfig(config);
+        service.motors.begin();
+
+        Random random(p + 1);
+        float max_latency = 0.;
+        float max_error = 0.;
+        bool immediate = true;
+        for (int i = 0; i < commands; i++) {
+            vehicle.advance(CONTROL_PERIOD + random.uniform(0.f, CONTROL_JITTER));
+            MotorsCommand command = {};
+            command.altitude_throttle = random.uniform(0.f, 1.f);
+            int writes = vehicle.writes;
+            service.motors.setControl(command);
+            immediate = immediate && vehicle.writes == writes + 1;
+
+            float expected = PROTOCOLS[p].min_pulse + command.altitude_throttle * (PROTOCOLS[p].max_pulse - PROTOCOLS[p].min_pulse);
+            for (int j = 0; j < 4; j++) {
+                float width = (vehicle.falling[j] - vehicle.rising) * 1.e-3;
+                float latency = (vehicle.falling[j] - vehicle.written) * 1.e-3;
+                max_error = fmaxf(max_error, fabsf(width - expected));
+                max_latency = fmaxf(max_latency, latency);
+            }
+        }
+
+        float bound = PROTOCOLS[p].period + PROTOCOLS[p].max_pulse;
+        bool ok = immediate && max_error <= WIDTH_TOLERANCE && max_latency <= bound;
+        fprintf(stderr, "EscTest: %s, pulse width error %.3fus, latency %.0fus (bound %.0fus)%s%s\n",
+                PROTOCOLS[p].name, max_error, max_latency, bound,
+                immediate ? "" : ", commands not written immediately", ok ? "" : " FAILED");
+        passed = passed && ok;
+    }
+    return passed;
+}
+
+}
+}
+}
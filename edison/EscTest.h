@@ -0,0 +1,57 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ESCTEST_H_
+#define _ESCTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the ESC protocols on a simulated, edge-timestamping output.
+ *
+ * <p>
+ * The motors drive a simulated vehicle whose PWM is free-running from the
+ * last period change, and which latches a new duty cycle at the next rising
+ * edge, like the PWM unit of the Edison. Random throttles are commanded at
+ * the control rate with a random phase, and the width and the falling edge
+ * of the first pulse carrying each command are computed for every protocol.
+ * </p>
+ */
+class EscTest {
+public:
+    static constexpr float WIDTH_TOLERANCE = .1f; // Microseconds
+
+    /**
+     * Runs the given number of commands with each protocol and prints the
+     * largest latencies.
+     *
+     * @return false if a command is not written immediately, if a pulse
+     *         width differs from the protocol range by more than
+     *         WIDTH_TOLERANCE, or if a pulse ends later than one period plus
+     *         the longest pulse after the command.
+     */
+    static bool run(int commands);
+};
+
+}
+}
+}
+
+#endif
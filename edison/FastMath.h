@@ -0,0 +1,184 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FASTMATH_H_
+#define _FASTMATH_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/*
+ * Bounded-error approximations of the transcendental functions used by the
+ * sensor fusion.
+ *
+ * The functions are branch-free polynomial evaluations, the compiler turns the
+ * selections into conditional moves. The maximum errors below have been
+ * measured against the double precision libm: on every float of [-1, 1] for
+ * fastAsinf() and every positive normal float for fastInvSqrtf() by
+ * --benchmark-math, which also times them against libm, and on a dense sweep
+ * of the plane for fastAtan2f(). The self test checks them on samples.
+ *
+ * The batch variants process arrays, for instance the samples drained from the
+ * sensor FIFO, 4 elements at a time with SSE2 when available.
+ */
+
+#define FAST_PI_2 1.57079632679489661923f
+#define FAST_PI   3.14159265358979323846f
+
+// Maximum errors of the approximations, checked by MathTest
+#define FAST_ATAN2_MAX_ERROR 1.2e-5f
+#define FAST_ASIN_MAX_ERROR 3.0e-7f
+#define FAST_INVSQRT_MAX_RELATIVE_ERROR 4.8e-6f
+
+// atan(x) for x in [0, 1], Abramowitz & Stegun 4.4.49
+static inline float fastAtanUnit(float x)
+{
+    float s = x * x;
+    return x * (0.9998660f + s * (-0.3302995f + s * (0.1801410f + s * (-0.0851330f + s * 0.0208351f))));
+}
+
+/**
+ * atan2f() approximation.
+ *
+ * <p>
+ * Maximum absolute error: 1.2e-5 rad. Returns 0 for (0, 0).
+ * </p>
+ */
+static inline float fastAtan2f(float y, float x)
+{
+    float ax = fabsf(x);
+    float ay = fabsf(y);
+    float mx = fmaxf(ax, ay);
+    float mn = fminf(ax, ay);
+    float r = fastAtanUnit(mn / fmaxf(mx, 1e-30f));
+    r = (ay > ax) ? FAST_PI_2 - r : r;
+    r = (x < 0.f) ? FAST_PI - r : r;
+    return copysignf(r, y);
+}
+
+/**
+ * asinf() approximation, for x in [-1, 1].
+ *
+ * <p>
+ * Maximum absolute error: 3.0e-7 rad. The input is clamped to [-1, 1].
+ * </p>
+ */
+static inline float fastAsinf(float x)
+{
+    // Abramowitz & Stegun 4.4.46
+    float a = fminf(fabsf(x), 1.f);
+    float p = 1.5707963050f + a * (-0.2145988016f + a * (0.0889789874f + a * (-0.0501743046f +
+              a * (0.0308918810f + a * (-0.0170881256f + a * (0.0066700901f + a * -0.0012624911f))))));
+    return copysignf(FAST_PI_2 - sqrtf(1.f - a) * p, x);
+}
+
+/**
+ * 1 / sqrtf() approximation, for x > 0.
+ *
+ * <p>
+ * Maximum relative error: 4.8e-6.
+ * </p>
+ */
+static inline float fastInvSqrtf(float x)
+{
+    uint32_t i;
+    memcpy(&i, &x, sizeof(i));
+    i = 0x5f375a86 - (i >> 1);
+    float y;
+    memcpy(&y, &i, sizeof(y));
+    // Two Newton-Raphson iterations
+    float h = .5f * x;
+    y = y * (1.5f - h * y * y);
+    y = y * (1.5f - h * y * y);
+    return y;
+}
+
+/**
+ * Batch fastAtan2f(), out[i] = atan2(y[i], x[i]).
+ */
+static inline void fastAtan2f(const float *y, const float *x, float *out, int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128 sign = _mm_set1_ps(-0.f);
+    const __m128 pi_2 = _mm_set1_ps(FAST_PI_2);
+    const __m128 pi = _mm_set1_ps(FAST_PI);
+    const __m128 tiny = _mm_set1_ps(1e-30f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vy = _mm_loadu_ps(y + i);
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 ax = _mm_andnot_ps(sign, vx);
+        __m128 ay = _mm_andnot_ps(sign, vy);
+        __m128 a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), tiny));
+        __m128 s = _mm_mul_ps(a, a);
+        __m128 r = _mm_add_ps(_mm_set1_ps(-0.0851330f), _mm_mul_ps(s, _mm_set1_ps(0.0208351f)));
+        r = _mm_add_ps(_mm_set1_ps(0.1801410f), _mm_mul_ps(s, r));
+        r = _mm_add_ps(_mm_set1_ps(-0.3302995f), _mm_mul_ps(s, r));
+        r = _mm_add_ps(_mm_set1_ps(0.9998660f), _mm_mul_ps(s, r));
+        r = _mm_mul_ps(a, r);
+        __m128 swap = _mm_cmpgt_ps(ay, ax);
+        r = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(pi_2, r)), _mm_andnot_ps(swap, r));
+        __m128 neg = _mm_cmplt_ps(vx, _mm_setzero_ps());
+        r = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(pi, r)), _mm_andnot_ps(neg, r));
+        r = _mm_or_ps(r, _mm_and_ps(sign, vy));
+        _mm_storeu_ps(out + i, r);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = fastAtan2f(y[i], x[i]);
+    }
+}
+
+/**
+ * Batch fastInvSqrtf(), out[i] = 1 / sqrt(x[i]).
+ */
+static inline void fastInvSqrtf(const float *x, float *out, int n)
+{
+    int i = 0;
+#ifdef __SSE2__
+    const __m128i magic = _mm_set1_epi32(0x5f375a86);
+    const __m128 half = _mm_set1_ps(.5f);
+    const __m128 three_halves = _mm_set1_ps(1.5f);
+    for (; i + 4 <= n; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i);
+        __m128 y = _mm_castsi128_ps(_mm_sub_epi32(magic, _mm_srli_epi32(_mm_castps_si128(vx), 1)));
+        __m128 h = _mm_mul_ps(half, vx);
+        // Same rounding as the scalar iterations, h * y * y
+        y = _mm_mul_ps(y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(h, y), y)));
+        y = _mm_mul_ps(y, _mm_sub_ps(three_halves, _mm_mul_ps(_mm_mul_ps(h, y), y)));
+        _mm_storeu_ps(out + i, y);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = fastInvSqrtf(x[i]);
+    }
+}
+
+}
+}
+}
+
+#endif
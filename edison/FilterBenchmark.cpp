@@ -0,0 +1,257 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FilterBenchmark.h"
+#include "AttitudeEkf.h"
+#include "BiquadBank.h"
+#include "Mahony.h"
+#include "SimulatedVehicle.h"
+#include "Timestamp.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Sample period, in nanoseconds
+#define SAMPLE_PERIOD_NS 2500000
+
+// Constant rotation, long enough for its integral to overflow a Fixed<24>,
+// in radians per second and samples
+#define SPIN_RATE 4.f
+#define SPIN_SAMPLES 16000
+
+// Standard gravity, in m/s^2
+#define GRAVITY 9.80665f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float FilterBenchmark::TOLERANCE;
+
+// Raw gyroscope rate and accelerometer values around one axis
+struct AxisSample {
+    int32_t gyro;
+    int32_t accel_y;
+    int32_t accel_x;
+};
+
+// Rates, specific force and magnetic field of the three axes
+struct BodySample {
+    float gyro[3]; // rad/s
+    float accel[3]; // m/s^2
+    float mag[3]; // Gauss
+};
+
+template <class N>
+static float measure(ComplementaryFilter<N> & filter, const AxisSample *samples, int count, float *angles)
+{
+    filter.setConfig(1.f, .01f, 1.f, .02f);
+    filter.setCalibration(10.f);
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < count; i++) {
+        filter.update(samples[i].gyro, samples[i].accel_y, samples[i].accel_x, SAMPLE_PERIOD_NS);
+        angles[i] = filter.getAngle();
+    }
+    return Timestamp::now() - start;
+}
+
+bool FilterBenchmark::run(int count)
+{
+    AxisSample *samples = new AxisSample[count];
+    float *floats = new float[count];
+    float *fixeds = new float[count];
+
+    // Oscillation of 0.5 rad at 0.7 Hz and 0.1 rad at 3.1 Hz, the accelerometer
+    // also sees the other axis at 30 degrees
+    Random random(1);
+    const float gyro_scale = RawSample::GYRO_RESOLUTION * (float)(M_PI / 180.);
+    for (int i = 0; i < count; i++) {
+        float t = i * SAMPLE_PERIOD_NS * 1.e-9f;
+        float w1 = 2.f * (float)M_PI * .7f;
+        float w2 = 2.f * (float)M_PI * 3.1f;
+        float angle = .5f * sinf(w1 * t) + .1f * sinf(w2 * t);
+        float rate = .5f * w1 * cosf(w1 * t) + .1f * w2 * cosf(w2 * t);
+        samples[i].gyro = lrintf(rate / gyro_scale + 10.f + 20.f * random.gaussian());
+        samples[i].accel_y = lrintf((sinf(angle) + .01f * random.gaussian()) / RawSample::ACCEL_RESOLUTION);
+        samples[i].accel_x = lrintf((cosf(angle) * cosf(.5f) + .01f * random.gaussian()) / RawSample::ACCEL_RESOLUTION);
+    }
+
+    ComplementaryFilter<float> float_filter;
+    ComplementaryFilter< Fixed<24> > fixed_filter;
+    float float_time = measure(float_filter, samples, count, floats);
+    float fixed_time = measure(fixed_filter, samples, count, fixeds);
+
+    float difference = 0.;
+    for (int i = 0; i < count; i++) {
+        difference = fmaxf(difference, fabsf(fixeds[i] - floats[i]));
+    }
+    fprintf(stderr, "FilterBenchmark: %d samples, float %.1fns, fixed-point %.1fns per sample, largest difference %.2e rad\n",
+            count, float_time / count * 1.e9, fixed_time / count * 1.e9, difference);
+
+    delete[] samples;
+    delete[] floats;
+    delete[] fixeds;
+
+    // Level vehicle spinning around the axis, as a large gyroscope bias would
+    // make it seem
+    AxisSample spin = {
+        (int32_t)lrintf(SPIN_RATE / gyro_scale + 10.f),
+        0,
+        (int32_t)lrintf(1.f / RawSample::ACCEL_RESOLUTION)
+    };
+    AxisSample *spins = new AxisSample[SPIN_SAMPLES];
+    float *float_spins = new float[SPIN_SAMPLES];
+    float *fixed_spins = new float[SPIN_SAMPLES];
+    for (int i = 0; i < SPIN_SAMPLES; i++) {
+        spins[i] = spin;
+    }
+    ComplementaryFilter<float> float_spin_filter;
+    ComplementaryFilter< Fixed<24> > fixed_spin_filter;
+    measure(float_spin_filter, spins, SPIN_SAMPLES, float_spins);
+    measure(fixed_spin_filter, spins, SPIN_SAMPLES, fixed_spins);
+    float spin_difference = 0.;
+    for (int i = 0; i < SPIN_SAMPLES; i++) {
+        spin_difference = fmaxf(spin_difference, fabsf(fixed_spins[i] - float_spins[i]));
+    }
+    fprintf(stderr, "FilterBenchmark: %.0f rad integrated, largest difference %.2e rad\n",
+            SPIN_RATE * SPIN_SAMPLES * SAMPLE_PERIOD_NS * 1.e-9f, spin_difference);
+
+    delete[] spins;
+    delete[] float_spins;
+    delete[] fixed_spins;
+    return difference <= TOLERANCE && spin_difference <= TOLERANCE;
+}
+
+bool FilterBenchmark::timeEstimators(int count)
+{
+    // Oscillations of 0.5 rad at 0.7 Hz on roll and 0.3 rad at 1.3 Hz on
+    // pitch, turning at 0.2 rad/s, with noise
+    BodySample *samples = new BodySample[count];
+    AxisSample *roll_samples = new AxisSample[count];
+    AxisSample *pitch_samples = new AxisSample[count];
+    Random random(2);
+    const float gyro_scale = RawSample::GYRO_RESOLUTION * (float)(M_PI / 180.);
+    for (int i = 0; i < count; i++) {
+        float t = i * SAMPLE_PERIOD_NS * 1.e-9f;
+        float w1 = 2.f * (float)M_PI * .7f;
+        float w2 = 2.f * (float)M_PI * 1.3f;
+        float roll = .5f * sinf(w1 * t);
+        float pitch = .3f * sinf(w2 * t + 1.f);
+        BodySample & s = samples[i];
+        s.gyro[0] = .5f * w1 * cosf(w1 * t) + .01f * random.gaussian();
+        s.gyro[1] = .3f * w2 * cosf(w2 * t + 1.f) + .01f * random.gaussian();
+        s.gyro[2] = .2f + .01f * random.gaussian();
+        // The accelerometer measures the opposite of the gravity, down is z
+        s.accel[0] = GRAVITY * (sinf(pitch) + .01f * random.gaussian());
+        s.accel[1] = GRAVITY * (-sinf(roll) * cosf(pitch) + .01f * random.gaussian());
+        s.accel[2] = GRAVITY * (-cosf(roll) * cosf(pitch) + .01f * random.gaussian());
+        s.mag[0] = .2f * cosf(.2f * t);
+        s.mag[1] = -.2f * sinf(.2f * t);
+        s.mag[2] = .4f;
+        roll_samples[i].gyro = lrintf(s.gyro[0] / gyro_scale);
+        roll_samples[i].accel_y = lrintf(-s.accel[1] / GRAVITY / RawSample::ACCEL_RESOLUTION);
+        roll_samples[i].accel_x = lrintf(-s.accel[2] / GRAVITY / RawSample::ACCEL_RESOLUTION);
+        pitch_samples[i].gyro = lrintf(s.gyro[1] / gyro_scale);
+        pitch_samples[i].accel_y = lrintf(s.accel[0] / GRAVITY / RawSample::ACCEL_RESOLUTION);
+        pitch_samples[i].accel_x = roll_samples[i].accel_x;
+    }
+    const float dt = SAMPLE_PERIOD_NS * 1.e-9f;
+    float sink = 0.f;
+
+    // Gyroscope filters, a low-pass, a static notch and a dynamic notch like
+    // those of Sensors
+    BiquadBank bank;
+    bank.setSampleRate(1.e9f / SAMPLE_PERIOD_NS);
+    bank.addLowPass(80.f, .707f);
+    bank.addNotch(120.f, 3.f);
+    const float peaks[BiquadBank::LANES] = { 90.f, 95.f, 100.f, 100.f };
+    bank.addNotch(peaks, 3.f);
+    Timestamp start = Timestamp::now();
+    for (int i = 0; i < count; i++) {
+        const BodySample & s = samples[i];
+        BiquadBank::Vector rates = { s.gyro[0], s.gyro[1], s.gyro[2], 0.f };
+        bank.filter(rates);
+        sink += rates[0] + rates[1] + rates[2];
+    }
+    float bank_time = Timestamp::now() - start;
+
+    // Roll and pitch complementary filters, used by default
+    ComplementaryFilter<float> roll_filter, pitch_filter;
+    roll_filter.setConfig(1.f, 0.f, 1.f, 0.f);
+    pitch_filter.setConfig(1.f, 0.f, 1.f, 0.f);
+    start = Timestamp::now();
+    for (int i = 0; i < count; i++) {
+        roll_filter.update(roll_samples[i].gyro, roll_samples[i].accel_y, roll_samples[i].accel_x, SAMPLE_PERIOD_NS);
+        pitch_filter.update(pitch_samples[i].gyro, pitch_samples[i].accel_y, pitch_samples[i].accel_x, SAMPLE_PERIOD_NS);
+        sink += roll_filter.getAngle() + pitch_filter.getAngle();
+    }
+    float complementary_time = Timestamp::now() - start;
+
+    // Mahony, which gets the gravity direction, without and with the
+    // magnetometer
+    float mahony_times[2];
+    for (int m = 0; m < 2; m++) {
+        Mahony mahony;
+        mahony.setGains(.5f, 0.f);
+        start = Timestamp::now();
+        for (int i = 0; i < count; i++) {
+            const BodySample & s = samples[i];
+            mahony.update(s.gyro[0], s.gyro[1], s.gyro[2], -s.accel[0], -s.accel[1], -s.accel[2],
+                          s.mag[0], s.mag[1], s.mag[2], (float)m, dt);
+            float roll, pitch, yaw;
+            mahony.getEuler(roll, pitch, yaw);
+            sink += roll + pitch + yaw;
+        }
+        mahony_times[m] = Timestamp::now() - start;
+    }
+
+    // EKF, each step timed separately with the default noise parameters
+    AttitudeEkf ekf;
+    ekf.setNoise(.01f, .0005f, .05f, .5f, 5.f);
+    float predict_time = 0.f;
+    float gravity_time = 0.f;
+    for (int i = 0; i < count; i++) {
+        const BodySample & s = samples[i];
+        start = Timestamp::now();
+        ekf.predict(s.gyro[0], s.gyro[1], s.gyro[2], s.accel[0], s.accel[1], s.accel[2], dt);
+        Timestamp predicted = Timestamp::now();
+        ekf.updateGravity(s.accel[0], s.accel[1], s.accel[2]);
+        Timestamp updated = Timestamp::now();
+        predict_time += predicted - start;
+        gravity_time += updated - predicted;
+        sink += ekf.get(AttitudeEkf::ROLL) + ekf.get(AttitudeEkf::PITCH);
+    }
+
+    fprintf(stderr, "FilterBenchmark: %d samples, complementary filters %.1fns, Mahony %.1fns, "
+            "Mahony with the magnetometer %.1fns per sample\n",
+            count, complementary_time / count * 1.e9, mahony_times[0] / count * 1.e9, mahony_times[1] / count * 1.e9);
+    fprintf(stderr, "FilterBenchmark: EKF prediction %.1fns, gravity update %.1fns per sample, %.3f%% of the sample period\n",
+            predict_time / count * 1.e9, gravity_time / count * 1.e9,
+            (predict_time + gravity_time) / count * 1.e9 / SAMPLE_PERIOD_NS * 100.);
+    fprintf(stderr, "FilterBenchmark: %d gyroscope filters %.1fns per sample\n",
+            bank.size(), bank_time / count * 1.e9);
+
+    delete[] samples;
+    delete[] roll_samples;
+    delete[] pitch_samples;
+    return isfinite(sink);
+}
+
+}
+}
+}
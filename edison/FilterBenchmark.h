@@ -0,0 +1,66 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FILTERBENCHMARK_H_
+#define _FILTERBENCHMARK_H_
+
+#include "ComplementaryFilter.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Comparison of the float and fixed-point complementary filters, and timings
+ * of the attitude estimators.
+ *
+ * <p>
+ * Both filters process the same synthetic samples of a vehicle oscillating
+ * on roll and pitch, with noise. The time per sample of each filter is
+ * measured, and the angles of the fixed-point filter must stay within
+ * TOLERANCE of the float ones. They must also stay within TOLERANCE while
+ * the filters integrate a constant rotation beyond the range of a Fixed.
+ * </p>
+ */
+class FilterBenchmark {
+public:
+    static constexpr float TOLERANCE = 1.e-4f; // Radians
+
+    /**
+     * Runs the comparison and prints the results.
+     *
+     * @return false if the fixed-point angles differ by more than TOLERANCE,
+     *         during the oscillations or the rotation.
+     */
+    static bool run(int samples);
+
+    /**
+     * Prints the time per sample of each attitude estimator of Sensors and of
+     * the gyroscope filters, on synthetic rates, accelerations and magnetic
+     * fields of a vehicle oscillating on roll and pitch while it turns.
+     *
+     * @return false if an estimate is not finite.
+     */
+    static bool timeEstimators(int samples);
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,200 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FIXED_H_
+#define _FIXED_H_
+
+#include "FastMath.h"
+#include <math.h>
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Signed fixed-point number, with F fractional bits in 32 bits.
+ *
+ * <p>
+ * The products and the conversions are rounded to the nearest. The operations
+ * do not saturate, the user must keep the values in the range of
+ * +/-2^(31-F).
+ * </p>
+ *
+ * @param F
+ *            Number of fractional bits.
+ */
+template <int F>
+class Fixed {
+
+public:
+    static const int FRACTIONAL_BITS = F;
+
+    int32_t raw; // value * 2^F
+
+    Fixed() : raw(0) {}
+
+    static Fixed fromRaw(int64_t raw) {
+        Fixed f;
+        f.raw = (int32_t)raw;
+        return f;
+    }
+
+    static Fixed fromFloat(float value) {
+        return fromRaw((int64_t)lrintf(ldexpf(value, F)));
+    }
+
+    float toFloat() const {
+        return ldexpf((float)raw, -F);
+    }
+
+    Fixed operator +(Fixed that) const {
+        return fromRaw(raw + that.raw);
+    }
+
+    Fixed operator -(Fixed that) const {
+        return fromRaw(raw - that.raw);
+    }
+
+    Fixed operator -() const {
+        return fromRaw(-raw);
+    }
+
+    Fixed operator *(Fixed that) const {
+        return fromRaw(((int64_t)raw * that.raw + (1 << (F - 1))) >> F);
+    }
+
+    bool operator <(Fixed that) const {
+        return raw < that.raw;
+    }
+
+    bool operator >(Fixed that) const {
+        return raw > that.raw;
+    }
+};
+
+/**
+ * Operations of the sensor pipelines which depend on the number type, N is
+ * float or Fixed.
+ *
+ * <p>
+ * A Factor converts the integer sensor values with a better precision than a
+ * number of type N, the factors of the raw values are around 1e-4.
+ * </p>
+ */
+template <class N>
+struct Arithmetic;
+
+template <>
+struct Arithmetic<float> {
+    typedef float Factor;
+
+    static float fromFloat(float value) {
+        return value;
+    }
+
+    static float toFloat(float value) {
+        return value;
+    }
+
+    static Factor factor(float value) {
+        return value;
+    }
+
+    static float scale(int32_t value, Factor factor) {
+        return value * factor;
+    }
+
+    static float seconds(int64_t ns) {
+        return ns * 1.e-9f;
+    }
+
+    static float atan2(int32_t y, int32_t x) {
+        return fastAtan2f(y, x);
+    }
+};
+
+template <int F>
+struct Arithmetic< Fixed<F> > {
+    typedef Fixed<F> N;
+
+    // Factor * 2^(F + FACTOR_BITS), for factors below 2^6 and values below 2^17
+    typedef int64_t Factor;
+    static const int FACTOR_BITS = 16;
+
+    static N fromFloat(float value) {
+        return N::fromFloat(value);
+    }
+
+    static float toFloat(N value) {
+        return value.toFloat();
+    }
+
+    static Factor factor(float value) {
+        return llrint(ldexp(value, F + FACTOR_BITS));
+    }
+
+    static N scale(int32_t value, Factor factor) {
+        return N::fromRaw((value * factor + (1 << (FACTOR_BITS - 1))) >> FACTOR_BITS);
+    }
+
+    static N seconds(int64_t ns) {
+        return N::fromRaw((ns << F) / 1000000000);
+    }
+
+    /**
+     * Same approximation as fastAtan2f(), in integers.
+     */
+    static N atan2(int32_t y, int32_t x) {
+        // Coefficients in Q30
+        static const int64_t ONE = 1 << 30;
+        static const int64_t C0 = (int64_t)(0.9998660 * ONE);
+        static const int64_t C1 = (int64_t)(-0.3302995 * ONE);
+        static const int64_t C2 = (int64_t)(0.1801410 * ONE);
+        static const int64_t C3 = (int64_t)(-0.0851330 * ONE);
+        static const int64_t C4 = (int64_t)(0.0208351 * ONE);
+        static const int64_t HALF_PI = (int64_t)(1.57079632679489661923 * ONE);
+        static const int64_t PI = (int64_t)(3.14159265358979323846 * ONE);
+
+        int64_t ax = x < 0 ? -(int64_t)x : x;
+        int64_t ay = y < 0 ? -(int64_t)y : y;
+        int64_t mx = ax > ay ? ax : ay;
+        int64_t mn = ax > ay ? ay : ax;
+        if (!mx) {
+            return N();
+        }
+        int64_t t = (mn << 30) / mx;
+        int64_t s = (t * t) >> 30;
+        int64_t r = C4;
+        r = C3 + ((s * r) >> 30);
+        r = C2 + ((s * r) >> 30);
+        r = C1 + ((s * r) >> 30);
+        r = C0 + ((s * r) >> 30);
+        r = (t * r) >> 30;
+        r = ay > ax ? HALF_PI - r : r;
+        r = x < 0 ? PI - r : r;
+        r = y < 0 ? -r : r;
+        return N::fromRaw((r + (1 << (29 - F))) >> (30 - F));
+    }
+};
+
+}
+}
+}
+
+#endif
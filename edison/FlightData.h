@@ -0,0 +1,87 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FLIGHTDATA_H_
+#define _FLIGHTDATA_H_
+
+#include "Timestamp.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/*
+ * Plain structures exchanged by the control loop. The protobuf messages with
+ * the same content are only used to communicate with the ground station.
+ */
+
+/**
+ * Attitude, see the Attitude message.
+ */
+struct AttitudeState {
+    float altitude; // Altitude from ground in meters
+    float roll; // Roll in radians
+    float roll_rate; // Roll rate in radians/sec
+    float pitch; // Pitch in radians
+    float pitch_rate; // Pitch rate in radians/sec
+    float yaw; // Yaw in radians, valid if has_yaw
+    float yaw_rate; // Yaw rate in radians/sec
+    bool has_yaw;
+    Timestamp timestamp;
+};
+
+/**
+ * Motors throttles, see the MotorsControl message.
+ */
+struct MotorsCommand {
+    float altitude_throttle;
+    float roll_throttle;
+    float pitch_throttle;
+    float yaw_throttle;
+    Timestamp timestamp;
+};
+
+/**
+ * Landing gear switches, see the Switches message.
+ */
+struct SwitchesState {
+    bool front_left;
+    bool front_right;
+    bool back_right;
+    bool back_left;
+};
+
+/**
+ * Clock synchronization and command latency, see the Latency message.
+ */
+struct LatencyState {
+    double clock_offset; // Ground clock minus air clock, in seconds
+    float clock_skew;
+    float round_trip;
+    int count;
+    float p50;
+    float p90;
+    float p99;
+    float max;
+};
+
+}
+}
+}
+
+#endif
@@ -17,11 +17,160 @@
  */
 
 #include "FlightService.h"
+#include "EdisonHal.h"
+#include "Replay.h"
+#include "Simulation.h"
+#include "Autotune.h"
+#include "FilterBenchmark.h"
+#include "ControlBenchmark.h"
+#include "LinkTest.h"
+#include "MathTest.h"
+#include "SelfTest.h"
 #include "mraa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Duration of each simulated flight, in seconds
+#define SIMULATION_DURATION 10.f
+
+// Autotune vehicles per candidate, flight duration and iterations
+#define AUTOTUNE_VEHICLES 16
+#define AUTOTUNE_DURATION 5.f
+#define AUTOTUNE_ITERATIONS 100
+
+// Samples of the filter comparison, a minute of flight
+#define BENCHMARK_SAMPLES 24000
+
+// Samples of the estimator timings, about seventeen minutes of flight
+#define ESTIMATOR_BENCHMARK_SAMPLES 400000
+
+// Inputs of the approximation timings
+#define MATH_BENCHMARK_SAMPLES 4000000
+
+// Ticks of the control path benchmark, about two hours of flight
+#define CONTROL_BENCHMARK_TICKS 2000000
+
+// Clock exchanges of the link test, about 32 seconds, which fill the
+// ClockSync groups of the skew fit
+#define LINK_TEST_EXCHANGES 160
+
+using org::hummingdroid::CommandPacket;
+
+// Reads a serialized CommandPacket
+static bool loadConfig(const char *path, CommandPacket & config)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    char data[org::hummingdroid::flightapp::Receiver::MAX_PACKET_SIZE];
+    int size = fread(data, 1, sizeof(data), file);
+    fclose(file);
+    if (!config.ParseFromArray(data, size)) {
+        fprintf(stderr, "Invalid configuration in %s\n", path);
+        return false;
+    }
+    return true;
+}
+
+// Writes a serialized CommandPacket, which can be sent as is to the receiver
+static bool saveConfig(const char *path, const CommandPacket & config)
+{
+    char data[org::hummingdroid::flightapp::Receiver::MAX_PACKET_SIZE];
+    if (!config.SerializeToArray(data, sizeof(data))) {
+        fprintf(stderr, "Configuration too large\n");
+        return false;
+    }
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return false;
+    }
+    bool written = (int)fwrite(data, 1, config.GetCachedSize(), file) == config.GetCachedSize();
+    return !fclose(file) && written;
+}
 
-static org::hummingdroid::flightapp::FlightService app;
 int main(int argc, char* argv[]) {
+    // Simulated flights, with the default configuration or the given one
+    CommandPacket config;
+    org::hummingdroid::flightapp::Simulation::getDefaultConfig(config);
+    bool configured = false;
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--config") && i + 1 < argc) {
+            if (!loadConfig(argv[++i], config)) {
+                return 1;
+            }
+            configured = true;
+        }
+    }
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--simulate") && i + 1 < argc) {
+            // Fly simulated vehicles instead of the hardware, then with gain
+            // schedules when no configuration is given
+            int vehicles = atoi(argv[i + 1]);
+            bool passed = org::hummingdroid::flightapp::Simulation::runMonteCarlo(vehicles, SIMULATION_DURATION, config);
+            if (!configured) {
+                CommandPacket scheduled;
+                org::hummingdroid::flightapp::Simulation::getScheduledConfig(scheduled);
+                passed = org::hummingdroid::flightapp::Simulation::runMonteCarlo(vehicles, SIMULATION_DURATION, scheduled) && passed;
+            }
+            return passed ? 0 : 1;
+        } else if (!strcmp(argv[i], "--autotune") && i + 1 < argc) {
+            // Tune the gains on simulated vehicles and save the configuration
+            org::hummingdroid::flightapp::Autotune autotune(AUTOTUNE_VEHICLES, AUTOTUNE_DURATION);
+            if (!autotune.run(config, AUTOTUNE_ITERATIONS)) {
+                return 1;
+            }
+            return saveConfig(argv[i + 1], config) ? 0 : 1;
+        } else if (!strcmp(argv[i], "--benchmark-filters")) {
+            // Compare the float and fixed-point complementary filters, and
+            // time the other estimators
+            bool passed = org::hummingdroid::flightapp::FilterBenchmark::run(BENCHMARK_SAMPLES);
+            passed = org::hummingdroid::flightapp::FilterBenchmark::timeEstimators(ESTIMATOR_BENCHMARK_SAMPLES) && passed;
+            return passed ? 0 : 1;
+        } else if (!strcmp(argv[i], "--benchmark-math")) {
+            // Check the approximations on all their inputs and time them
+            // against libm
+            bool passed = org::hummingdroid::flightapp::MathTest::runExhaustive();
+            org::hummingdroid::flightapp::MathTest::benchmark(MATH_BENCHMARK_SAMPLES);
+            return passed ? 0 : 1;
+        } else if (!strcmp(argv[i], "--benchmark-control")) {
+            // Time per sample of the controller and of the telemetry setters
+            return org::hummingdroid::flightapp::ControlBenchmark::run(CONTROL_BENCHMARK_TICKS) ? 0 : 1;
+        } else if (!strcmp(argv[i], "--test-link")) {
+            // Synchronize with a simulated ground station on localhost
+            return org::hummingdroid::flightapp::LinkTest::run(LINK_TEST_EXCHANGES) ? 0 : 1;
+        } else if (!strcmp(argv[i], "--test")) {
+            // Checks which need no hardware
+            return org::hummingdroid::flightapp::SelfTest::run() ? 0 : 1;
+        }
+    }
+
     mraa_init();
+    org::hummingdroid::flightapp::EdisonHal hal;
+    org::hummingdroid::flightapp::FlightService app(&hal);
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--pipeline")) {
+            // Split the sensor acquisition and the fusion on the two CPUs
+            app.sensors.setPipelined(true);
+        } else if (!strcmp(argv[i], "--record") && i + 1 < argc) {
+            // Record the samples and the commands for a later replay
+            if (!app.recorder.open(argv[++i])) {
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--calibration") && i + 1 < argc) {
+            // Calibration file, instead of the default one
+            if (!app.calibration.setPath(argv[++i])) {
+                return 1;
+            }
+        } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            // Replay a record instead of flying
+            org::hummingdroid::flightapp::Replay replay(&app);
+            return replay.run(argv[++i]) ? 0 : 1;
+        }
+    }
     app.loop();
     return 0;
 }
@@ -30,8 +179,13 @@ namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
-FlightService::FlightService() :
+FlightService::FlightService(Hal *hal, int command_port, int telemetry_port) :
+    hal(hal),
+    command_port(command_port),
+    telemetry_port(telemetry_port),
     receiver(this),
+    motors(this),
+    telemetry(this),
     sensors(this),
     controller(this)
 {
@@ -81,6 +235,10 @@ void FlightService::loop()
 {
     // Start the threads
     motors.begin();
+    if (recorder.isRecording()) {
+        recorder.start();
+    }
+    calibration.start();
     telemetry.start();
     receiver.start();
     sensors.run(); // Note: we directly run the sensor thread in the main thread
@@ -19,27 +19,50 @@
 #ifndef _FLIGHTSERVICE_H_
 #define _FLIGHTSERVICE_H_
 
+#include "Hal.h"
 #include "Receiver.h"
 #include "Motors.h"
 #include "Telemetry.h"
 #include "Sensors.h"
 #include "Controller.h"
+#include "Recorder.h"
+#include "Calibration.h"
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+/**
+ * Flight software of one vehicle.
+ *
+ * <p>
+ * The hardware is given as a HAL, and the UDP ports can be changed, so that
+ * several instances can run in the same process, for example to simulate
+ * many vehicles in parallel.
+ * </p>
+ */
 class FlightService {
 
 public:
+    static const int DEFAULT_COMMAND_PORT = 49152;
+    static const int DEFAULT_TELEMETRY_PORT = 49152;
+
+    // Declared first, used by the constructors of the components
+    Hal *hal;
+    int command_port; // Listened by the receiver
+    int telemetry_port; // Ground station port when not configured
+
     Receiver receiver;
     Motors motors;
     Telemetry telemetry;
     Sensors sensors;
     Controller controller;
+    Recorder recorder;
+    Calibration calibration;
 
     // Constructor
-    FlightService();
+    FlightService(Hal *hal, int command_port = DEFAULT_COMMAND_PORT,
+                  int telemetry_port = DEFAULT_TELEMETRY_PORT);
 
     // Loop
     void loop();
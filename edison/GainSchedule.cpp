@@ -0,0 +1,99 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GainSchedule.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+static inline void interpolate(const PIDGains & a, const PIDGains & b, float f, PIDGains & out)
+{
+    out.kp = a.kp + f * (b.kp - a.kp);
+    out.ki = a.ki + f * (b.ki - a.ki);
+    out.kd = a.kd + f * (b.kd - a.kd);
+    out.ko = a.ko + f * (b.ko - a.ko);
+    out.td = a.td + f * (b.td - a.td);
+}
+
+void GainSchedule::clear()
+{
+    enabled = false;
+}
+
+bool GainSchedule::set(const float throttle[], const PIDGains gains[], int count)
+{
+    enabled = false;
+    if (count < 1 || count > MAX_POINTS) {
+        return false;
+    }
+    for (int i = 1; i < count; i++) {
+        if (!(throttle[i] > throttle[i - 1])) {
+            return false;
+        }
+    }
+
+    if (count == 1) {
+        for (int i = 0; i < SIZE; i++) {
+            table[i] = gains[0];
+        }
+        origin = throttle[0];
+        scale = 0.;
+        enabled = true;
+        return true;
+    }
+
+    // Resample the points on a uniform grid
+    origin = throttle[0];
+    float step = (throttle[count - 1] - throttle[0]) / (SIZE - 1);
+    scale = 1. / step;
+    int segment = 0;
+    for (int i = 0; i < SIZE; i++) {
+        float t = origin + i * step;
+        while (segment < count - 2 && t > throttle[segment + 1]) {
+            segment++;
+        }
+        float f = (t - throttle[segment]) / (throttle[segment + 1] - throttle[segment]);
+        if (f > 1.) {
+            f = 1.;
+        }
+        interpolate(gains[segment], gains[segment + 1], f, table[i]);
+    }
+    enabled = true;
+    return true;
+}
+
+void GainSchedule::lookup(float throttle, PIDGains & gains) const
+{
+    float x = (throttle - origin) * scale;
+    if (!(x > 0.)) {
+        // Also catches NaN
+        gains = table[0];
+        return;
+    }
+    if (x >= SIZE - 1) {
+        gains = table[SIZE - 1];
+        return;
+    }
+    int i = (int)x;
+    interpolate(table[i], table[i + 1], x - i, gains);
+}
+
+}
+}
+}
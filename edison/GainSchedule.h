@@ -0,0 +1,91 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GAINSCHEDULE_H_
+#define _GAINSCHEDULE_H_
+
+#include "Value.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * PID gains as a function of the collective throttle.
+ *
+ * <p>
+ * The gains are given at a few throttle points, in increasing order. They are
+ * linearly interpolated once on a uniform grid of SIZE entries, so that a
+ * lookup only computes an index and interpolates between two entries. Below
+ * the first point and above the last one the gains are constant.
+ * </p>
+ *
+ * <p>
+ * The lookups are exact at the grid entries, and thus at the points which
+ * fall on them. A point between two entries is smoothed: within that grid
+ * cell, a gain differs from the piecewise linear one by at most a quarter of
+ * the grid step times the sum of its slope changes at the points inside the
+ * cell.
+ * </p>
+ *
+ * <p>
+ * This is a plain structure, so that it can be part of a configuration
+ * snapshot: a schedule filled with zeros is disabled.
+ * </p>
+ */
+class GainSchedule {
+
+public:
+    static const int MAX_POINTS = 16;
+    static const int SIZE = 32;
+
+    /**
+     * Disables the schedule.
+     */
+    void clear();
+
+    /**
+     * Computes the table from the gains at the given throttle points.
+     *
+     * @return false if the points are not in strictly increasing throttle
+     *         order or their number is not between 1 and MAX_POINTS, in which
+     *         case the schedule is disabled.
+     */
+    bool set(const float throttle[], const PIDGains gains[], int count);
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    /**
+     * Gains at the given throttle, the schedule must be enabled.
+     */
+    void lookup(float throttle, PIDGains & gains) const;
+
+private:
+    PIDGains table[SIZE];
+    float origin;
+    float scale;
+    bool enabled;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "GainScheduleTest.h"
+#include "GainSchedule.h"
+#include <math.h>
+#include <stdio.h>
+
+// Rounding allowed on top of the resampling bound, relative to the gains
+#define TOLERANCE 1.e-5
+
+// Points of the test schedules
+#define ON_GRID_POINTS 4
+#define BETWEEN_GRID_POINTS 5
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+static float PIDGains::*const FIELDS[] = {
+    &PIDGains::kp, &PIDGains::ki, &PIDGains::kd, &PIDGains::ko, &PIDGains::td
+};
+
+static const int FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+// Points on the grid entries, 1/32 apart
+static const float ON_GRID_THROTTLES[ON_GRID_POINTS] = { 0.f, .25f, .5f, .96875f };
+static const PIDGains ON_GRID_GAINS[ON_GRID_POINTS] = {
+    { .1f, 0.f, .01f, .5f, .01f },
+    { .3f, .1f, .02f, .4f, .01f },
+    { .2f, .1f, 0.f, .45f, .02f },
+    { .05f, 0.f, .03f, .3f, .02f },
+};
+
+// Points between the grid entries, with sharp slope changes
+static const float BETWEEN_GRID_THROTTLES[BETWEEN_GRID_POINTS] = { .2f, .33f, .41f, .47f, .8f };
+static const PIDGains BETWEEN_GRID_GAINS[BETWEEN_GRID_POINTS] = {
+    { .08f, .05f, 0.f, 0.f, .01f },
+    { .06f, .05f, .01f, 0.f, .01f },
+    { .1f, .02f, 0.f, .1f, .02f },
+    { .04f, .05f, .02f, 0.f, .01f },
+    { .05f, .05f, 0.f, .1f, .01f },
+};
+
+// Slope of a gain between points k and k + 1
+static double slope(const float throttle[], const PIDGains gains[], int k, int f)
+{
+    return ((double)(gains[k + 1].*FIELDS[f]) - gains[k].*FIELDS[f]) / ((double)throttle[k + 1] - throttle[k]);
+}
+
+// Piecewise linear gain, constant beyond the first and the last points
+static double reference(const float throttle[], const PIDGains gains[], int count, int f, double x)
+{
+    if (!(x > throttle[0])) {
+        return gains[0].*FIELDS[f];
+    }
+    for (int k = 0; k < count - 1; k++) {
+        if (x <= throttle[k + 1]) {
+            return gains[k].*FIELDS[f] + slope(throttle, gains, k, f) * (x - throttle[k]);
+        }
+    }
+    return gains[count - 1].*FIELDS[f];
+}
+
+// Resampling bound documented by GainSchedule, in the grid cell of x
+static double bound(const float throttle[], const PIDGains gains[], int count, int f, double x)
+{
+    if (count < 2 || !(x > throttle[0]) || !(x < throttle[count - 1])) {
+        return 0.;
+    }
+    double step = ((double)throttle[count - 1] - throttle[0]) / (GainSchedule::SIZE - 1);
+    double begin = throttle[0] + floor((x - throttle[0]) / step) * step;
+    double changes = 0.;
+    for (int k = 1; k < count - 1; k++) {
+        if (throttle[k] > begin && throttle[k] < begin + step) {
+            changes += fabs(slope(throttle, gains, k, f) - slope(throttle, gains, k - 1, f));
+        }
+    }
+    return step / 4. * changes;
+}
+
+// Largest errors of a schedule
+struct ScheduleErrors {
+    double largest; // Anywhere
+    double points; // At the points
+    double bound; // Largest resampling bound
+    bool passed;
+};
+
+static void compare(const GainSchedule & schedule, const float throttle[], const PIDGains gains[], int count,
+        float x, bool point, double tolerance, ScheduleErrors & errors)
+{
+    PIDGains looked_up;
+    schedule.lookup(x, looked_up);
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        double error = fabs(looked_up.*FIELDS[f] - reference(throttle, gains, count, f, x));
+        double limit = bound(throttle, gains, count, f, x);
+        errors.largest = fmax(errors.largest, error);
+        errors.bound = fmax(errors.bound, limit);
+        if (point) {
+            errors.points = fmax(errors.points, error);
+        }
+        if (error > limit + tolerance) {
+            if (errors.passed) {
+                fprintf(stderr, "GainScheduleTest: Gain %d at throttle %.5f differs by %.2e, bound %.2e\n",
+                        f, x, error, limit);
+            }
+            errors.passed = false;
+        }
+    }
+}
+
+static bool testSchedule(const char *name, const float throttle[], const PIDGains gains[], int count, int samples)
+{
+    GainSchedule schedule;
+    if (!schedule.set(throttle, gains, count) || !schedule.isEnabled()) {
+        fprintf(stderr, "GainScheduleTest: %s, schedule rejected\n", name);
+        return false;
+    }
+    double scale = 0.;
+    for (int k = 0; k < count; k++) {
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            scale = fmax(scale, fabs(gains[k].*FIELDS[f]));
+        }
+    }
+    double tolerance = TOLERANCE * (1. + scale);
+    ScheduleErrors errors = { 0., 0., 0., true };
+
+    for (int k = 0; k < count; k++) {
+        compare(schedule, throttle, gains, count, throttle[k], true, tolerance, errors);
+    }
+    float first = throttle[0];
+    float span = throttle[count - 1] - first;
+    for (int i = 0; i < GainSchedule::SIZE; i++) {
+        compare(schedule, throttle, gains, count, first + i * span / (GainSchedule::SIZE - 1), false, tolerance, errors);
+    }
+    // Beyond both ends too, where the gains are constant
+    float margin = count > 1 ? .1f * span : .1f;
+    for (int i = 0; i < samples; i++) {
+        float x = first - margin + (span + 2.f * margin) * i / (samples - 1);
+        compare(schedule, throttle, gains, count, x, false, tolerance, errors);
+    }
+
+    // No throttle yet, the gains of the first point
+    PIDGains looked_up;
+    schedule.lookup(NAN, looked_up);
+    for (int f = 0; f < FIELD_COUNT; f++) {
+        if (looked_up.*FIELDS[f] != gains[0].*FIELDS[f]) {
+            fprintf(stderr, "GainScheduleTest: %s, wrong gains for a NaN throttle\n", name);
+            errors.passed = false;
+            break;
+        }
+    }
+
+    fprintf(stderr, "GainScheduleTest: %s, largest error %.2e, %.2e at the points, largest bound %.2e\n",
+            name, errors.largest, errors.points, errors.bound);
+    return errors.passed;
+}
+
+// A schedule which must be rejected
+static bool testInvalid(const char *name, const float throttle[], int count)
+{
+    PIDGains gains[GainSchedule::MAX_POINTS + 1] = {};
+    GainSchedule schedule;
+    schedule.set(ON_GRID_THROTTLES, ON_GRID_GAINS, ON_GRID_POINTS);
+    if (schedule.set(throttle, gains, count) || schedule.isEnabled()) {
+        fprintf(stderr, "GainScheduleTest: %s accepted\n", name);
+        return false;
+    }
+    return true;
+}
+
+bool GainScheduleTest::run(int samples)
+{
+    bool passed = testSchedule("points on the grid", ON_GRID_THROTTLES, ON_GRID_GAINS, ON_GRID_POINTS, samples);
+    passed = testSchedule("points between the grid", BETWEEN_GRID_THROTTLES, BETWEEN_GRID_GAINS, BETWEEN_GRID_POINTS, samples) && passed;
+    passed = testSchedule("single point", BETWEEN_GRID_THROTTLES + 2, BETWEEN_GRID_GAINS + 2, 1, samples) && passed;
+
+    float increasing[GainSchedule::MAX_POINTS + 1];
+    for (int i = 0; i <= GainSchedule::MAX_POINTS; i++) {
+        increasing[i] = .05f * i;
+    }
+    const float repeated[] = { .2f, .4f, .4f };
+    const float decreasing[] = { .4f, .2f };
+    const float undefined[] = { .2f, NAN };
+    passed = testInvalid("No point", increasing, 0) && passed;
+    passed = testInvalid("Too many points", increasing, GainSchedule::MAX_POINTS + 1) && passed;
+    passed = testInvalid("Repeated point", repeated, 3) && passed;
+    passed = testInvalid("Decreasing throttle", decreasing, 2) && passed;
+    passed = testInvalid("NaN throttle", undefined, 2) && passed;
+    return passed;
+}
+
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GAINSCHEDULETEST_H_
+#define _GAINSCHEDULETEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the interpolation of GainSchedule.
+ *
+ * <p>
+ * Schedules with their points on the grid entries, between them, and with a
+ * single point, are compared with the piecewise linear gains at each point,
+ * at each grid entry and on a dense sweep of the throttle beyond both ends.
+ * The invalid point lists must be rejected.
+ * </p>
+ */
+class GainScheduleTest {
+public:
+    /**
+     * Runs the comparisons and prints the largest errors.
+     *
+     * @return false if a gain differs from the piecewise linear one by more
+     *         than the resampling bound of GainSchedule, or if an invalid
+     *         schedule is accepted.
+     */
+    static bool run(int samples);
+};
+
+}
+}
+}
+
+#endif
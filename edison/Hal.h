@@ -0,0 +1,117 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _HAL_H_
+#define _HAL_H_
+
+#include "Timestamp.h"
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Raw LSM9DS0 sample, at the full scales of 245dps, 2g and 2Gs.
+ */
+struct RawSample {
+    static constexpr float GYRO_RESOLUTION = 245.f / 32768.f; // Degrees per second
+    static constexpr float ACCEL_RESOLUTION = 2.f / 32768.f; // g
+    static constexpr float MAG_RESOLUTION = 2.f / 32768.f; // Gauss
+    static constexpr float TEMPERATURE_RESOLUTION = 1.f / 8.f; // Degrees Celsius
+    static constexpr float TEMPERATURE_OFFSET = 25.f; // Degrees Celsius at zero
+
+    // Value of temp when the temperature was not read
+    static const int16_t NO_TEMPERATURE = INT16_MIN;
+
+    int16_t ax, ay, az;
+    int16_t gx, gy, gz;
+    int16_t mx, my, mz;
+    int16_t temp;
+    Timestamp accel_timestamp;
+    Timestamp gyro_timestamp;
+};
+
+/**
+ * Hardware abstraction layer, given to the FlightService.
+ *
+ * <p>
+ * The clock, the inertial sensor and the motors are provided together, so
+ * that a simulated vehicle can generate samples consistent with its own time
+ * and with the duty cycles it receives. The hardware is only accessed by the
+ * begin methods and after them, never by the constructors of the flight
+ * software, so that several FlightService instances can coexist in one
+ * process.
+ * </p>
+ */
+class Hal {
+public:
+    virtual ~Hal() {}
+
+    /**
+     * Monotonic time.
+     */
+    virtual Timestamp now() = 0;
+
+    /**
+     * Initializes the inertial sensor.
+     */
+    virtual void beginImu() = 0;
+
+    /**
+     * Reads the accelerometer in ax, ay, az and accel_timestamp.
+     */
+    virtual void readAccel(RawSample & sample) = 0;
+
+    /**
+     * Reads the gyroscope in gx, gy, gz and gyro_timestamp.
+     */
+    virtual void readGyro(RawSample & sample) = 0;
+
+    /**
+     * Reads the magnetometer in mx, my and mz.
+     */
+    virtual void readMag(RawSample & sample) = 0;
+
+    /**
+     * Reads the temperature in temp.
+     */
+    virtual void readTemperature(RawSample & sample) = 0;
+
+    /**
+     * Initializes and starts the 4 motor outputs.
+     */
+    virtual void beginMotors(int period_ns) = 0;
+
+    /**
+     * Changes the period of the motor outputs.
+     */
+    virtual void setMotorsPeriod(int period_ns) = 0;
+
+    /**
+     * Writes the duty cycles, in the front-left, front-right, back-right and
+     * back-left order.
+     */
+    virtual void writeMotors(const float duty[4]) = 0;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LatencyHistogram.h"
+#include <math.h>
+#include <string.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float LatencyHistogram::BIN_WIDTH;
+
+LatencyHistogram::LatencyHistogram()
+{
+    clear();
+}
+
+void LatencyHistogram::clear()
+{
+    memset(bins, 0, sizeof(bins));
+    count = 0;
+    max = 0.;
+}
+
+void LatencyHistogram::add(float latency)
+{
+    if (!isfinite(latency)) {
+        return;
+    }
+    // Clamped before the conversion, which is undefined out of the int range
+    float position = fminf(fmaxf(latency / BIN_WIDTH, 0.f), BINS - 1);
+    bins[(int)position]++;
+    if (count == 0 || latency > max) {
+        max = latency;
+    }
+    count++;
+}
+
+float LatencyHistogram::getPercentile(float fraction) const
+{
+    int rank = (int)(fraction * count + .5f);
+    int sum = 0;
+    for (int i = 0; i < BINS; i++) {
+        sum += bins[i];
+        if (sum >= rank && sum > 0) {
+            return (i + 1) * BIN_WIDTH;
+        }
+    }
+    return 0.;
+}
+
+}
+}
+}
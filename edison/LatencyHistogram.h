@@ -0,0 +1,75 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LATENCYHISTOGRAM_H_
+#define _LATENCYHISTOGRAM_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Distribution of latencies, with bins of BIN_WIDTH seconds.
+ *
+ * <p>
+ * Adding a latency is a constant number of operations, and the percentiles
+ * are computed from the bins, with their resolution. The latencies above the
+ * last bin are counted in it, the negative ones in the first bin. The
+ * non-finite ones, from a bogus ground timestamp, are ignored.
+ * </p>
+ */
+class LatencyHistogram {
+
+public:
+    static const int BINS = 250;
+    static constexpr float BIN_WIDTH = .001f;
+
+    LatencyHistogram();
+
+    void clear();
+
+    void add(float latency);
+
+    int getCount() const {
+        return count;
+    }
+
+    /**
+     * Upper bound of the bin which contains the given fraction of the
+     * latencies, 0 if there are none.
+     */
+    float getPercentile(float fraction) const;
+
+    /**
+     * Largest latency, exact.
+     */
+    float getMax() const {
+        return max;
+    }
+
+private:
+    int bins[BINS];
+    int count;
+    float max;
+};
+
+}
+}
+}
+
+#endif
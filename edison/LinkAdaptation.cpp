@@ -0,0 +1,130 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkAdaptation.h"
+#include <errno.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float LinkAdaptation::MAX_LOSS;
+
+LinkAdaptation::LinkAdaptation() :
+    errors(0)
+{
+    reset();
+}
+
+void LinkAdaptation::reset()
+{
+    level = 0;
+    congestion_ticks = 0;
+    level_ticks = HOLD_TICKS;
+    ack_ticks = 0;
+    acknowledging = false;
+    ack_sequence = 0;
+    window_sequence = 0;
+    window_count = 0;
+    loss = 0.;
+    queued = 0;
+    unreachable = false;
+    successes = 0;
+}
+
+void LinkAdaptation::tick()
+{
+    congestion_ticks++;
+    level_ticks++;
+    if (acknowledging && ++ack_ticks >= ACK_TIMEOUT_TICKS) {
+        ack_ticks = 0;
+        loss = 1.;
+        congestion();
+    }
+    if (level > 0 && congestion_ticks >= RECOVERY_TICKS) {
+        level--;
+        congestion_ticks = 0;
+    }
+}
+
+void LinkAdaptation::sent(int error, int queued)
+{
+    this->queued = queued;
+    if (error) {
+        successes = 0;
+        errors++;
+        if (error == ECONNREFUSED) {
+            unreachable = true;
+            // Nobody listens, probe at the lowest rate
+            level = LEVELS - 1;
+            congestion_ticks = 0;
+        } else {
+            congestion();
+        }
+    } else {
+        if (successes < REACHABLE_SENDS) {
+            successes++;
+        }
+        if (successes == REACHABLE_SENDS) {
+            unreachable = false;
+        }
+        if (queued > MAX_QUEUED) {
+            congestion();
+        }
+    }
+}
+
+void LinkAdaptation::acknowledged(unsigned int sequence, unsigned int count)
+{
+    if (!acknowledging) {
+        window_sequence = sequence;
+        window_count = count;
+    } else if (sequence == ack_sequence) {
+        // Nothing new received, the timeout will tell
+        return;
+    }
+    acknowledging = true;
+    unreachable = false;
+    ack_ticks = 0;
+    ack_sequence = sequence;
+
+    // Unsigned differences, the counters may wrap
+    unsigned int sent = sequence - window_sequence;
+    if (sent >= (unsigned int)LOSS_WINDOW) {
+        unsigned int received = count - window_count;
+        loss = received < sent ? 1.f - (float)received / sent : 0.f;
+        window_sequence = sequence;
+        window_count = count;
+        if (loss > MAX_LOSS) {
+            congestion();
+        }
+    }
+}
+
+void LinkAdaptation::congestion()
+{
+    congestion_ticks = 0;
+    if (level < LEVELS - 1 && level_ticks >= HOLD_TICKS) {
+        level++;
+        level_ticks = 0;
+    }
+}
+
+}
+}
+}
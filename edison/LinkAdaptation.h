@@ -0,0 +1,155 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINKADAPTATION_H_
+#define _LINKADAPTATION_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Telemetry rate adaptation to the quality of the link.
+ *
+ * <p>
+ * At level 0 the telemetry sends its fields with the full encoding at their
+ * configured rates, at level 1 with the compact encoding, then the compact
+ * fields at a half, a quarter and an eighth of their rates: the periods of
+ * the fields are multiplied by getDivisor().
+ * </p>
+ *
+ * <p>
+ * The level goes up, at most once every HOLD_TICKS telemetry ticks, when the
+ * link shows congestion: a send error, more than MAX_QUEUED bytes waiting in
+ * the socket send buffer, more than MAX_LOSS of the last LOSS_WINDOW packets
+ * or more lost according to the ground acknowledgements, or no
+ * acknowledgement for ACK_TIMEOUT_TICKS from a ground station which
+ * acknowledges. When the ground station is unreachable, the telemetry keeps
+ * probing at the lowest rate. The level goes down by one after RECOVERY_TICKS
+ * without congestion.
+ * </p>
+ *
+ * <p>
+ * A send refused after an ICMP port unreachable marks the ground station
+ * unreachable. As the following send succeeds until the next ICMP, the mark
+ * is only cleared by an acknowledgement or by REACHABLE_SENDS successful sends
+ * in a row.
+ * </p>
+ */
+class LinkAdaptation {
+
+public:
+    static const int LEVELS = 5;
+    static const int HOLD_TICKS = 50;
+    static const int RECOVERY_TICKS = 200;
+    static const int ACK_TIMEOUT_TICKS = 200;
+    static const int MAX_QUEUED = 2048;
+    static const int LOSS_WINDOW = 10;
+    static const int REACHABLE_SENDS = 10;
+    static constexpr float MAX_LOSS = .1f;
+
+    LinkAdaptation();
+
+    /**
+     * Returns to the full rate, for a new ground station.
+     */
+    void reset();
+
+    /**
+     * Advances by one telemetry tick.
+     */
+    void tick();
+
+    /**
+     * Reports the result of a send.
+     *
+     * @param error
+     *            0 if the packet was sent, the errno value otherwise.
+     * @param queued
+     *            Bytes in the socket send buffer after the send, -1 if
+     *            unknown.
+     */
+    void sent(int error, int queued);
+
+    /**
+     * Reports an acknowledgement of the ground station.
+     *
+     * @param sequence
+     *            Last packet sequence received by the ground station.
+     * @param count
+     *            Number of packets received by the ground station so far.
+     */
+    void acknowledged(unsigned int sequence, unsigned int count);
+
+    int getLevel() const {
+        return level;
+    }
+
+    bool isCompact() const {
+        return level > 0;
+    }
+
+    /**
+     * Multiplier of the field periods at the current level.
+     */
+    int getDivisor() const {
+        return level > 1 ? 1 << (level - 1) : 1;
+    }
+
+    /**
+     * Loss measured over the last window.
+     */
+    float getLoss() const {
+        return loss;
+    }
+
+    int getQueued() const {
+        return queued;
+    }
+
+    unsigned int getErrors() const {
+        return errors;
+    }
+
+    bool isUnreachable() const {
+        return unreachable;
+    }
+
+private:
+    int level;
+    int congestion_ticks; // Since the last congestion
+    int level_ticks; // Since the last level increase
+    int ack_ticks; // Since the last acknowledgement
+    bool acknowledging; // The ground station has acknowledged a packet
+    unsigned int ack_sequence; // Of the last acknowledgement
+    unsigned int window_sequence; // At the start of the loss window
+    unsigned int window_count;
+    float loss;
+    int queued;
+    unsigned int errors;
+    bool unreachable;
+    int successes; // Sends without error in a row
+
+    void congestion();
+};
+
+}
+}
+}
+
+#endif
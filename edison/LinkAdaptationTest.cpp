@@ -0,0 +1,117 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkAdaptationTest.h"
+#include "LinkAdaptation.h"
+#include <errno.h>
+#include <stdio.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Checks the state after a step
+static bool expect(const char *step, const LinkAdaptation & link, int level, bool unreachable)
+{
+    if (link.getLevel() != level || link.isUnreachable() != unreachable) {
+        fprintf(stderr, "LinkAdaptationTest: %s, level %d%s instead of %d%s\n", step,
+                link.getLevel(), link.isUnreachable() ? " unreachable" : "",
+                level, unreachable ? " unreachable" : "");
+        return false;
+    }
+    return true;
+}
+
+static void ticks(LinkAdaptation & link, int count)
+{
+    for (int i = 0; i < count; i++) {
+        link.tick();
+    }
+}
+
+bool LinkAdaptationTest::run()
+{
+    LinkAdaptation link;
+    bool passed = expect("Start", link, 0, false);
+
+    // Congestion, at most one level up per HOLD_TICKS
+    link.sent(ENOBUFS, 0);
+    passed &= expect("Send error", link, 1, false);
+    link.sent(0, LinkAdaptation::MAX_QUEUED + 1);
+    passed &= expect("Queue within the hold time", link, 1, false);
+    ticks(link, LinkAdaptation::HOLD_TICKS);
+    link.sent(0, LinkAdaptation::MAX_QUEUED + 1);
+    passed &= expect("Queue after the hold time", link, 2, false);
+
+    // Recovery, one level down per RECOVERY_TICKS without congestion
+    ticks(link, LinkAdaptation::RECOVERY_TICKS - 1);
+    passed &= expect("Before the recovery", link, 2, false);
+    ticks(link, 1);
+    passed &= expect("Recovery", link, 1, false);
+    ticks(link, LinkAdaptation::RECOVERY_TICKS);
+    passed &= expect("Full recovery", link, 0, false);
+
+    // Losses, measured over LOSS_WINDOW packets by the acknowledgements
+    unsigned int sequence = 100;
+    unsigned int count = 50;
+    link.acknowledged(sequence, count);
+    sequence += LinkAdaptation::LOSS_WINDOW;
+    count += LinkAdaptation::LOSS_WINDOW;
+    link.acknowledged(sequence, count);
+    passed &= expect("No loss", link, 0, false);
+    sequence += LinkAdaptation::LOSS_WINDOW;
+    count += LinkAdaptation::LOSS_WINDOW / 2;
+    link.acknowledged(sequence, count);
+    passed &= expect("Losses", link, 1, false);
+
+    // Acknowledgements lost
+    ticks(link, LinkAdaptation::ACK_TIMEOUT_TICKS - 1);
+    passed &= expect("Before the acknowledgement timeout", link, 1, false);
+    ticks(link, 1);
+    passed &= expect("Acknowledgement timeout", link, 2, false);
+
+    // Unreachable, every other send is refused after the ICMP of the
+    // previous one
+    link.reset();
+    link.sent(ECONNREFUSED, 0);
+    passed &= expect("Refused", link, LinkAdaptation::LEVELS - 1, true);
+    for (int i = 0; i < 2 * LinkAdaptation::REACHABLE_SENDS; i++) {
+        link.sent(i % 2 ? ECONNREFUSED : 0, 0);
+        link.tick();
+    }
+    passed &= expect("Refused every other send", link, LinkAdaptation::LEVELS - 1, true);
+    for (int i = 0; i < LinkAdaptation::REACHABLE_SENDS - 1; i++) {
+        link.sent(0, 0);
+    }
+    passed &= expect("Before the reachable sends", link, LinkAdaptation::LEVELS - 1, true);
+    link.sent(0, 0);
+    passed &= expect("Reachable sends", link, LinkAdaptation::LEVELS - 1, false);
+    ticks(link, LinkAdaptation::RECOVERY_TICKS);
+    passed &= expect("Recovery from unreachable", link, LinkAdaptation::LEVELS - 2, false);
+    link.sent(ECONNREFUSED, 0);
+    passed &= expect("Refused again", link, LinkAdaptation::LEVELS - 1, true);
+    link.acknowledged(1, 1);
+    passed &= expect("Acknowledged", link, LinkAdaptation::LEVELS - 1, false);
+
+    fprintf(stderr, "LinkAdaptationTest: %u send errors, level %d\n", link.getErrors(), link.getLevel());
+    return passed;
+}
+
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINKADAPTATIONTEST_H_
+#define _LINKADAPTATIONTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the level transitions of LinkAdaptation.
+ *
+ * <p>
+ * The send results, acknowledgements and ticks of each kind of congestion
+ * are given to a LinkAdaptation, and the level is checked after each step:
+ * the increases and their hold time, the recovery, the losses and the
+ * timeout of the acknowledgements, and the unreachable ground station, which
+ * must stay unreachable while its refused sends alternate with successful
+ * ones.
+ * </p>
+ */
+class LinkAdaptationTest {
+public:
+    /**
+     * Runs the steps, and prints the first one which fails.
+     *
+     * @return false if a level or the unreachable state is wrong.
+     */
+    static bool run();
+};
+
+}
+}
+}
+
+#endif
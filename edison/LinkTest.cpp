@@ -0,0 +1,213 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LinkTest.h"
+#include "LatencyHistogram.h"
+#include "DatagramSocket.h"
+#include "FlightService.h"
+#include "SimulatedVehicle.h"
+#include "Thread.h"
+#include "Timestamp.h"
+#include "Communication.pb.h"
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Ports of the two sides on localhost
+#define AIR_PORT 49160
+#define GROUND_PORT 49161
+
+// One-way delay, in seconds, and mean of the exponential jitter added to it
+#define DELAY .005
+#define JITTER .003
+
+// Ground clock, as a wall clock with a drift of 100 ppm
+#define CLOCK_OFFSET 1.5e9
+#define CLOCK_SKEW 100.e-6
+
+// Largest packet of the test
+#define PACKET_SIZE 256
+
+// Longest wait for a telemetry packet before sending the next command, in
+// microseconds
+#define COMMAND_PERIOD_US 10000
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr double LinkTest::OFFSET_TOLERANCE;
+constexpr double LinkTest::SKEW_TOLERANCE;
+
+static double airNow()
+{
+    return Timestamp::now();
+}
+
+static double groundNow()
+{
+    return CLOCK_OFFSET + airNow() * (1. + CLOCK_SKEW);
+}
+
+// Waits for the delay of one packet, and returns it
+static double delay(Random & random)
+{
+    double d = DELAY - JITTER * log(random.uniform(1.e-6f, 1.f));
+    usleep((useconds_t)(d * 1.e6));
+    return d;
+}
+
+/**
+ * Vehicle whose HAL clock is the wall clock, as the receiver and the
+ * telemetry stamp the packets with it.
+ */
+class WallClockVehicle : public SimulatedVehicle {
+public:
+    WallClockVehicle(const VehicleParameters & parameters) : SimulatedVehicle(parameters, 1) {}
+
+    Timestamp now() {
+        return Timestamp::now();
+    }
+};
+
+/**
+ * Ground station: answers each ping of the telemetry with a pong, and sends
+ * a command stamped on its clock at least every COMMAND_PERIOD_US.
+ */
+class GroundStation : public Thread {
+public:
+    // The telemetry comes from another port than the one of the receiver
+    DatagramSocket listener;
+    DatagramSocket sender;
+    int exchanges;
+    std::atomic<bool> done;
+    LatencyHistogram injected;
+    // Last latency report of the telemetry, and the air time it was received
+    Latency reported;
+    double reported_time;
+    int pongs;
+
+    GroundStation(int exchanges) : exchanges(exchanges), done(false), reported_time(0.), pongs(0) {}
+
+    void run() {
+        Random random(1);
+        TelemetryPacket telemetry;
+        CommandPacket command;
+        char data[PACKET_SIZE];
+        struct timeval timeout = { 0, COMMAND_PERIOD_US };
+        setsockopt(listener.udp_socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        // Telemetry of the clock pings and of the latency reports only
+        CommandPacket::TelemetryConfig *config = command.mutable_telemetry_config();
+        config->set_host("127.0.0.1");
+        config->set_port(GROUND_PORT);
+        config->set_commandenabled(false);
+        config->set_attitudeenabled(false);
+        config->set_controlenabled(false);
+        config->set_switchesenabled(false);
+        config->set_latencyenabled(true);
+
+        while (pongs < exchanges) {
+            // Ping, delayed on its way to the ground
+            int size = read(listener.udp_socket, data, sizeof(data));
+            if (size > 0 && telemetry.ParseFromArray(data, size)) {
+                if (telemetry.has_ping()) {
+                    delay(random);
+                    ClockPong *pong = command.mutable_pong();
+                    pong->set_sequence(telemetry.ping().sequence());
+                    pong->set_air_time(telemetry.ping().air_time());
+                    pong->set_ground_receive_time(groundNow());
+                    pongs++;
+                }
+                if (telemetry.has_latency()) {
+                    reported = telemetry.latency();
+                    reported_time = airNow();
+                }
+            }
+
+            // Command, stamped when the stick moves, with the pending pong
+            double stick = airNow();
+            command.mutable_command()->set_timestamp(CLOCK_OFFSET + stick * (1. + CLOCK_SKEW));
+            if (command.has_pong()) {
+                command.mutable_pong()->set_ground_send_time(groundNow());
+            }
+            command.SerializeToArray(data, sizeof(data));
+            injected.add(delay(random));
+            sender.send(data, command.GetCachedSize());
+            command.clear_pong();
+            command.clear_telemetry_config();
+        }
+        done = true;
+    }
+};
+
+bool LinkTest::run(int exchanges)
+{
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    WallClockVehicle vehicle(parameters);
+    FlightService service(&vehicle, AIR_PORT, GROUND_PORT);
+
+    // The receiver binds the air port itself, and exits if it cannot
+    {
+        DatagramSocket probe;
+        if (!probe.bind(AIR_PORT)) {
+            fprintf(stderr, "LinkTest: Air port %d is not available\n", AIR_PORT);
+            return false;
+        }
+    }
+    GroundStation ground(exchanges);
+    if (!ground.listener.bind(GROUND_PORT)) {
+        fprintf(stderr, "LinkTest: Ground port %d is not available\n", GROUND_PORT);
+        return false;
+    }
+    ground.sender.connect("127.0.0.1", AIR_PORT);
+    service.receiver.start();
+    service.telemetry.start();
+    ground.start();
+
+    // Control thread, which applies the received commands
+    while (!ground.done) {
+        service.receiver.dispatchPending();
+        usleep(1000);
+    }
+    ground.join();
+
+    if (ground.reported_time == 0.) {
+        fprintf(stderr, "LinkTest: No latency reported by the telemetry\n");
+        return false;
+    }
+    const Latency & reported = ground.reported;
+    double error = reported.clock_offset() - (CLOCK_OFFSET + ground.reported_time * CLOCK_SKEW);
+    float p50 = ground.injected.getPercentile(.5f);
+    fprintf(stderr, "LinkTest: %d exchanges, best round trip %.2fms, offset error %.3fms, skew %.1fppm (true %.1fppm)\n",
+            exchanges, reported.round_trip() * 1.e3, error * 1.e3, reported.clock_skew() * 1.e6, CLOCK_SKEW * 1.e6);
+    fprintf(stderr, "LinkTest: Latency of %u commands p50 %.0fms p90 %.0fms p99 %.0fms max %.1fms, true p50 %.0fms p90 %.0fms p99 %.0fms max %.1fms\n",
+            reported.count(), reported.p50() * 1.e3, reported.p90() * 1.e3, reported.p99() * 1.e3, reported.max() * 1.e3,
+            p50 * 1.e3, ground.injected.getPercentile(.9f) * 1.e3,
+            ground.injected.getPercentile(.99f) * 1.e3, ground.injected.getMax() * 1.e3);
+    return fabs(error) <= OFFSET_TOLERANCE &&
+            fabs(reported.clock_skew() - CLOCK_SKEW) <= SKEW_TOLERANCE &&
+            fabsf(reported.p50() - p50) <= 2 * LatencyHistogram::BIN_WIDTH * 1.001f;
+}
+
+}
+}
+}
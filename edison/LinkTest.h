@@ -0,0 +1,69 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _LINKTEST_H_
+#define _LINKTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the clock synchronization and of the latency measurement on
+ * localhost.
+ *
+ * <p>
+ * The receiver and telemetry threads of a flight service run on the wall
+ * clock, with the caller as the control thread. A simulated ground station
+ * answers the clock pings of the telemetry with pongs, and sends commands
+ * stamped on its own clock, offset and drifting from the air clock. Each
+ * packet is delayed by a base delay plus an exponential jitter. The offset,
+ * the skew and the command latencies reported by the telemetry are compared
+ * with the injected ones. The threads are not stopped, the test is run alone
+ * by --test-link.
+ * </p>
+ *
+ * <p>
+ * The skew is fitted on the last ClockSync::SEGMENTS groups of exchanges,
+ * about 25 seconds: with the injected jitter, its error stays below 40 ppm
+ * in 999 of 1000 simulated runs of the exchanges. The test needs
+ * enough exchanges to fill these groups.
+ * </p>
+ */
+class LinkTest {
+public:
+    static constexpr double OFFSET_TOLERANCE = .001; // Seconds
+    static constexpr double SKEW_TOLERANCE = 45.e-6; // Seconds per second
+
+    /**
+     * Runs the given number of clock exchanges, one per ping of the
+     * telemetry, and prints the results.
+     *
+     * @return false if a port cannot be bound, if no latency is reported, or
+     *         if the reported offset is not within OFFSET_TOLERANCE, the skew
+     *         within SKEW_TOLERANCE, or the median latency within two
+     *         histogram bins, of the true ones.
+     */
+    static bool run(int exchanges);
+};
+
+}
+}
+}
+
+#endif
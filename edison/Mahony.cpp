@@ -0,0 +1,153 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Mahony.h"
+#include "FastMath.h"
+#include <math.h>
+
+// Added to the squared norms, so that a null vector is normalized to a null
+// vector instead of a division by zero
+#define NORM_EPSILON 1e-12f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+static inline float invNorm(float x, float y, float z)
+{
+    return fastInvSqrtf(x * x + y * y + z * z + NORM_EPSILON);
+}
+
+Mahony::Mahony() :
+    kp(0.5f),
+    ki(0.f)
+{
+    reset();
+}
+
+void Mahony::setGains(float kp, float ki)
+{
+    this->kp = kp;
+    this->ki = ki;
+}
+
+void Mahony::reset()
+{
+    q0 = 1.f;
+    q1 = q2 = q3 = 0.f;
+    ix = iy = iz = 0.f;
+    initialized = false;
+}
+
+void Mahony::initialize(float ax, float ay, float az)
+{
+    // Roll and pitch from the gravity, yaw is 0
+    float roll = atan2f(ay, az);
+    float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(roll * .5f), sr = sinf(roll * .5f);
+    float cp = cosf(pitch * .5f), sp = sinf(pitch * .5f);
+    q0 = cr * cp;
+    q1 = sr * cp;
+    q2 = cr * sp;
+    q3 = -sr * sp;
+    ix = iy = iz = 0.f;
+    initialized = true;
+}
+
+void Mahony::update(float gx, float gy, float gz,
+                    float ax, float ay, float az,
+                    float mx, float my, float mz,
+                    float mag_weight, float dt)
+{
+    if (!initialized || isnan(dt)) {
+        initialize(ax, ay, az);
+        return;
+    }
+
+    // Normalize the measurements
+    float n = invNorm(ax, ay, az);
+    ax *= n;
+    ay *= n;
+    az *= n;
+    n = invNorm(mx, my, mz);
+    mx *= n;
+    my *= n;
+    mz *= n;
+
+    float q0q0 = q0 * q0, q0q1 = q0 * q1, q0q2 = q0 * q2, q0q3 = q0 * q3;
+    float q1q1 = q1 * q1, q1q2 = q1 * q2, q1q3 = q1 * q3;
+    float q2q2 = q2 * q2, q2q3 = q2 * q3;
+    float q3q3 = q3 * q3;
+
+    // Earth magnetic field, rotated in the earth frame and projected on the
+    // north and down axes
+    float hx = 2.f * (mx * (.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+    float hy = 2.f * (mx * (q1q2 + q0q3) + my * (.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+    float bx = sqrtf(hx * hx + hy * hy);
+    float bz = 2.f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (.5f - q1q1 - q2q2));
+
+    // Estimated directions of the gravity and of the magnetic field
+    float vx = 2.f * (q1q3 - q0q2);
+    float vy = 2.f * (q0q1 + q2q3);
+    float vz = q0q0 - q1q1 - q2q2 + q3q3;
+    float wx = 2.f * (bx * (.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2));
+    float wy = 2.f * (bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3));
+    float wz = 2.f * (bx * (q0q2 + q1q3) + bz * (.5f - q1q1 - q2q2));
+
+    // Error between the estimated and the measured directions
+    float ex = (ay * vz - az * vy) + mag_weight * (my * wz - mz * wy);
+    float ey = (az * vx - ax * vz) + mag_weight * (mz * wx - mx * wz);
+    float ez = (ax * vy - ay * vx) + mag_weight * (mx * wy - my * wx);
+
+    // Integral feedback
+    ix += ki * ex * dt;
+    iy += ki * ey * dt;
+    iz += ki * ez * dt;
+
+    // Proportional feedback
+    gx += kp * ex + ix;
+    gy += kp * ey + iy;
+    gz += kp * ez + iz;
+
+    // Integrate the rate of change of the quaternion
+    gx *= .5f * dt;
+    gy *= .5f * dt;
+    gz *= .5f * dt;
+    float a = q0, b = q1, c = q2;
+    q0 += -b * gx - c * gy - q3 * gz;
+    q1 += a * gx + c * gz - q3 * gy;
+    q2 += a * gy - b * gz + q3 * gx;
+    q3 += a * gz + b * gy - c * gx;
+
+    n = fastInvSqrtf(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+    q0 *= n;
+    q1 *= n;
+    q2 *= n;
+    q3 *= n;
+}
+
+void Mahony::getEuler(float &roll, float &pitch, float &yaw) const
+{
+    roll = fastAtan2f(2.f * (q0 * q1 + q2 * q3), 1.f - 2.f * (q1 * q1 + q2 * q2));
+    pitch = fastAsinf(2.f * (q0 * q2 - q1 * q3));
+    yaw = fastAtan2f(2.f * (q0 * q3 + q1 * q2), 1.f - 2.f * (q2 * q2 + q3 * q3));
+}
+
+}
+}
+}
@@ -0,0 +1,102 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MAHONY_H_
+#define _MAHONY_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Mahony quaternion attitude estimator.
+ *
+ * <p>
+ * This class fuses the gyroscope, the accelerometer and optionally the
+ * magnetometer into an attitude quaternion, using the nonlinear complementary
+ * filter of R. Mahony et al. All vectors are expressed in the vehicle body
+ * frame: x forward, y right, z down. The accelerometer vector is the direction
+ * of the gravity (pointing down), the magnitude of the accelerometer and
+ * magnetometer vectors does not matter.
+ * </p>
+ *
+ * <p>
+ * The update does not allocate memory and has no data dependent branch: the
+ * magnetometer correction is weighted instead of being switched on or off,
+ * and the normalizations never divide by zero.
+ * </p>
+ */
+class Mahony {
+
+public:
+    Mahony();
+
+    /**
+     * Sets the proportional and integral gains of the gyroscope correction.
+     */
+    void setGains(float kp, float ki);
+
+    /**
+     * Restarts the estimation, the next update initializes the attitude from
+     * the accelerometer.
+     */
+    void reset();
+
+    /**
+     * Updates the attitude.
+     *
+     * @param gx, gy, gz
+     *            Angular rates in radians/second.
+     * @param ax, ay, az
+     *            Gravity direction.
+     * @param mx, my, mz
+     *            Magnetic field.
+     * @param mag_weight
+     *            Weight of the magnetometer correction, 0 to ignore the
+     *            magnetometer.
+     * @param dt
+     *            Time since the previous update in seconds.
+     */
+    void update(float gx, float gy, float gz,
+                float ax, float ay, float az,
+                float mx, float my, float mz,
+                float mag_weight, float dt);
+
+    /**
+     * Returns the attitude as Euler angles (Z-Y-X convention) in radians.
+     */
+    void getEuler(float & roll, float & pitch, float & yaw) const;
+
+private:
+    // Attitude quaternion, body to earth
+    float q0, q1, q2, q3;
+
+    // Integral of the error
+    float ix, iy, iz;
+
+    float kp, ki;
+    bool initialized;
+
+    void initialize(float ax, float ay, float az);
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,307 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MathTest.h"
+#include "FastMath.h"
+#include "Timestamp.h"
+#include "WorkStealingRunner.h"
+#include <math.h>
+#include <stdio.h>
+
+// Inputs given at once to the batch variants
+#define BATCH 256
+
+// Bit patterns checked by each task of the exhaustive sweeps
+#define CHUNK_BITS 20
+
+// First and last bit patterns of the positive normal floats
+#define FIRST_NORMAL 0x00800000u
+#define LAST_NORMAL 0x7f7fffffu
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Float from its bit pattern
+static inline float fromBits(uint32_t bits)
+{
+    float x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static inline uint32_t toBits(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits;
+}
+
+// Difference of two angles, modulo 2 pi
+static inline double angleError(float angle, double reference)
+{
+    double e = fabs(angle - reference);
+    return e > M_PI ? fabs(e - 2. * M_PI) : e;
+}
+
+static double testAtan2(int samples)
+{
+    static const float RADII[] = { 1.e-3f, 1.f, 1.e3f };
+    float y[BATCH], x[BATCH], batch[BATCH];
+    double error = angleError(fastAtan2f(0.f, 0.f), 0.);
+    for (int i = 0; i < samples; i += BATCH) {
+        int n = samples - i < BATCH ? samples - i : BATCH;
+        for (int j = 0; j < n; j++) {
+            double t = -M_PI + 2. * M_PI * (i + j + .5) / samples;
+            float r = RADII[(i + j) % 3];
+            y[j] = r * sin(t);
+            x[j] = r * cos(t);
+        }
+        fastAtan2f(y, x, batch, n);
+        for (int j = 0; j < n; j++) {
+            double reference = atan2((double)y[j], (double)x[j]);
+            error = fmax(error, angleError(fastAtan2f(y[j], x[j]), reference));
+            error = fmax(error, angleError(batch[j], reference));
+        }
+    }
+    return error;
+}
+
+static double testAsin(int samples)
+{
+    uint32_t one = toBits(1.f);
+    uint32_t stride = one / samples + 1;
+    double error = fabs(fastAsinf(1.f) - M_PI_2);
+    for (uint32_t bits = 0; bits <= one; bits += stride) {
+        float x = fromBits(bits);
+        error = fmax(error, fabs(fastAsinf(x) - asin((double)x)));
+        error = fmax(error, fabs(fastAsinf(-x) - asin((double)-x)));
+    }
+    return error;
+}
+
+static double testInvSqrt(int samples)
+{
+    uint32_t first = toBits(1.f);
+    uint32_t stride = (toBits(4.f) - first) / samples + 1;
+    float x[BATCH], batch[BATCH];
+    double error = 0.;
+    int n = 0;
+    for (uint32_t bits = first; bits < toBits(4.f); bits += stride) {
+        // Same mantissa at exponents from 4^-10 to 4^10
+        x[n++] = ldexpf(fromBits(bits), 2 * ((bits / stride) % 21) - 20);
+        if (n == BATCH || bits + stride >= toBits(4.f)) {
+            fastInvSqrtf(x, batch, n);
+            for (int j = 0; j < n; j++) {
+                double root = sqrt((double)x[j]);
+                error = fmax(error, fabs(fastInvSqrtf(x[j]) * root - 1.));
+                error = fmax(error, fabs(batch[j] * root - 1.));
+            }
+            n = 0;
+        }
+    }
+    return error;
+}
+
+/**
+ * Largest error of a function over the bit patterns of each chunk of a range.
+ */
+class ExhaustiveTask : public WorkStealingRunner::Task {
+public:
+    enum Function {
+        ASIN,
+        INVSQRT
+    };
+
+    ExhaustiveTask(Function function, uint32_t first, uint32_t last) :
+        function(function),
+        first(first),
+        last(last),
+        chunks(((last - first) >> CHUNK_BITS) + 1),
+        errors(new double[chunks])
+    {
+    }
+
+    ~ExhaustiveTask()
+    {
+        delete[] errors;
+    }
+
+    int getChunks() const
+    {
+        return chunks;
+    }
+
+    double getError() const
+    {
+        double error = 0.;
+        for (int i = 0; i < chunks; i++) {
+            error = fmax(error, errors[i]);
+        }
+        return error;
+    }
+
+    void execute(int index)
+    {
+        uint32_t begin = first + ((uint32_t)index << CHUNK_BITS);
+        uint32_t end = index == chunks - 1 ? last : begin + (1u << CHUNK_BITS) - 1;
+        errors[index] = function == ASIN ? asinError(begin, end) : invSqrtError(begin, end);
+    }
+
+private:
+    Function function;
+    uint32_t first;
+    uint32_t last;
+    int chunks;
+    double *errors;
+
+    // The negative inputs share the reference of the positive ones, asin() is odd
+    static double asinError(uint32_t begin, uint32_t end)
+    {
+        double error = 0.;
+        for (uint32_t bits = begin; ; bits++) {
+            float x = fromBits(bits);
+            double reference = asin((double)x);
+            error = fmax(error, fabs(fastAsinf(x) - reference));
+            error = fmax(error, fabs(fastAsinf(-x) + reference));
+            if (bits == end) {
+                return error;
+            }
+        }
+    }
+
+    static double invSqrtError(uint32_t begin, uint32_t end)
+    {
+        float x[BATCH], batch[BATCH];
+        double error = 0.;
+        int n = 0;
+        for (uint32_t bits = begin; ; bits++) {
+            x[n++] = fromBits(bits);
+            if (n == BATCH || bits == end) {
+                fastInvSqrtf(x, batch, n);
+                for (int j = 0; j < n; j++) {
+                    double root = sqrt((double)x[j]);
+                    error = fmax(error, fabs(fastInvSqrtf(x[j]) * root - 1.));
+                    error = fmax(error, fabs(batch[j] * root - 1.));
+                }
+                n = 0;
+            }
+            if (bits == end) {
+                return error;
+            }
+        }
+    }
+};
+
+bool MathTest::run(int samples)
+{
+    double atan2_error = testAtan2(samples);
+    double asin_error = testAsin(samples);
+    double invsqrt_error = testInvSqrt(samples);
+    fprintf(stderr, "MathTest: atan2 %.3e rad (bound %.1e), asin %.3e rad (bound %.1e), invsqrt %.3e relative (bound %.1e)\n",
+            atan2_error, FAST_ATAN2_MAX_ERROR, asin_error, FAST_ASIN_MAX_ERROR,
+            invsqrt_error, FAST_INVSQRT_MAX_RELATIVE_ERROR);
+    return atan2_error <= FAST_ATAN2_MAX_ERROR
+            && asin_error <= FAST_ASIN_MAX_ERROR
+            && invsqrt_error <= FAST_INVSQRT_MAX_RELATIVE_ERROR;
+}
+
+bool MathTest::runExhaustive()
+{
+    WorkStealingRunner runner;
+    Timestamp start = Timestamp::now();
+    ExhaustiveTask asin_task(ExhaustiveTask::ASIN, 0, toBits(1.f));
+    runner.run(asin_task, asin_task.getChunks());
+    ExhaustiveTask invsqrt_task(ExhaustiveTask::INVSQRT, FIRST_NORMAL, LAST_NORMAL);
+    runner.run(invsqrt_task, invsqrt_task.getChunks());
+    double asin_error = asin_task.getError();
+    double invsqrt_error = invsqrt_task.getError();
+    fprintf(stderr, "MathTest: every float, asin %.3e rad (bound %.1e), invsqrt %.3e relative (bound %.1e), in %.1fs\n",
+            asin_error, FAST_ASIN_MAX_ERROR, invsqrt_error, FAST_INVSQRT_MAX_RELATIVE_ERROR,
+            (float)(Timestamp::now() - start));
+    return asin_error <= FAST_ASIN_MAX_ERROR && invsqrt_error <= FAST_INVSQRT_MAX_RELATIVE_ERROR;
+}
+
+void MathTest::benchmark(int samples)
+{
+    // One batch of inputs, evaluated again and again, stays in the cache
+    float y[BATCH], x[BATCH], a[BATCH], r[BATCH], out[BATCH];
+    for (int j = 0; j < BATCH; j++) {
+        double t = -M_PI + 2. * M_PI * (j + .5) / BATCH;
+        y[j] = sin(t);
+        x[j] = cos(t);
+        a[j] = -1.f + 2.f * (j + .5f) / BATCH;
+        r[j] = ldexpf(1.f + (float)j / BATCH, j % 21 - 10);
+    }
+    int rounds = samples / BATCH + 1;
+    float times[8];
+    float sink = 0.f;
+    for (int f = 0; f < 8; f++) {
+        Timestamp start = Timestamp::now();
+        for (int i = 0; i < rounds; i++) {
+            switch (f) {
+            case 0:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = atan2f(y[j], x[j]);
+                }
+                break;
+            case 1:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = fastAtan2f(y[j], x[j]);
+                }
+                break;
+            case 2:
+                fastAtan2f(y, x, out, BATCH);
+                break;
+            case 3:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = asinf(a[j]);
+                }
+                break;
+            case 4:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = fastAsinf(a[j]);
+                }
+                break;
+            case 5:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = 1.f / sqrtf(r[j]);
+                }
+                break;
+            case 6:
+                for (int j = 0; j < BATCH; j++) {
+                    out[j] = fastInvSqrtf(r[j]);
+                }
+                break;
+            default:
+                fastInvSqrtf(r, out, BATCH);
+                break;
+            }
+            sink += out[i % BATCH];
+        }
+        times[f] = (Timestamp::now() - start) / ((float)rounds * BATCH) * 1.e9f;
+    }
+    fprintf(stderr, "MathTest: atan2f %.2fns, fastAtan2f %.2fns, batch %.2fns per input\n", times[0], times[1], times[2]);
+    fprintf(stderr, "MathTest: asinf %.2fns, fastAsinf %.2fns per input\n", times[3], times[4]);
+    fprintf(stderr, "MathTest: 1 / sqrtf %.2fns, fastInvSqrtf %.2fns, batch %.2fns per input%s\n",
+            times[5], times[6], times[7], isfinite(sink) ? "" : " (not finite)");
+}
+
+}
+}
+}
@@ -0,0 +1,71 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATHTEST_H_
+#define _MATHTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the maximum errors documented in FastMath.h.
+ *
+ * <p>
+ * fastAtan2f() is swept around the circle at several radii, fastAsinf() over
+ * evenly spaced float bit patterns of [-1, 1], and fastInvSqrtf() over
+ * [1, 4), which gives the same relative errors as any other power of 4, at
+ * several exponents. The scalar and the batch variants are compared with the
+ * double precision libm.
+ * </p>
+ *
+ * <p>
+ * The exhaustive sweeps evaluate fastAsinf() on every float of [-1, 1] and
+ * fastInvSqrtf() on every positive normal float, on all the CPUs.
+ * </p>
+ */
+class MathTest {
+public:
+    /**
+     * Evaluates each function on the given number of inputs and prints the
+     * largest errors.
+     *
+     * @return false if an error is larger than the documented one.
+     */
+    static bool run(int samples);
+
+    /**
+     * Evaluates fastAsinf() and fastInvSqrtf() on all their inputs and prints
+     * the largest errors. This takes about a minute on one CPU of a host.
+     *
+     * @return false if an error is larger than the documented one.
+     */
+    static bool runExhaustive();
+
+    /**
+     * Prints the time per input of each approximation, scalar and batch, and
+     * of the libm function it replaces.
+     */
+    static void benchmark(int samples);
+};
+
+}
+}
+}
+
+#endif
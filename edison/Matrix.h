@@ -0,0 +1,198 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MATRIX_H_
+#define _MATRIX_H_
+
+#include <math.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Fixed-size float matrix.
+ *
+ * <p>
+ * The dimensions are template parameters, so the storage is a plain array
+ * (no heap), the dimension mismatches are compile errors, and all the loops
+ * have constant bounds that the compiler can unroll.
+ * </p>
+ *
+ * @param R
+ *            Number of rows.
+ * @param C
+ *            Number of columns.
+ */
+template <int R, int C>
+class Matrix {
+
+public:
+    static const int ROWS = R;
+    static const int COLUMNS = C;
+
+    float m[R][C];
+
+    float & operator()(int row, int column) {
+        return m[row][column];
+    }
+
+    float operator()(int row, int column) const {
+        return m[row][column];
+    }
+
+    static Matrix zeros() {
+        Matrix a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < C; j++) {
+                a.m[i][j] = 0.f;
+            }
+        }
+        return a;
+    }
+
+    static Matrix identity() {
+        Matrix a = zeros();
+        for (int i = 0; i < R && i < C; i++) {
+            a.m[i][i] = 1.f;
+        }
+        return a;
+    }
+
+    Matrix<C, R> transpose() const {
+        Matrix<C, R> a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < C; j++) {
+                a.m[j][i] = m[i][j];
+            }
+        }
+        return a;
+    }
+
+    Matrix operator+(const Matrix & b) const {
+        Matrix a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < C; j++) {
+                a.m[i][j] = m[i][j] + b.m[i][j];
+            }
+        }
+        return a;
+    }
+
+    Matrix operator-(const Matrix & b) const {
+        Matrix a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < C; j++) {
+                a.m[i][j] = m[i][j] - b.m[i][j];
+            }
+        }
+        return a;
+    }
+
+    Matrix operator*(float k) const {
+        Matrix a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < C; j++) {
+                a.m[i][j] = m[i][j] * k;
+            }
+        }
+        return a;
+    }
+
+    template <int K>
+    Matrix<R, K> operator*(const Matrix<C, K> & b) const {
+        Matrix<R, K> a;
+        for (int i = 0; i < R; i++) {
+            for (int j = 0; j < K; j++) {
+                float sum = 0.f;
+                for (int k = 0; k < C; k++) {
+                    sum += m[i][k] * b.m[k][j];
+                }
+                a.m[i][j] = sum;
+            }
+        }
+        return a;
+    }
+
+    /**
+     * Makes the matrix exactly symmetric, to contain the rounding errors of
+     * a covariance update.
+     */
+    void symmetrize() {
+        for (int i = 0; i < R; i++) {
+            for (int j = i + 1; j < C; j++) {
+                float s = .5f * (m[i][j] + m[j][i]);
+                m[i][j] = s;
+                m[j][i] = s;
+            }
+        }
+    }
+};
+
+/**
+ * Inverts a square matrix by Gauss-Jordan elimination with partial pivoting.
+ *
+ * @return false if the matrix is singular.
+ */
+template <int N>
+bool invert(const Matrix<N, N> & a, Matrix<N, N> & inverse)
+{
+    Matrix<N, N> b = a;
+    inverse = Matrix<N, N>::identity();
+    for (int c = 0; c < N; c++) {
+        // Pivot
+        int p = c;
+        for (int i = c + 1; i < N; i++) {
+            if (fabsf(b.m[i][c]) > fabsf(b.m[p][c])) {
+                p = i;
+            }
+        }
+        if (b.m[p][c] == 0.f) {
+            return false;
+        }
+        if (p != c) {
+            for (int j = 0; j < N; j++) {
+                float t = b.m[c][j]; b.m[c][j] = b.m[p][j]; b.m[p][j] = t;
+                t = inverse.m[c][j]; inverse.m[c][j] = inverse.m[p][j]; inverse.m[p][j] = t;
+            }
+        }
+        // Normalize the pivot row
+        float k = 1.f / b.m[c][c];
+        for (int j = 0; j < N; j++) {
+            b.m[c][j] *= k;
+            inverse.m[c][j] *= k;
+        }
+        // Eliminate the column from the other rows
+        for (int i = 0; i < N; i++) {
+            if (i != c) {
+                float f = b.m[i][c];
+                for (int j = 0; j < N; j++) {
+                    b.m[i][j] -= f * b.m[c][j];
+                    inverse.m[i][j] -= f * inverse.m[c][j];
+                }
+            }
+        }
+    }
+    return true;
+}
+
+}
+}
+}
+
+#endif
@@ -17,69 +17,130 @@
  */
 
 #include "Motors.h"
-#include "mraa.h"
+#include "FlightService.h"
+#include <stdio.h>
+#include <string.h>
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
-#define PWM_FL_PIN 0
-#define PWM_FR_PIN 14
-#define PWM_BR_PIN 20
-#define PWM_BL_PIN 21
+// Period and pulse range of each protocol, in microseconds
+static const struct {
+    float period;
+    float min_pulse;
+    float max_pulse;
+} PROTOCOLS[] = {
+    { 1000000.f / 450.f, 1000.f, 2000.f },  // PWM, 450Hz
+    { 500.f, 125.f, 250.f },                // ONESHOT125, 2kHz
+    { 168.f, 42.f, 84.f },                  // ONESHOT42, 6kHz
+};
 
-Motors::Motors() : min_pwm(0), max_pwm(0)
+// Output indexes, in the order of the HAL
+enum {
+    FL,
+    FR,
+    BR,
+    BL
+};
+
+Motors::Motors(FlightService *context) :
+    hal(context->hal),
+    settings_version(0),
+    min_pwm(0),
+    max_pwm(0),
+    period_ns(1000000000/450),
+    started(false)
 {
-    this->pwm_fl = mraa_pwm_init(PWM_FL_PIN);
-    this->pwm_fr = mraa_pwm_init(PWM_FR_PIN);
-    this->pwm_br = mraa_pwm_init(PWM_BR_PIN);
-    this->pwm_bl = mraa_pwm_init(PWM_BL_PIN);
-
-    if (!this->pwm_fl ||
-            !this->pwm_fr ||
-            !this->pwm_br ||
-            !this->pwm_bl) {
-        printf("PWM not available.\n");
-        exit(1);
+    for (int i = 0; i < 4; i++) {
+        outputs[i] = 0.;
     }
-
-    // Set the frequency to 450Hz
-    mraa_pwm_period_us(this->pwm_fl, 1000000/450);
-    mraa_pwm_period_us(this->pwm_fr, 1000000/450);
-    mraa_pwm_period_us(this->pwm_br, 1000000/450);
-    mraa_pwm_period_us(this->pwm_bl, 1000000/450);
 }
 
 void Motors::begin()
 {
-    mraa_pwm_enable(this->pwm_fl, 1);
-    mraa_pwm_enable(this->pwm_fr, 1);
-    mraa_pwm_enable(this->pwm_br, 1);
-    mraa_pwm_enable(this->pwm_bl, 1);
+    hal->beginMotors(period_ns);
+    started = true;
+}
+
+void Motors::getOutputs(float outputs[4]) const
+{
+    for (int i = 0; i < 4; i++) {
+        outputs[i] = this->outputs[i];
+    }
+}
+
+bool Motors::isStopped() const
+{
+    for (int i = 0; i < 4; i++) {
+        if (outputs[i] > min_pwm) {
+            return false;
+        }
+    }
+    return true;
 }
 
 void Motors::setConfig(const CommandPacket::MotorsConfig &config)
 {
-    min_pwm = config.min_pwm();
-    max_pwm = config.max_pwm();
+    MotorsSettings s;
+    memset(&s, 0, sizeof(s));
+    int protocol = config.protocol();
+    float period = config.has_period() ? config.period() : PROTOCOLS[protocol].period;
+    if (config.has_min_pulse() && config.has_max_pulse()) {
+        s.min_pwm = config.min_pulse() / period;
+        s.max_pwm = config.max_pulse() / period;
+    } else if (protocol != CommandPacket::MotorsConfig::PWM) {
+        s.min_pwm = PROTOCOLS[protocol].min_pulse / period;
+        s.max_pwm = PROTOCOLS[protocol].max_pulse / period;
+    } else {
+        s.min_pwm = config.min_pwm();
+        s.max_pwm = config.max_pwm();
+    }
+    s.period_ns = (int)(period * 1000.f);
+
+    // min_pwm == max_pwm is a valid configuration which stops the motors
+    if (!(period > 0.) || !(s.min_pwm >= 0.) || !(s.max_pwm >= s.min_pwm) || !(s.max_pwm <= 1.)) {
+        fprintf(stderr, "Motors: Invalid configuration ignored\n");
+        return;
+    }
+    settings.publish(s);
 }
 
-void Motors::setControl(const MotorsControl &control)
+void Motors::setControl(const MotorsCommand &control)
 {
-    float g = control.altitude_throttle();
-    float r = control.roll_throttle();
-    float p = control.pitch_throttle();
-    float y = control.yaw_throttle();
+    // Apply the new configuration
+    unsigned int version = settings.getVersion();
+    if (version != settings_version) {
+        settings_version = version;
+        const MotorsSettings & config = *settings.get();
+        min_pwm = config.min_pwm;
+        max_pwm = config.max_pwm;
+        if (config.period_ns != period_ns) {
+            period_ns = config.period_ns;
+            if (started) {
+                hal->setMotorsPeriod(period_ns);
+            }
+        }
+    }
+
+    float g = control.altitude_throttle;
+    float r = control.roll_throttle;
+    float p = control.pitch_throttle;
+    float y = control.yaw_throttle;
 
     float fl =  r + p - y + g;
     float fr = -r + p + y + g;
     float br = -r - p - y + g;
     float bl =  r - p + y + g;
 
-    mraa_pwm_write(this->pwm_fl, scale(fl));
-    mraa_pwm_write(this->pwm_fr, scale(fr));
-    mraa_pwm_write(this->pwm_br, scale(br));
-    mraa_pwm_write(this->pwm_bl, scale(bl));
+    outputs[FL] = scale(fl);
+    outputs[FR] = scale(fr);
+    outputs[BR] = scale(br);
+    outputs[BL] = scale(bl);
+
+    if (started) {
+        hal->writeMotors(outputs);
+    }
 }
 
 }
@@ -20,7 +20,9 @@
 #define _MOTORS_H_
 
 #include "Communication.pb.h"
-#include "mraa.hpp"
+#include "Snapshot.h"
+#include "FlightData.h"
+#include "Hal.h"
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 #define MIN(x, y) ((x) < (y) ? (x) : (y))
@@ -29,6 +31,17 @@ namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+class FlightService;
+
+/**
+ * Motors configuration, flattened from MotorsConfig.
+ */
+struct MotorsSettings {
+    float min_pwm; // Duty cycle at zero throttle
+    float max_pwm; // Duty cycle at full throttle
+    int period_ns;
+};
+
 /**
  * This class commands the ESC for the 4 motors.
  * 
@@ -36,19 +49,51 @@ namespace flightapp {
  * This class expects an QuadCopter in X configuration in the following motors
  * order: front-left, front-right, back-right, back-left.
  * </p>
+ *
+ * <p>
+ * The ESC protocol is selected by the MotorsConfig. In the OneShot modes, the
+ * PWM period is only slightly longer than the longest pulse, and the new duty
+ * cycles are written as soon as the controller has computed the mix, so that
+ * a new setpoint reaches the ESC within a fraction of a millisecond instead of
+ * waiting for the next 450Hz frame.
+ * </p>
+ *
+ * <p>
+ * The configuration is published as an immutable snapshot and applied by the
+ * control thread at the next setControl() call.
+ * </p>
  */
 class Motors {
 public:
-    Motors();
+    Motors(FlightService *context);
+
+    /**
+     * Starts the motor outputs of the HAL. Until then, the duty cycles are
+     * only computed.
+     */
     void begin();
     void setConfig(const CommandPacket::MotorsConfig & config);
-    void setControl(const MotorsControl & control);
+    void setControl(const MotorsCommand & control);
+
+    /**
+     * Duty cycles computed by the last setControl() call, in the front-left,
+     * front-right, back-right and back-left order.
+     */
+    void getOutputs(float outputs[4]) const;
+
+    /**
+     * Whether the last setControl() call left every motor at the duty cycle
+     * of zero throttle, or below.
+     */
+    bool isStopped() const;
 private:
+    Hal *hal;
+    Snapshot<MotorsSettings> settings;
+    unsigned int settings_version;
     float min_pwm, max_pwm;
-    mraa_pwm_context pwm_fl;
-    mraa_pwm_context pwm_fr;
-    mraa_pwm_context pwm_br;
-    mraa_pwm_context pwm_bl;
+    int period_ns;
+    float outputs[4];
+    bool started;
     inline float scale(float value) {
         return MAX(MIN((max_pwm - min_pwm) * value + min_pwm, max_pwm), 0);
     }
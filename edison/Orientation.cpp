@@ -0,0 +1,57 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Orientation.h"
+#include "Communication.pb.h"
+#include <stddef.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+template <class O>
+struct Instance {
+    static const OrientationFunctions functions;
+};
+
+template <class O>
+const OrientationFunctions Instance<O>::functions = { &O::remap, &O::rotateFloat };
+
+const OrientationFunctions * getOrientation(int orientation)
+{
+    switch (orientation) {
+    case CommandPacket::SensorsConfig::YAW_0:
+        return &Instance<Yaw0>::functions;
+    case CommandPacket::SensorsConfig::YAW_90:
+        return &Instance<Yaw90>::functions;
+    case CommandPacket::SensorsConfig::YAW_180:
+        return &Instance<Yaw180>::functions;
+    case CommandPacket::SensorsConfig::YAW_270:
+        return &Instance<Yaw270>::functions;
+    case CommandPacket::SensorsConfig::ROLL_180:
+        return &Instance<Roll180>::functions;
+    case CommandPacket::SensorsConfig::PITCH_180:
+        return &Instance<Pitch180>::functions;
+    default:
+        return NULL;
+    }
+}
+
+}
+}
+}
@@ -0,0 +1,119 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ORIENTATION_H_
+#define _ORIENTATION_H_
+
+#include "Hal.h"
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Raw sensor values in the body frame, x forward, y right and z down.
+ */
+struct BodySample {
+    int32_t gyro[3];
+    int32_t accel[3];
+    int32_t mag[3];
+};
+
+/**
+ * Orientation of the sensor board in the vehicle, as the matrix of -1, 0 and
+ * 1 which converts the sensor axes to the body axes.
+ *
+ * <p>
+ * The coefficients are template parameters, so the products by 0 and 1 and
+ * the additions of 0 are removed by the compiler: each body value is a copy
+ * or a negation of a sensor value.
+ * </p>
+ */
+template <int XX, int XY, int XZ,
+          int YX, int YY, int YZ,
+          int ZX, int ZY, int ZZ>
+struct Orientation {
+
+    /**
+     * Converts a vector from the sensor axes to the body axes.
+     */
+    template <class T>
+    static void rotate(const T sensor[3], T body[3]) {
+        body[0] = XX * sensor[0] + XY * sensor[1] + XZ * sensor[2];
+        body[1] = YX * sensor[0] + YY * sensor[1] + YZ * sensor[2];
+        body[2] = ZX * sensor[0] + ZY * sensor[1] + ZZ * sensor[2];
+    }
+
+    /**
+     * Converts a vector from the body axes to the sensor axes, with the
+     * transposed matrix.
+     */
+    template <class T>
+    static void unrotate(const T body[3], T sensor[3]) {
+        sensor[0] = XX * body[0] + YX * body[1] + ZX * body[2];
+        sensor[1] = XY * body[0] + YY * body[1] + ZY * body[2];
+        sensor[2] = XZ * body[0] + YZ * body[1] + ZZ * body[2];
+    }
+
+    static void remap(const RawSample & sample, BodySample & body) {
+        const int32_t gyro[3] = { sample.gx, sample.gy, sample.gz };
+        const int32_t accel[3] = { sample.ax, sample.ay, sample.az };
+        const int32_t mag[3] = { sample.mx, sample.my, sample.mz };
+        rotate(gyro, body.gyro);
+        rotate(accel, body.accel);
+        rotate(mag, body.mag);
+    }
+
+    static void rotateFloat(const float sensor[3], float body[3]) {
+        rotate(sensor, body);
+    }
+};
+
+// Sensor axes rotated around the body axes
+typedef Orientation< 1,  0,  0,   0,  1,  0,   0,  0,  1> Yaw0;
+typedef Orientation< 0, -1,  0,   1,  0,  0,   0,  0,  1> Yaw90;
+typedef Orientation<-1,  0,  0,   0, -1,  0,   0,  0,  1> Yaw180;
+typedef Orientation< 0,  1,  0,  -1,  0,  0,   0,  0,  1> Yaw270;
+typedef Orientation< 1,  0,  0,   0, -1,  0,   0,  0, -1> Roll180;
+typedef Orientation<-1,  0,  0,   0,  1,  0,   0,  0, -1> Pitch180;
+
+/**
+ * Orientation of the Edison board, rotated by 180 degrees around z.
+ */
+typedef Yaw180 BoardOrientation;
+
+/**
+ * Functions of an orientation selected at run time.
+ */
+struct OrientationFunctions {
+    void (*remap)(const RawSample & sample, BodySample & body);
+    void (*rotate)(const float sensor[3], float body[3]);
+};
+
+/**
+ * Functions of an orientation of SensorsConfig, instantiated for each of
+ * them, or NULL if the orientation is unknown.
+ */
+const OrientationFunctions * getOrientation(int orientation);
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,236 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PwmTest.h"
+#include "SimulatedVehicle.h"
+#include "SysfsPwm.h"
+#include "Timestamp.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Periods of the PWM and OneShot125 protocols, in nanoseconds
+#define PWM_PERIOD_NS 2222222
+#define ONESHOT125_PERIOD_NS 500000
+
+// Files of each channel of the fake chip
+#define CHANNEL_FILES 3
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+static const char *FILES[CHANNEL_FILES] = { "period", "enable", "duty_cycle" };
+
+// Fake pwmchip directory with the files of SysfsPwm::MAX_OUTPUTS channels
+class FakeChip {
+public:
+    FakeChip() :
+        created(false)
+    {
+        snprintf(root, sizeof(root), "/tmp/PwmTest.XXXXXX");
+        if (!mkdtemp(root)) {
+            perror("PwmTest: mkdtemp");
+            return;
+        }
+        created = true;
+        for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+            char path[192];
+            snprintf(path, sizeof(path), "%s/pwm%d", root, i);
+            if (mkdir(path, 0700) == -1) {
+                perror(path);
+                created = false;
+            }
+            for (int j = 0; j < CHANNEL_FILES; j++) {
+                filePath(path, sizeof(path), i, FILES[j]);
+                int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+                if (fd == -1) {
+                    perror(path);
+                    created = false;
+                } else {
+                    close(fd);
+                }
+            }
+        }
+    }
+
+    ~FakeChip()
+    {
+        char path[192];
+        for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+            for (int j = 0; j < CHANNEL_FILES; j++) {
+                filePath(path, sizeof(path), i, FILES[j]);
+                unlink(path);
+            }
+            snprintf(path, sizeof(path), "%s/pwm%d", root, i);
+            rmdir(path);
+        }
+        rmdir(root);
+    }
+
+    void filePath(char *path, size_t size, int channel, const char *file) const
+    {
+        snprintf(path, size, "%s/pwm%d/%s", root, channel, file);
+    }
+
+    // Empties a file, like a sysfs attribute which is rewritten from its start
+    void clear(int channel, const char *file) const
+    {
+        char path[192];
+        filePath(path, sizeof(path), channel, file);
+        truncate(path, 0);
+    }
+
+    // Content of a file
+    void read(int channel, const char *file, char *text, size_t size) const
+    {
+        char path[192];
+        filePath(path, sizeof(path), channel, file);
+        text[0] = 0;
+        int fd = open(path, O_RDONLY);
+        if (fd != -1) {
+            ssize_t length = ::read(fd, text, size - 1);
+            text[length > 0 ? length : 0] = 0;
+            close(fd);
+        }
+    }
+
+    char root[64];
+    bool created;
+};
+
+// Sets the period of the fake chip and checks the files of each channel
+static bool setPeriod(SysfsPwm & pwm, const FakeChip & chip, int period_ns)
+{
+    for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+        chip.clear(i, "period");
+        chip.clear(i, "duty_cycle");
+    }
+    bool ok = pwm.setPeriod(period_ns);
+    char expected[16];
+    snprintf(expected, sizeof(expected), "%d", period_ns);
+    for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+        char period[16], duty[16];
+        chip.read(i, "period", period, sizeof(period));
+        chip.read(i, "duty_cycle", duty, sizeof(duty));
+        ok = ok && !strcmp(period, expected) && !strcmp(duty, "0");
+    }
+    if (!ok) {
+        fprintf(stderr, "PwmTest: Wrong period files for %dns\n", period_ns);
+    }
+    return ok;
+}
+
+// Runs ticks at the current period, and checks the written strings
+static bool runTicks(SysfsPwm & pwm, const FakeChip & chip, int period_ns, int ticks, Random & random,
+        unsigned long & max_writes, double & time)
+{
+    float duty[SysfsPwm::MAX_OUTPUTS] = {};
+    int previous[SysfsPwm::MAX_OUTPUTS] = {};
+    for (int t = 0; t < ticks; t++) {
+        // Every other tick repeats the duty cycles, one output is also kept
+        // on the other ticks
+        bool repeated = t & 1;
+        if (!repeated) {
+            for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+                if (i != t / 2 % SysfsPwm::MAX_OUTPUTS) {
+                    duty[i] = random.uniform(-.05f, 1.05f);
+                }
+            }
+        }
+        for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+            chip.clear(i, "duty_cycle");
+        }
+
+        unsigned long writes = pwm.getWriteCount();
+        Timestamp start = Timestamp::now();
+        for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+            pwm.write(i, duty[i]);
+        }
+        pwm.update();
+        time += Timestamp::now() - start;
+        writes = pwm.getWriteCount() - writes;
+        if (writes > max_writes) {
+            max_writes = writes;
+        }
+
+        unsigned long changed = 0;
+        for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+            float clamped = fminf(fmaxf(duty[i], 0.f), 1.f);
+            int step = (int)(clamped * (SysfsPwm::STEPS - 1) + .5f);
+            long long ns = llround((double)period_ns * step / (SysfsPwm::STEPS - 1));
+            char text[16], expected[16] = "";
+            if (step != previous[i]) {
+                snprintf(expected, sizeof(expected), "%lld", ns);
+                changed++;
+            }
+            chip.read(i, "duty_cycle", text, sizeof(text));
+            if (strcmp(text, expected) || fabs(ns - (double)clamped * period_ns) > period_ns / (2. * (SysfsPwm::STEPS - 1)) + 1.) {
+                fprintf(stderr, "PwmTest: Tick %d, output %d, duty cycle %.4f at %dns, wrote \"%s\" instead of \"%s\"\n",
+                        t, i, duty[i], period_ns, text, expected);
+                return false;
+            }
+            previous[i] = step;
+        }
+        if (writes != changed || (repeated && writes)) {
+            fprintf(stderr, "PwmTest: Tick %d, %lu write(s) for %lu changed output(s)\n", t, writes, changed);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool PwmTest::run(int ticks)
+{
+    FakeChip chip;
+    if (!chip.created) {
+        return false;
+    }
+    SysfsPwm pwm(chip.root);
+    for (int i = 0; i < SysfsPwm::MAX_OUTPUTS; i++) {
+        if (!pwm.open(i, i)) {
+            return false;
+        }
+    }
+    pwm.setUpdateMode(SysfsPwm::UPDATE_SYNCHRONIZED);
+
+    Random random(1);
+    unsigned long max_writes = 0;
+    double time = 0.;
+    bool passed = setPeriod(pwm, chip, PWM_PERIOD_NS);
+    passed = passed && pwm.enable(true);
+    char enabled[4];
+    chip.read(0, "enable", enabled, sizeof(enabled));
+    passed = passed && !strcmp(enabled, "1");
+    passed = passed && runTicks(pwm, chip, PWM_PERIOD_NS, ticks / 2, random, max_writes, time);
+    // The table is rebuilt for the new period
+    passed = passed && setPeriod(pwm, chip, ONESHOT125_PERIOD_NS);
+    passed = passed && runTicks(pwm, chip, ONESHOT125_PERIOD_NS, ticks - ticks / 2, random, max_writes, time);
+
+    fprintf(stderr, "PwmTest: %d ticks, %.2f writes per tick (at most %lu), %.0fns per tick\n",
+            ticks, (double)pwm.getWriteCount() / ticks, max_writes, time / ticks * 1.e9);
+    return passed && max_writes <= SysfsPwm::MAX_OUTPUTS;
+}
+
+}
+}
+}
@@ -0,0 +1,56 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PWMTEST_H_
+#define _PWMTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of SysfsPwm on a fake sysfs tree.
+ *
+ * <p>
+ * A pwmchip directory with the period, enable and duty_cycle files of four
+ * channels is created in a temporary directory, and the outputs are driven
+ * like EdisonHal does: the four duty cycles of a tick are staged, then sent
+ * by update(). The duty_cycle files are truncated before each tick, so that
+ * each one holds exactly the string written during the tick, or nothing if
+ * the output was not written. Half of the ticks repeat the duty cycles of the
+ * previous tick.
+ * </p>
+ */
+class PwmTest {
+public:
+    /**
+     * Runs the given number of ticks and prints the number of writes and the
+     * time per tick.
+     *
+     * @return false if a tick issues more than one write per output, if an
+     *         unchanged output is written, or if a duty_cycle file does not
+     *         hold the nanosecond string of the duty cycle.
+     */
+    static bool run(int ticks);
+};
+
+}
+}
+}
+
+#endif
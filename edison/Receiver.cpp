@@ -21,6 +21,8 @@
 #include "DatagramSocket.h"
 #include <fcntl.h>
 #include <poll.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include <stdio.h>
 
 namespace org {
@@ -28,21 +30,31 @@ namespace hummingdroid {
 namespace flightapp {
 
 Receiver::Receiver(FlightService *context) :
+    hal(context->hal),
     controller(&context->controller),
     telemetry(&context->telemetry),
     sensors(&context->sensors),
     motors(&context->motors),
+    recorder(&context->recorder),
+    port(context->command_port),
     connected(false)
 {
+    for (int i = 0; i < MAILBOX_SIZE; i++) {
+        available.push(i);
+    }
 }
 
 void Receiver::run()
 {
     fprintf(stderr, "Receiver: Thread started\n");
     DatagramSocket socket;
-    socket.bind(REMOTE_COMMAND_UDP_PORT);
+    if (!socket.bind(port)) {
+        fprintf(stderr, "Receiver: Cannot listen to the commands on port %d\n", port);
+        exit(EXIT_FAILURE);
+    }
     fcntl(socket.udp_socket, F_SETFL, O_NONBLOCK);
 
+    int mail = -1;
     while(true) {
         // Wait for incoming packet
         {
@@ -50,9 +62,15 @@ void Receiver::run()
             poll(&fds, 1, connected ? REMOTE_COMMAND_TIMEOUT_MS : -1);
         }
 
+        // Get a free mail, the current one is kept if it was not sent
+        char overflow[MAX_PACKET_SIZE];
+        char *data = overflow;
+        if (mail != -1 || available.pop(mail)) {
+            data = mails[mail].data;
+        }
+
         // Read the packet
-        char data[2048];
-        ssize_t size = read(socket.udp_socket, data, sizeof(data));
+        ssize_t size = read(socket.udp_socket, data, MAX_PACKET_SIZE);
         if (size <= 0) {
             connected = false;
             fprintf(stderr, "Receiver: Link lost\n");
@@ -61,38 +79,107 @@ void Receiver::run()
             fprintf(stderr, "Receiver: Link established\n");
             connected = true;
         }
+        if (mail == -1) {
+            fprintf(stderr, "Receiver: Mailbox full, packet dropped\n");
+            continue;
+        }
 
         // Decode the packet
-        CommandPacket command;
-        if (!command.ParseFromArray(data, size)) {
+        mails[mail].received = hal->now();
+        if (!mails[mail].packet.ParseFromArray(data, size)) {
             fprintf(stderr, "Received invalid CommandPacket\n");
             continue;
         }
 
-        // Process the command
-        if (command.has_command()) {
-            controller->setCommand(command.command());
-            telemetry->setCommand(command.command());
-        }
-        if (command.has_controller_config()) {
-            controller->setConfig(command.controller_config());
-        }
-        if (command.has_telemetry_config()) {
-            telemetry->setConfig(command.telemetry_config());
+        // Send it to the control thread
+        mails[mail].size = size;
+        pending.push(mail);
+        mail = -1;
+    }
+}
+
+void Receiver::dispatchPending()
+{
+    int mail;
+    while (pending.pop(mail)) {
+        if (recorder->isRecording()) {
+            recorder->recordPacket(mails[mail].data, mails[mail].size);
         }
-        if (command.has_sensors_config()) {
-            sensors->setConfig(command.sensors_config());
+        apply(mails[mail].packet, mails[mail].received);
+        available.push(mail);
+    }
+}
+
+void Receiver::dispatch(const void *data, int size)
+{
+    if (!command.ParseFromArray(data, size)) {
+        fprintf(stderr, "Received invalid CommandPacket\n");
+        return;
+    }
+    apply(command, hal->now());
+}
+
+void Receiver::apply(const CommandPacket &command, const Timestamp &received)
+{
+    // Synchronize the clocks
+    if (command.has_pong()) {
+        const ClockPong & pong = command.pong();
+        clock.add(pong.air_time(), pong.ground_receive_time(), pong.ground_send_time(), received);
+    }
+
+    if (command.has_telemetry_ack()) {
+        telemetry->acknowledge(command.telemetry_ack());
+    }
+
+    // Process the command
+    if (command.has_command()) {
+        if (command.command().has_timestamp()) {
+            measureLatency(command.command().timestamp());
         }
-        if (command.has_motors_config()) {
-            motors->setConfig(command.motors_config());
-            // TODO: add a specific reset command
-            if (command.motors_config().min_pwm() == command.motors_config().max_pwm()) {
-                sensors->reset();
-            }
+        controller->setCommand(command.command());
+        telemetry->setCommand(command.command());
+    }
+    if (command.has_controller_config()) {
+        controller->setConfig(command.controller_config());
+    }
+    if (command.has_telemetry_config()) {
+        telemetry->setConfig(command.telemetry_config());
+    }
+    if (command.has_sensors_config()) {
+        sensors->setConfig(command.sensors_config());
+    }
+    if (command.has_motors_config()) {
+        motors->setConfig(command.motors_config());
+        // TODO: add a specific reset command
+        if (command.motors_config().min_pwm() == command.motors_config().max_pwm()) {
+            sensors->reset();
         }
     }
 }
 
+void Receiver::measureLatency(double timestamp)
+{
+    if (!clock.isSynchronized()) {
+        return;
+    }
+    double now = hal->now();
+    latencies.add(now - clock.toAir(timestamp));
+    if (latencies.getCount() < LATENCY_REPORT_COMMANDS) {
+        return;
+    }
+    LatencyState l;
+    l.clock_offset = clock.getOffset(now);
+    l.clock_skew = clock.getSkew();
+    l.round_trip = clock.getRoundTrip();
+    l.count = latencies.getCount();
+    l.p50 = latencies.getPercentile(.5f);
+    l.p90 = latencies.getPercentile(.9f);
+    l.p99 = latencies.getPercentile(.99f);
+    l.max = latencies.getMax();
+    telemetry->setLatency(l);
+    latencies.clear();
+}
+
 }
 }
 }
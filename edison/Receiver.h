@@ -22,38 +22,74 @@
 #include "Thread.h"
 #include "Controller.h"
 #include "Sensors.h"
+#include "SpscQueue.h"
+#include "ClockSync.h"
+#include "LatencyHistogram.h"
+#include "Hal.h"
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
 class FlightService;
+class Recorder;
 
 /**
  * Remote commands receiver
  * 
  * <p>
- * This class listens to incoming commands from UDP port 49152.
+ * This class listens to incoming commands on the command port of the
+ * FlightService, UDP port 49152 by default.
+ * </p>
+ *
+ * <p>
+ * The received packets are decoded by the receiver thread, then passed through
+ * a lock-free mailbox to the control thread, which applies them before
+ * processing the next sample. The commands are thus applied at a well defined
+ * point of the control loop, which makes a recorded flight reproducible.
+ * </p>
+ *
+ * <p>
+ * The clock pongs of the ground station, answers to the pings of the
+ * telemetry, synchronize a ClockSync with the reception times of the
+ * packets. The commands are then stamped on the air clock, and the delay
+ * until the controller applies them is reported to the telemetry every
+ * LATENCY_REPORT_COMMANDS commands.
  * </p>
  */
 class Receiver : public Thread {
 
 public:
-    /**
-	 * UDP port for remote commands.
-	 */
-    static const int REMOTE_COMMAND_UDP_PORT = 49152;
-
 	/**
 	 * Delay without receiving remote command after which we consider the link
 	 * disconnected.
 	 */
     static const int REMOTE_COMMAND_TIMEOUT_MS = 200;
 
+    /**
+     * Maximum size of a command packet.
+     */
+    static const int MAX_PACKET_SIZE = 2048;
+
+    /**
+     * Number of packets which can wait for the control thread.
+     */
+    static const int MAILBOX_SIZE = 8;
+
+    /**
+     * Number of commands of each latency report.
+     */
+    static const int LATENCY_REPORT_COMMANDS = 100;
+
+    Hal *hal;
     Controller *controller;
     Telemetry *telemetry;
     Sensors *sensors;
     Motors *motors;
+    Recorder *recorder;
+
+    // UDP port for remote commands
+    int port;
 
     bool connected;
 
@@ -62,8 +98,43 @@ public:
 	 */
     Receiver(FlightService* context);
 
+    /**
+     * Applies the packets received since the last call, from the control
+     * thread.
+     */
+    void dispatchPending();
+
+    /**
+     * Decodes and applies a packet immediately, for the replay.
+     */
+    void dispatch(const void *data, int size);
+
     // Thread entry point
     void run();
+
+private:
+    struct Mail {
+        // Reused for each packet, so that its fields keep their memory
+        CommandPacket packet;
+        int size;
+        char data[MAX_PACKET_SIZE];
+        Timestamp received;
+    };
+
+    // Packets waiting for the control thread, and free mails
+    Mail mails[MAILBOX_SIZE];
+    SpscQueue<int, MAILBOX_SIZE> pending;
+    SpscQueue<int, MAILBOX_SIZE> available;
+
+    // Used by dispatch()
+    CommandPacket command;
+
+    // Control thread only
+    ClockSync clock;
+    LatencyHistogram latencies;
+
+    void apply(const CommandPacket & command, const Timestamp & received);
+    void measureLatency(double timestamp);
 };
 
 }
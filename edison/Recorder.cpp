@@ -0,0 +1,199 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Recorder.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAGIC "HDR2"
+
+// Delay between two writes of the ring buffer content, in microseconds
+#define WRITE_PERIOD 20000
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Little-endian encoding, the Edison and the hosts are all little-endian
+static inline char *put(char *p, const void *value, int size)
+{
+    memcpy(p, value, size);
+    return p + size;
+}
+
+static inline const char *get(const char *p, void *value, int size)
+{
+    memcpy(value, p, size);
+    return p + size;
+}
+
+Recorder::Recorder() :
+    fd(-1),
+    recording(false),
+    head(0),
+    tail(0),
+    dropped(0)
+{
+}
+
+bool Recorder::open(const char *path)
+{
+    fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        perror("Recorder: Cannot create the record file");
+        return false;
+    }
+    if (write(fd, MAGIC, 4) != 4) {
+        perror("Recorder: Cannot write the record file");
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    recording = true;
+    return true;
+}
+
+void Recorder::copy(unsigned int position, const void *data, int size)
+{
+    unsigned int start = position & (SIZE - 1);
+    unsigned int first = size < (int)(SIZE - start) ? size : SIZE - start;
+    memcpy(ring + start, data, first);
+    memcpy(ring, (const char *)data + first, size - first);
+}
+
+void Recorder::append(uint8_t type, const void *payload, int size)
+{
+    unsigned int t = tail.load(std::memory_order_relaxed);
+    unsigned int used = t - head.load(std::memory_order_acquire);
+    if (size > MAX_PAYLOAD || used + 3 + size > SIZE) {
+        dropped++;
+        return;
+    }
+    uint16_t length = size;
+    char header[3];
+    header[0] = type;
+    memcpy(header + 1, &length, 2);
+    copy(t, header, 3);
+    copy(t + 3, payload, size);
+    tail.store(t + 3 + size, std::memory_order_release);
+}
+
+void Recorder::recordSample(const RawSample &sample)
+{
+    char payload[SAMPLE_SIZE];
+    char *p = payload;
+    int16_t values[10] = {
+        sample.ax, sample.ay, sample.az,
+        sample.gx, sample.gy, sample.gz,
+        sample.mx, sample.my, sample.mz,
+        sample.temp
+    };
+    p = put(p, values, sizeof(values));
+    int64_t sec = sample.accel_timestamp.t.tv_sec;
+    int32_t nsec = sample.accel_timestamp.t.tv_nsec;
+    p = put(p, &sec, 8);
+    p = put(p, &nsec, 4);
+    sec = sample.gyro_timestamp.t.tv_sec;
+    nsec = sample.gyro_timestamp.t.tv_nsec;
+    p = put(p, &sec, 8);
+    p = put(p, &nsec, 4);
+    append(SAMPLE, payload, p - payload);
+}
+
+bool Recorder::decodeSample(const char *payload, int size, RawSample &sample)
+{
+    if (size != SAMPLE_SIZE) {
+        return false;
+    }
+    const char *p = payload;
+    int16_t values[10];
+    p = get(p, values, sizeof(values));
+    sample.ax = values[0];
+    sample.ay = values[1];
+    sample.az = values[2];
+    sample.gx = values[3];
+    sample.gy = values[4];
+    sample.gz = values[5];
+    sample.mx = values[6];
+    sample.my = values[7];
+    sample.mz = values[8];
+    sample.temp = values[9];
+    int64_t sec;
+    int32_t nsec;
+    p = get(p, &sec, 8);
+    p = get(p, &nsec, 4);
+    sample.accel_timestamp.t.tv_sec = sec;
+    sample.accel_timestamp.t.tv_nsec = nsec;
+    p = get(p, &sec, 8);
+    p = get(p, &nsec, 4);
+    sample.gyro_timestamp.t.tv_sec = sec;
+    sample.gyro_timestamp.t.tv_nsec = nsec;
+    return true;
+}
+
+void Recorder::recordPacket(const void *data, int size)
+{
+    append(PACKET, data, size);
+}
+
+void Recorder::recordMotors(const float outputs[4])
+{
+    append(MOTORS, outputs, 4 * sizeof(float));
+}
+
+void Recorder::recordCalibration(const GyroCalibration &calibration)
+{
+    append(CALIBRATION, &calibration, sizeof(calibration));
+}
+
+void Recorder::run()
+{
+    fprintf(stderr, "Recorder: Thread started\n");
+    unsigned int reported = 0;
+    while (fd != -1) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        unsigned int t = tail.load(std::memory_order_acquire);
+        if (h == t) {
+            if (dropped != reported) {
+                reported = dropped;
+                fprintf(stderr, "Recorder: %u records dropped, the replay will diverge\n", reported);
+            }
+            usleep(WRITE_PERIOD);
+            continue;
+        }
+        unsigned int start = h & (SIZE - 1);
+        unsigned int size = t - h;
+        if (start + size > SIZE) {
+            size = SIZE - start;
+        }
+        ssize_t written = write(fd, ring + start, size);
+        if (written <= 0) {
+            perror("Recorder: Cannot write the record file");
+            close(fd);
+            fd = -1;
+            break;
+        }
+        head.store(h + written, std::memory_order_release);
+    }
+}
+
+}
+}
+}
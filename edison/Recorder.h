@@ -0,0 +1,104 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _RECORDER_H_
+#define _RECORDER_H_
+
+#include "Thread.h"
+#include "Sensors.h"
+#include <atomic>
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Flight recorder, for a deterministic replay.
+ *
+ * <p>
+ * The control thread records, in this order for each sample, the command
+ * packets applied before the sample, the raw sample and the resulting motors
+ * duty cycles. The gyroscope calibration the flight started with is recorded
+ * before the first sample. The records are appended without lock nor allocation to a ring
+ * buffer, and written to the file by the recorder thread. A record which does
+ * not fit in the ring buffer is dropped, and the replay will diverge from
+ * this point.
+ * </p>
+ *
+ * <p>
+ * The file starts with the 4 bytes "HDR2". Each record is a type byte, a 16
+ * bits little-endian payload size and the payload.
+ * </p>
+ */
+class Recorder : public Thread {
+
+public:
+    enum Type {
+        SAMPLE = 1, // Encoded RawSample
+        PACKET = 2, // CommandPacket datagram
+        MOTORS = 3, // Duty cycles of the 4 motors, 4 floats
+        CALIBRATION = 4 // Initial GyroCalibration
+    };
+
+    static const int MAX_PAYLOAD = 2048;
+    static const int SAMPLE_SIZE = 44;
+
+    Recorder();
+
+    /**
+     * Creates the record file, must be called before start().
+     */
+    bool open(const char *path);
+
+    bool isRecording() const {
+        return recording;
+    }
+
+    void recordSample(const RawSample & sample);
+    void recordPacket(const void *data, int size);
+    void recordMotors(const float outputs[4]);
+    void recordCalibration(const GyroCalibration & calibration);
+
+    /**
+     * Decodes the payload of a SAMPLE record.
+     */
+    static bool decodeSample(const char *payload, int size, RawSample & sample);
+
+    // Thread entry point, do not call directly
+    void run();
+
+private:
+    static const unsigned int SIZE = 1 << 16;
+
+    int fd;
+    bool recording;
+    char ring[SIZE];
+    std::atomic<unsigned int> head;
+    std::atomic<unsigned int> tail;
+    std::atomic<unsigned int> dropped;
+
+    void append(uint8_t type, const void *payload, int size);
+    void copy(unsigned int position, const void *data, int size);
+};
+
+}
+}
+}
+
+#endif
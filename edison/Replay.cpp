@@ -0,0 +1,126 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Replay.h"
+#include "FlightService.h"
+#include <stdio.h>
+#include <string.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+Replay::Replay(FlightService *context) :
+    context(context)
+{
+}
+
+bool Replay::run(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        perror("Replay: Cannot open the record file");
+        return false;
+    }
+    char magic[4];
+    if (fread(magic, 1, 4, file) != 4 || memcmp(magic, "HDR2", 4)) {
+        fprintf(stderr, "Replay: %s is not a record file\n", path);
+        fclose(file);
+        return false;
+    }
+
+    unsigned int samples = 0, packets = 0, mismatches = 0;
+    bool valid = true;
+    Timestamp start = Timestamp::now();
+    while (true) {
+        char header[3];
+        size_t read = fread(header, 1, 3, file);
+        if (read == 0) {
+            break;
+        }
+        uint16_t size;
+        memcpy(&size, header + 1, 2);
+        char payload[Recorder::MAX_PAYLOAD];
+        if (read != 3 || size > sizeof(payload) || fread(payload, 1, size, file) != size) {
+            fprintf(stderr, "Replay: Truncated record file\n");
+            valid = false;
+            break;
+        }
+
+        switch (header[0]) {
+        case Recorder::PACKET:
+            context->receiver.dispatch(payload, size);
+            packets++;
+            break;
+        case Recorder::SAMPLE: {
+            RawSample sample;
+            if (!Recorder::decodeSample(payload, size, sample)) {
+                fprintf(stderr, "Replay: Invalid sample record\n");
+                valid = false;
+                break;
+            }
+            context->sensors.process(sample);
+            samples++;
+            break;
+        }
+        case Recorder::CALIBRATION: {
+            GyroCalibration calibration;
+            if (size != sizeof(calibration)) {
+                fprintf(stderr, "Replay: Invalid calibration record\n");
+                valid = false;
+                break;
+            }
+            memcpy(&calibration, payload, sizeof(calibration));
+            context->sensors.setCalibration(calibration);
+            break;
+        }
+        case Recorder::MOTORS: {
+            float outputs[4];
+            context->motors.getOutputs(outputs);
+            if (size != sizeof(outputs) || memcmp(outputs, payload, sizeof(outputs))) {
+                if (mismatches == 0) {
+                    float expected[4];
+                    memcpy(expected, payload, sizeof(expected));
+                    fprintf(stderr, "Replay: First mismatch at sample %u, %f %f %f %f instead of %f %f %f %f\n",
+                            samples, outputs[0], outputs[1], outputs[2], outputs[3],
+                            expected[0], expected[1], expected[2], expected[3]);
+                }
+                mismatches++;
+            }
+            break;
+        }
+        default:
+            fprintf(stderr, "Replay: Unknown record type %d\n", header[0]);
+            valid = false;
+            break;
+        }
+        if (!valid) {
+            break;
+        }
+    }
+    fclose(file);
+
+    float elapsed = Timestamp::now() - start;
+    fprintf(stderr, "Replay: %u samples, %u packets in %.3fs (%.0f samples/s), %u mismatches\n",
+            samples, packets, elapsed, samples / elapsed, mismatches);
+    return valid && mismatches == 0;
+}
+
+}
+}
+}
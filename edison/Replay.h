@@ -0,0 +1,58 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _REPLAY_H_
+#define _REPLAY_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+class FlightService;
+
+/**
+ * Replays a file written by the Recorder.
+ *
+ * <p>
+ * The recorded packets and samples are fed to the flight service in the
+ * recorded order, as fast as possible, with the recorded timestamps as the
+ * clock. The motors are not started, and the duty cycles computed for each
+ * sample are compared bit for bit with the recorded ones.
+ * </p>
+ */
+class Replay {
+
+public:
+    Replay(FlightService *context);
+
+    /**
+     * Replays a file.
+     *
+     * @return true if the file could be read and all the duty cycles match.
+     */
+    bool run(const char *path);
+
+private:
+    FlightService *context;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,259 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "Timestamp.h"
+#include <stdio.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Cooperative scheduler of tasks at integer divisors of a base tick.
+ *
+ * <p>
+ * A task is a method of the owner, run by tick() every divisor ticks. When a
+ * task is added, its phase is the one where the load of the tasks already
+ * added, weighted by their estimated costs, is the lowest, so that the heavy
+ * tasks of different rates never run at the same tick. The tasks of another
+ * scheduler ticked at the same rate can be given to the constructor, they
+ * are then taken into account as well. The first tick runs all the tasks, so
+ * that every value is available from the start.
+ * </p>
+ *
+ * <p>
+ * The time spent in each task is measured, and printed by report() with its
+ * share of the elapsed time. tick() and report() must be called by the same
+ * thread.
+ * </p>
+ *
+ * @param T
+ *            Owner type.
+ * @param N
+ *            Maximum number of tasks.
+ */
+template <class T, int N = 8>
+class Scheduler {
+
+public:
+    typedef void (T::*Method)();
+
+    /**
+     * Constructor.
+     *
+     * @param name
+     *            Name in the reports.
+     * @param shared
+     *            Scheduler ticked once per tick of this one, whose tasks must
+     *            be added first, or NULL.
+     */
+    Scheduler(T *owner, const char *name, const Scheduler *shared = NULL) :
+        owner(owner),
+        name(name),
+        shared(shared),
+        count(0),
+        ticks(0),
+        reported(Timestamp::now()) {
+    }
+
+    /**
+     * Adds a task, before the first tick.
+     *
+     * @param divisor
+     *            Number of ticks between two executions.
+     * @param cost
+     *            Estimated cost, relative to the other tasks.
+     * @return false if there are already N tasks.
+     */
+    bool add(const char *name, Method method, int divisor, float cost) {
+        if (count == N) {
+            return false;
+        }
+        Entry & e = tasks[count];
+        e.name = name;
+        e.method = method;
+        e.divisor = divisor;
+        e.phase = findPhase(divisor);
+        e.cost = cost;
+        e.time = 0.;
+        e.time_max = 0.;
+        e.runs = 0;
+        count++;
+        return true;
+    }
+
+    /**
+     * Runs the tasks which are due.
+     */
+    void tick() {
+        for (int i = 0; i < count; i++) {
+            Entry & e = tasks[i];
+            if (ticks != 0 && ticks % e.divisor != (unsigned int)e.phase) {
+                continue;
+            }
+            Timestamp start = Timestamp::now();
+            (owner->*e.method)();
+            float time = Timestamp::now() - start;
+            e.time += time;
+            if (time > e.time_max) {
+                e.time_max = time;
+            }
+            e.runs++;
+        }
+        ticks++;
+    }
+
+    /**
+     * Number of ticks of the hyperperiod at which several of the tasks which
+     * do not run at every tick run, with those of the shared scheduler: 0
+     * when their phases are disjoint.
+     */
+    int getCollisions() const {
+        int hyperperiod = getHyperperiod(1);
+        int collisions = 0;
+        for (int tick = 0; tick < hyperperiod; tick++) {
+            if (runs(tick) + (shared ? shared->runs(tick) : 0) > 1) {
+                collisions++;
+            }
+        }
+        return collisions;
+    }
+
+    /**
+     * Prints the time spent in each task since the last report.
+     */
+    void report() {
+        Timestamp now = Timestamp::now();
+        float elapsed = now - reported;
+        fprintf(stderr, "Scheduler: %s", name);
+        for (int i = 0; i < count; i++) {
+            Entry & e = tasks[i];
+            fprintf(stderr, ", %s 1/%d+%d avg %.0fus max %.0fus %.1f%%",
+                    e.name, e.divisor, e.phase,
+                    e.runs ? e.time / e.runs * 1.e6 : 0.,
+                    e.time_max * 1.e6,
+                    elapsed > 0. ? e.time / elapsed * 100. : 0.);
+            e.time = 0.;
+            e.time_max = 0.;
+            e.runs = 0;
+        }
+        fprintf(stderr, "\n");
+        reported = now;
+    }
+
+private:
+    // Longest period over which the phases are compared, in ticks
+    static const int MAX_HYPERPERIOD = 1 << 16;
+
+    struct Entry {
+        const char *name;
+        Method method;
+        int divisor;
+        int phase;
+        float cost;
+        float time; // Since the last report, in seconds
+        float time_max;
+        unsigned int runs;
+    };
+
+    T *owner;
+    const char *name;
+    const Scheduler *shared;
+    Entry tasks[N];
+    int count;
+    unsigned int ticks;
+    Timestamp reported;
+
+    static int gcd(int a, int b) {
+        while (b) {
+            int t = a % b;
+            a = b;
+            b = t;
+        }
+        return a;
+    }
+
+    // Load of the tasks which do not run at every tick
+    float load(int tick) const {
+        float sum = 0.;
+        for (int i = 0; i < count; i++) {
+            if (tasks[i].divisor > 1 && tick % tasks[i].divisor == tasks[i].phase) {
+                sum += tasks[i].cost;
+            }
+        }
+        return sum;
+    }
+
+    // Number of the tasks which do not run at every tick, run at a tick
+    int runs(int tick) const {
+        int n = 0;
+        for (int i = 0; i < count; i++) {
+            if (tasks[i].divisor > 1 && tick % tasks[i].divisor == tasks[i].phase) {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    // Least common multiple of a divisor and of those of the tasks, with the
+    // shared scheduler, bounded by MAX_HYPERPERIOD
+    int getHyperperiod(int divisor) const {
+        int hyperperiod = divisor;
+        for (int s = 0; s < 2; s++) {
+            const Scheduler *scheduler = s ? shared : this;
+            for (int i = 0; scheduler && i < scheduler->count; i++) {
+                int d = scheduler->tasks[i].divisor;
+                if (hyperperiod / gcd(hyperperiod, d) > MAX_HYPERPERIOD / d) {
+                    return hyperperiod;
+                }
+                hyperperiod = hyperperiod / gcd(hyperperiod, d) * d;
+            }
+        }
+        return hyperperiod;
+    }
+
+    // Phase minimizing the highest load of the ticks the task would run at
+    int findPhase(int divisor) const {
+        int hyperperiod = getHyperperiod(divisor);
+        int best = 0;
+        float best_load = 0.;
+        for (int phase = 0; phase < divisor; phase++) {
+            float highest = 0.;
+            for (int tick = phase; tick < hyperperiod; tick += divisor) {
+                float l = load(tick) + (shared ? shared->load(tick) : 0.f);
+                if (l > highest) {
+                    highest = l;
+                }
+            }
+            if (phase == 0 || highest < best_load) {
+                best = phase;
+                best_load = highest;
+            }
+        }
+        return best;
+    }
+};
+
+}
+}
+}
+
+#endif
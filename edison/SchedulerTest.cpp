@@ -0,0 +1,108 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SchedulerTest.h"
+#include "Scheduler.h"
+#include "FlightService.h"
+#include "SimulatedVehicle.h"
+#include <stdio.h>
+
+// Divisors of the tasks of Sensors
+#define MAG_DIVISOR 8
+#define TEMPERATURE_DIVISOR 400
+#define TELEMETRY_DIVISOR 4
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Owner of the tasks, which counts their runs
+class Tasks {
+public:
+    enum {
+        GYRO,
+        MAG,
+        TEMPERATURE,
+        TELEMETRY,
+        TASKS
+    };
+
+    int runs[TASKS];
+    // Periodic tasks run at the current tick
+    int periodic;
+
+    Tasks() {
+        clear();
+    }
+
+    void clear() {
+        for (int i = 0; i < TASKS; i++) {
+            runs[i] = 0;
+        }
+        periodic = 0;
+    }
+
+    void gyro() { runs[GYRO]++; }
+    void mag() { runs[MAG]++; periodic++; }
+    void temperature() { runs[TEMPERATURE]++; periodic++; }
+    void telemetry() { runs[TELEMETRY]++; periodic++; }
+};
+
+bool SchedulerTest::run(int ticks)
+{
+    Tasks tasks;
+    Scheduler<Tasks> acquisition(&tasks, "acquisition");
+    Scheduler<Tasks> fusion(&tasks, "fusion", &acquisition);
+    acquisition.add("gyro", &Tasks::gyro, 1, 1.f);
+    acquisition.add("mag", &Tasks::mag, MAG_DIVISOR, 1.f);
+    acquisition.add("temperature", &Tasks::temperature, TEMPERATURE_DIVISOR, 1.f);
+    fusion.add("telemetry", &Tasks::telemetry, TELEMETRY_DIVISOR, 1.f);
+
+    // The first tick runs all the tasks, the ticks after it are counted
+    acquisition.tick();
+    fusion.tick();
+    tasks.clear();
+    int collisions = 0;
+    for (int i = 0; i < ticks; i++) {
+        tasks.periodic = 0;
+        acquisition.tick();
+        fusion.tick();
+        if (tasks.periodic > 1) {
+            collisions++;
+        }
+    }
+    bool rates = tasks.runs[Tasks::GYRO] == ticks
+            && tasks.runs[Tasks::MAG] == ticks / MAG_DIVISOR
+            && tasks.runs[Tasks::TEMPERATURE] == ticks / TEMPERATURE_DIVISOR
+            && tasks.runs[Tasks::TELEMETRY] == ticks / TELEMETRY_DIVISOR;
+
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    SimulatedVehicle vehicle(parameters, 1);
+    FlightService service(&vehicle);
+    int sensors_collisions = service.sensors.getScheduleCollisions();
+
+    fprintf(stderr, "SchedulerTest: %d ticks, runs gyro %d mag %d temperature %d telemetry %d, %d collisions, %d in Sensors\n",
+            ticks, tasks.runs[Tasks::GYRO], tasks.runs[Tasks::MAG], tasks.runs[Tasks::TEMPERATURE],
+            tasks.runs[Tasks::TELEMETRY], collisions, sensors_collisions);
+    return rates && collisions == 0 && fusion.getCollisions() == 0 && sensors_collisions == 0;
+}
+
+}
+}
+}
@@ -0,0 +1,52 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SCHEDULERTEST_H_
+#define _SCHEDULERTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the phases of Scheduler.
+ *
+ * <p>
+ * Two schedulers, the second one sharing the ticks of the first one, are
+ * given the periodic tasks of Sensors, and ticked: each task must run at
+ * its rate, and no two periodic tasks at the same tick after the first one.
+ * The schedule of Sensors itself must have no collision either.
+ * </p>
+ */
+class SchedulerTest {
+public:
+    /**
+     * Ticks the schedulers the given number of times after the first tick, a
+     * multiple of the divisors.
+     *
+     * @return false if a task runs at a wrong rate, or if two periodic tasks
+     *         run at the same tick.
+     */
+    static bool run(int ticks);
+};
+
+}
+}
+}
+
+#endif
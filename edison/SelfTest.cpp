@@ -0,0 +1,91 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SelfTest.h"
+#include "AllocationTest.h"
+#include "BiquadTest.h"
+#include "EscTest.h"
+#include "FilterBenchmark.h"
+#include "GainScheduleTest.h"
+#include "LinkAdaptationTest.h"
+#include "MathTest.h"
+#include "PwmTest.h"
+#include "SchedulerTest.h"
+#include "SnapshotTest.h"
+#include "TelemetryTest.h"
+#include <stdio.h>
+
+// Commands sent with each ESC protocol
+#define ESC_TEST_COMMANDS 2000
+
+// Ticks driven on the fake PWM chip
+#define PWM_TEST_TICKS 2000
+
+// Inputs of each approximation of FastMath.h
+#define MATH_TEST_SAMPLES 4000000
+
+// Samples compared by the fixed-point filter test
+#define FILTER_TEST_SAMPLES 24000
+
+// Throttles swept over each gain schedule
+#define GAIN_SCHEDULE_TEST_SAMPLES 10000
+
+// Values held by each reader of the snapshot test
+#define SNAPSHOT_TEST_HOLDS 5
+
+// Ticks of the telemetry packing test
+#define TELEMETRY_TEST_TICKS 1000
+
+// Samples flown with the allocation tracker armed
+#define ALLOCATION_TEST_SAMPLES 4000
+
+// Ticks of the scheduler test, a multiple of the divisors of Sensors
+#define SCHEDULER_TEST_TICKS 4000
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+// Result of one check
+static int check(const char *name, bool passed)
+{
+    fprintf(stderr, "SelfTest: %s %s\n", name, passed ? "passed" : "FAILED");
+    return passed ? 0 : 1;
+}
+
+bool SelfTest::run()
+{
+    int failures = 0;
+    failures += check("ESC protocols", EscTest::run(ESC_TEST_COMMANDS));
+    failures += check("PWM outputs", PwmTest::run(PWM_TEST_TICKS));
+    failures += check("Approximations", MathTest::run(MATH_TEST_SAMPLES));
+    failures += check("Gyroscope filters", BiquadTest::run());
+    failures += check("Fixed-point filters", FilterBenchmark::run(FILTER_TEST_SAMPLES));
+    failures += check("Gain schedules", GainScheduleTest::run(GAIN_SCHEDULE_TEST_SAMPLES));
+    failures += check("Snapshots", SnapshotTest::run(SNAPSHOT_TEST_HOLDS));
+    failures += check("Telemetry packing", TelemetryTest::run(TELEMETRY_TEST_TICKS));
+    failures += check("Heap allocations", AllocationTest::run(ALLOCATION_TEST_SAMPLES));
+    failures += check("Task phases", SchedulerTest::run(SCHEDULER_TEST_TICKS));
+    failures += check("Link adaptation", LinkAdaptationTest::run());
+    fprintf(stderr, "SelfTest: %d failure(s)\n", failures);
+    return !failures;
+}
+
+}
+}
+}
@@ -0,0 +1,49 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SELFTEST_H_
+#define _SELFTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Checks of the flight software which need no hardware.
+ *
+ * <p>
+ * Each check runs against simulated vehicles or synthetic samples, prints its
+ * measurements, and compares them with the bounds documented by the code it
+ * covers. All the checks are run, even after a failure.
+ * </p>
+ */
+class SelfTest {
+public:
+    /**
+     * Runs all the checks.
+     *
+     * @return false if any check failed.
+     */
+    static bool run();
+};
+
+}
+}
+}
+
+#endif
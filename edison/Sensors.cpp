@@ -18,11 +18,12 @@
 
 #include "Sensors.h"
 #include "FlightService.h"
+#include "FastMath.h"
+#include "AllocationTracker.h"
 #include <math.h>
-
-// SDO_XM and SDO_G are both grounded, so our addresses are:
-#define LSM9DS0_XM  0x1D // Would be 0x1E if SDO_XM is LOW
-#define LSM9DS0_G   0x6B // Would be 0x6A if SDO_G is LOW
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #define FRONT_LEFT_SWITCH_PIN 0 // TODO
 #define FRONT_RIGHT_SWITCH_PIN 0 // TODO
@@ -30,15 +31,63 @@
 #define BACK_LEFT_SWITCH_PIN 0 // TODO
 
 #define DEG_TO_RAD 0.017453292519943295769236907684886
+#define G_TO_MS2 9.80665f
+
+// Largest standard deviations of a still window, in degrees per second and g
+#define STILL_GYRO_DEVIATION .5f
+#define STILL_ACCEL_DEVIATION .02f
+
+// Largest difference between a still window and the current biases, in
+// degrees per second, a larger one is a slow rotation
+#define MAX_BIAS_CHANGE 3.f
+
+// Largest difference between the norm of the acceleration of a still window
+// and 1g, in g
+#define STILL_ACCEL_NORM_ERROR .05f
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+// Conversions of the raw values, at the full scales of RawSample
+static inline float calcGyro(float gyro)
+{
+    return RawSample::GYRO_RESOLUTION * gyro;
+}
+
+static inline float calcAccel(int32_t accel)
+{
+    return RawSample::ACCEL_RESOLUTION * accel;
+}
+
+static inline float calcMag(int32_t mag)
+{
+    return RawSample::MAG_RESOLUTION * mag;
+}
+
+static inline float calcTemperature(int16_t temp)
+{
+    return RawSample::TEMPERATURE_OFFSET + RawSample::TEMPERATURE_RESOLUTION * temp;
+}
+
+// Time between two samples in nanoseconds, 0 for the first one, at most a second
+static inline int64_t elapsedNs(const Timestamp & now, const Timestamp & previous)
+{
+    if (!previous.t.tv_sec && !previous.t.tv_nsec) {
+        return 0;
+    }
+    int64_t ns = (int64_t)(now.t.tv_sec - previous.t.tv_sec) * 1000000000 + (now.t.tv_nsec - previous.t.tv_nsec);
+    return ns < 1000000000 ? ns : 1000000000;
+}
+
 Sensors::Sensors(FlightService *context) :
+    hal(context->hal),
     controller(&context->controller),
     telemetry(&context->telemetry),
-    dof(LSM9DS0_G, LSM9DS0_XM),
+    receiver(&context->receiver),
+    recorder(&context->recorder),
+    motors(&context->motors),
+    calibration(&context->calibration),
     gyro_roll_bias(0.),
     gyro_roll_gain(1.),
     accel_roll_bias(0.),
@@ -46,74 +95,350 @@ Sensors::Sensors(FlightService *context) :
     gyro_pitch_gain(1.),
     accel_pitch_bias(0.),
     gyro_yaw_bias(0.),
-    apply_modulo(false)
+    orientation(getOrientation(CommandPacket::SensorsConfig::YAW_180)),
+    dynamic_notch(-1),
+    dynamic_notch_q(3.),
+    estimator(CommandPacket::SensorsConfig::COMPLEMENTARY),
+    mag_weight(0.),
+    read_mag(false),
+    ekf_altitude(false),
+    refine_calibration(false),
+    temperature(NAN),
+    calibrated(false),
+    motors_started(false),
+    window_count(0),
+    window_stopped(false),
+    attitude(),
+    switches(),
+    apply_modulo(false),
+    settings_version(0),
+    reset_requested(false),
+    acquisition_tasks(this, "acquisition"),
+    fusion_tasks(this, "fusion", &acquisition_tasks),
+    acquired(),
+    pipelined(false),
+    acquisition(this),
+    samples_dropped(0),
+    latency_sum(0.),
+    latency_max(0.),
+    latency_count(0)
 {
+    memset(&gyro_calibration, 0, sizeof(gyro_calibration));
+    memset(calibrated_bias, 0, sizeof(calibrated_bias));
+    memset(body_bias, 0, sizeof(body_bias));
+    memset(rate_bias, 0, sizeof(rate_bias));
+    acquisition_tasks.add("accel", &Sensors::readAccel, 1, 1.f);
+    acquisition_tasks.add("gyro", &Sensors::readGyro, 1, 1.f);
+    acquisition_tasks.add("mag", &Sensors::readMag, MAG_DIVISOR, 1.f);
+    acquisition_tasks.add("temperature", &Sensors::readTemperature, TEMPERATURE_DIVISOR, 1.f);
+    fusion_tasks.add("telemetry", &Sensors::publishTelemetry, TELEMETRY_DIVISOR, 1.f);
+    sem_init(&samples_available, 0, 0);
     //pinMode(FRONT_LEFT_SWITCH_PIN, INPUT_PULLUP);
     //pinMode(FRONT_RIGHT_SWITCH_PIN, INPUT_PULLUP);
     //pinMode(BACK_RIGHT_SWITCH_PIN, INPUT_PULLUP);
     //pinMode(BACK_LEFT_SWITCH_PIN, INPUT_PULLUP);
 }
 
+bool Sensors::loadSettings(const CommandPacket::SensorsConfig &config, SensorsSettings &s)
+{
+    // Clear the padding, so that an unchanged configuration is not published
+    memset(&s, 0, sizeof(s));
+
+    s.accel_lowpass_constant = config.accel_lowpass_constant();
+    s.gyro_roll_bias = config.gyro_roll_bias();
+    s.gyro_roll_gain = config.gyro_roll_gain();
+    s.accel_roll_bias = config.accel_roll_bias();
+    s.gyro_pitch_bias = config.gyro_pitch_bias();
+    s.gyro_pitch_gain = config.gyro_pitch_gain();
+    s.accel_pitch_bias = config.accel_pitch_bias();
+    s.gyro_yaw_bias = config.gyro_yaw_bias();
+    s.apply_modulo = config.apply_modulo();
+    s.estimator = config.estimator();
+    s.mahony_kp = config.mahony_kp();
+    s.mahony_ki = config.mahony_ki();
+    s.use_magnetometer = config.use_magnetometer();
+    s.ekf_gyro_noise = config.ekf_gyro_noise();
+    s.ekf_bias_noise = config.ekf_bias_noise();
+    s.ekf_angle_noise = config.ekf_angle_noise();
+    s.ekf_accel_noise = config.ekf_accel_noise();
+    s.ekf_vertical_time_constant = config.ekf_vertical_time_constant();
+    s.ekf_altitude = config.ekf_altitude();
+    s.gyro_sample_rate = config.gyro_sample_rate();
+    s.dynamic_notch = config.dynamic_notch();
+    s.dynamic_notch_min = config.dynamic_notch_min();
+    s.dynamic_notch_max = config.dynamic_notch_max();
+    s.dynamic_notch_q = config.dynamic_notch_q();
+    s.orientation = config.orientation();
+
+    const float values[] = {
+        s.accel_lowpass_constant, s.gyro_roll_bias, s.gyro_roll_gain, s.accel_roll_bias,
+        s.gyro_pitch_bias, s.gyro_pitch_gain, s.accel_pitch_bias, s.gyro_yaw_bias,
+        s.mahony_kp, s.mahony_ki, s.ekf_gyro_noise, s.ekf_bias_noise, s.ekf_angle_noise,
+        s.ekf_accel_noise, s.ekf_vertical_time_constant
+    };
+    for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+        if (!isfinite(values[i])) {
+            fprintf(stderr, "Sensors: Invalid configuration value\n");
+            return false;
+        }
+    }
+    if (s.accel_lowpass_constant < 0. || s.mahony_kp < 0. || s.mahony_ki < 0.) {
+        fprintf(stderr, "Sensors: Invalid filter constants\n");
+        return false;
+    }
+    if (!getOrientation(s.orientation)) {
+        fprintf(stderr, "Sensors: Unknown orientation\n");
+        return false;
+    }
+    if (!(s.gyro_sample_rate > 0.)) {
+        fprintf(stderr, "Sensors: Invalid gyroscope sample rate\n");
+        return false;
+    }
+
+    // One section is kept for the dynamic notch
+    int max_filters = BiquadBank::MAX_SECTIONS - (s.dynamic_notch ? 1 : 0);
+    if (config.gyro_filters_size() > max_filters) {
+        fprintf(stderr, "Sensors: Too many gyroscope filters, %d max\n", max_filters);
+        return false;
+    }
+    s.filter_count = config.gyro_filters_size();
+    for (int i = 0; i < s.filter_count; i++) {
+        const CommandPacket::SensorsConfig::Filter & f = config.gyro_filters(i);
+        s.filters[i].notch = f.type() == CommandPacket::SensorsConfig::Filter::NOTCH;
+        s.filters[i].frequency = f.frequency();
+        s.filters[i].q = f.q();
+        if (!(f.frequency() > 0.) || !(f.frequency() < s.gyro_sample_rate / 2.) || !(f.q() > 0.)) {
+            fprintf(stderr, "Sensors: Invalid gyroscope filter %d\n", i);
+            return false;
+        }
+    }
+    if (s.dynamic_notch && (!(s.dynamic_notch_min > 0.) || !(s.dynamic_notch_max > s.dynamic_notch_min) ||
+                            !(s.dynamic_notch_max < s.gyro_sample_rate / 2.) || !(s.dynamic_notch_q > 0.))) {
+        fprintf(stderr, "Sensors: Invalid dynamic notch range\n");
+        return false;
+    }
+    return true;
+}
+
 void Sensors::setConfig(const CommandPacket::SensorsConfig &config)
 {
-    synchronized
-    float T = config.accel_lowpass_constant();
-    roll_accel_lowpass.setT(T);
-    roll_gyro_highpass.setT(T);
-    pitch_accel_lowpass.setT(T);
-    pitch_gyro_highpass.setT(T);
-    gyro_roll_bias = config.gyro_roll_bias();
-    gyro_roll_gain = config.gyro_roll_gain();
-    accel_roll_bias = config.accel_roll_bias();
-    gyro_pitch_bias = config.gyro_pitch_bias();
-    gyro_pitch_gain = config.gyro_pitch_gain();
-    accel_pitch_bias = config.accel_pitch_bias();
-    gyro_yaw_bias = config.gyro_yaw_bias();
-    apply_modulo = config.apply_modulo();
+    SensorsSettings s;
+    if (loadSettings(config, s)) {
+        settings.publish(s);
+    } else {
+        fprintf(stderr, "Sensors: Configuration ignored\n");
+    }
 }
 
-void Sensors::run()
+void Sensors::applySettings(const SensorsSettings &config)
 {
-    fprintf(stderr, "Sensors: Thread started\n");
-    dof.begin();
-    while(true) {
-        synchronized
-
-        // Read switches
-        //switches.set_front_left(digitalRead(FRONT_LEFT_SWITCH_PIN));
-        //switches.set_front_right(digitalRead(FRONT_RIGHT_SWITCH_PIN));
-        //switches.set_back_right(digitalRead(BACK_RIGHT_SWITCH_PIN));
-        //switches.set_back_left(digitalRead(BACK_LEFT_SWITCH_PIN));
-
-        // Read Acceleration
-        dof.readAccel();
-        Timestamp now = Timestamp::now();
-        roll_accel.set(atan2f(dof.calcAccel(dof.ay), dof.calcAccel(-dof.az)), now);
-        roll_accel.value -= accel_roll_bias;
-        pitch_accel.set(atan2f(dof.calcAccel(-dof.ax), dof.calcAccel(-dof.az)), now);
-        pitch_accel.value -= accel_pitch_bias;
-
-        // Read Gyroscope
-        dof.readGyro();
-        now = Timestamp::now();
-
-        roll_gyro_rate.set(-dof.calcGyro(dof.gx) * DEG_TO_RAD, now);
-        roll_gyro_rate.value = (roll_gyro_rate.value - gyro_roll_bias) * gyro_roll_gain;
-        roll_gyro.integrate(roll_gyro_rate);
-
-        pitch_gyro_rate.set(dof.calcGyro(-dof.gy) * DEG_TO_RAD, now);
-        pitch_gyro_rate.value = (pitch_gyro_rate.value - gyro_pitch_bias) * gyro_pitch_gain;
-        pitch_gyro.integrate(pitch_gyro_rate);
-
-        // Apply the low-pass filter on the accelerometer and the
-        // high-pass filter on the gyroscope
-        roll_accel_lowpass.lowpass(roll_accel);
-        roll_gyro_highpass.highpass(roll_gyro);
-        roll.add(roll_gyro_highpass, roll_accel_lowpass);
-
-        pitch_accel_lowpass.lowpass(pitch_accel);
-        pitch_gyro_highpass.highpass(pitch_gyro);
-        pitch.add(pitch_gyro_highpass, pitch_accel_lowpass);
+    float T = config.accel_lowpass_constant;
+    roll_filter.setConfig(T, config.gyro_roll_bias, config.gyro_roll_gain, config.accel_roll_bias);
+    pitch_filter.setConfig(T, config.gyro_pitch_bias, config.gyro_pitch_gain, config.accel_pitch_bias);
+    gyro_roll_bias = config.gyro_roll_bias;
+    gyro_roll_gain = config.gyro_roll_gain;
+    accel_roll_bias = config.accel_roll_bias;
+    gyro_pitch_bias = config.gyro_pitch_bias;
+    gyro_pitch_gain = config.gyro_pitch_gain;
+    accel_pitch_bias = config.accel_pitch_bias;
+    gyro_yaw_bias = config.gyro_yaw_bias;
+    applyGyroBiases();
+    apply_modulo = config.apply_modulo;
+    CommandPacket::SensorsConfig::Estimator new_estimator = (CommandPacket::SensorsConfig::Estimator)config.estimator;
+    if (estimator != new_estimator) {
+        mahony.reset();
+        ekf.reset();
+    }
+    estimator = new_estimator;
+    mahony.setGains(config.mahony_kp, config.mahony_ki);
+    mag_weight = config.use_magnetometer ? 1. : 0.;
+    ekf.setNoise(config.ekf_gyro_noise, config.ekf_bias_noise, config.ekf_angle_noise,
+                 config.ekf_accel_noise, config.ekf_vertical_time_constant);
+    ekf_altitude = config.ekf_altitude;
+
+    gyro_filters.clear();
+    gyro_filters.setSampleRate(config.gyro_sample_rate);
+    for (int i = 0; i < config.filter_count; i++) {
+        if (config.filters[i].notch) {
+            gyro_filters.addNotch(config.filters[i].frequency, config.filters[i].q);
+        } else {
+            gyro_filters.addLowPass(config.filters[i].frequency, config.filters[i].q);
+        }
+    }
+    dynamic_notch = -1;
+    if (config.dynamic_notch) {
+        spectrum.setRange(config.gyro_sample_rate, config.dynamic_notch_min, config.dynamic_notch_max);
+        dynamic_notch_q = config.dynamic_notch_q;
+        const float peaks[BiquadBank::LANES] = {
+            spectrum.getPeak(0), spectrum.getPeak(1), spectrum.getPeak(2), spectrum.getPeak(0)
+        };
+        dynamic_notch = gyro_filters.addNotch(peaks, dynamic_notch_q);
+    }
+    read_mag = (estimator == CommandPacket::SensorsConfig::MAHONY) && config.use_magnetometer;
+
+    const OrientationFunctions *new_orientation = getOrientation(config.orientation);
+    if (orientation != new_orientation) {
+        orientation = new_orientation;
+        roll_filter.reset();
+        pitch_filter.reset();
+        mahony.reset();
+        ekf.reset();
+        if (!isnan(temperature)) {
+            applyCalibration();
+        }
+    }
+}
+
+void Sensors::setPipelined(bool pipelined)
+{
+    this->pipelined = pipelined;
+}
+
+void Sensors::acquire(RawSample &sample)
+{
+    acquired.temp = RawSample::NO_TEMPERATURE;
+    acquisition_tasks.tick();
+    sample = acquired;
+}
+
+void Sensors::readAccel()
+{
+    hal->readAccel(acquired);
+}
+
+void Sensors::readGyro()
+{
+    hal->readGyro(acquired);
+}
+
+void Sensors::readMag()
+{
+    if (read_mag) {
+        hal->readMag(acquired);
+    } else {
+        acquired.mx = acquired.my = acquired.mz = 0;
+    }
+}
+
+void Sensors::readTemperature()
+{
+    hal->readTemperature(acquired);
+}
+
+void Sensors::step()
+{
+    RawSample sample;
+    acquire(sample);
+    process(sample);
+}
+
+void Sensors::process(const RawSample &sample)
+{
+    // Apply the commands received since the last sample
+    receiver->dispatchPending();
+    if (recorder->isRecording()) {
+        recorder->recordSample(sample);
+    }
+
+    // Apply the new configuration
+    unsigned int version = settings.getVersion();
+    if (version != settings_version) {
+        settings_version = version;
+        applySettings(*settings.get());
+    }
+    if (reset_requested.exchange(false)) {
+        roll_filter.reset();
+        pitch_filter.reset();
+        mahony.reset();
+        ekf.reset();
+    }
+
+    // Read switches
+    //switches.front_left = digitalRead(FRONT_LEFT_SWITCH_PIN);
+    //switches.front_right = digitalRead(FRONT_RIGHT_SWITCH_PIN);
+    //switches.back_right = digitalRead(BACK_RIGHT_SWITCH_PIN);
+    //switches.back_left = digitalRead(BACK_LEFT_SWITCH_PIN);
+
+    // Biases of the calibration at the new temperature
+    if (sample.temp != RawSample::NO_TEMPERATURE) {
+        temperature = calcTemperature(sample.temp);
+        applyCalibration();
+    }
+
+    // Raw values in the body axes, the accelerometer measures the specific
+    // force
+    BodySample body;
+    orientation->remap(sample, body);
+
+    // Complementary filter, the accelerometer angles are atan2(-ay, -az) and
+    // atan2(ax, -az) in the body axes
+    int64_t dt_ns = elapsedNs(sample.gyro_timestamp, filter_timestamp);
+    filter_timestamp = sample.gyro_timestamp;
+    roll_filter.update(body.gyro[0], -body.accel[1], -body.accel[2], dt_ns);
+    pitch_filter.update(body.gyro[1], body.accel[0], -body.accel[2], dt_ns);
+
+    // Gyroscope, corrected by the calibration or by the configured biases
+    Timestamp now = sample.gyro_timestamp;
+
+    BiquadBank::Vector rates = {
+        (calcGyro(body.gyro[0] - body_bias[0]) * (float)DEG_TO_RAD - rate_bias[0]) * gyro_roll_gain,
+        (calcGyro(body.gyro[1] - body_bias[1]) * (float)DEG_TO_RAD - rate_bias[1]) * gyro_pitch_gain,
+        calcGyro(body.gyro[2] - body_bias[2]) * (float)DEG_TO_RAD - rate_bias[2],
+        0.f
+    };
+
+    // Track the vibrations on the unfiltered rates, a small part of the
+    // analysis is done at each sample
+    if (dynamic_notch != -1) {
+        float unfiltered[SpectrumAnalyzer::AXES] = { rates[0], rates[1], rates[2] };
+        spectrum.push(unfiltered);
+        int axis = spectrum.step();
+        if (axis != -1) {
+            float peak = spectrum.getPeak(axis);
+            gyro_filters.setNotch(dynamic_notch, axis, peak, dynamic_notch_q);
+            float peaks[SpectrumAnalyzer::AXES];
+            for (int i = 0; i < SpectrumAnalyzer::AXES; i++) {
+                peaks[i] = spectrum.getPeak(i);
+            }
+            telemetry->setVibration(peaks);
+        }
+    }
+    gyro_filters.filter(rates);
+
+    roll_gyro_rate.set(rates[0], now);
+    pitch_gyro_rate.set(rates[1], now);
+
+    yaw_rate.set(rates[2], now);
+
+    if (estimator == CommandPacket::SensorsConfig::MAHONY) {
+        // The filter expects the gravity, the opposite of the specific force
+        mahony.update(roll_gyro_rate.value, pitch_gyro_rate.value, yaw_rate.value,
+                      calcAccel(-body.accel[0]), calcAccel(-body.accel[1]), calcAccel(-body.accel[2]),
+                      calcMag(body.mag[0]), calcMag(body.mag[1]), calcMag(body.mag[2]),
+                      mag_weight, now - mahony_timestamp);
+        mahony_timestamp = now;
+        float r, p, y;
+        mahony.getEuler(r, p, y);
+        roll.set(r - accel_roll_bias, now);
+        pitch.set(p - accel_pitch_bias, now);
+        yaw.set(y, now);
+    } else if (estimator == CommandPacket::SensorsConfig::EKF) {
+        // Specific force in the body frame
+        float fx = calcAccel(body.accel[0]) * G_TO_MS2;
+        float fy = calcAccel(body.accel[1]) * G_TO_MS2;
+        float fz = calcAccel(body.accel[2]) * G_TO_MS2;
+        ekf.predict(roll_gyro_rate.value, pitch_gyro_rate.value, yaw_rate.value,
+                    fx, fy, fz, now - ekf_timestamp);
+        ekf_timestamp = now;
+        ekf.updateGravity(fx, fy, fz);
+        roll.set(ekf.get(AttitudeEkf::ROLL) - accel_roll_bias, now);
+        pitch.set(ekf.get(AttitudeEkf::PITCH) - accel_pitch_bias, now);
+        if (ekf_altitude) {
+            altitude.set(ekf.get(AttitudeEkf::ALTITUDE), now);
+        }
+    } else {
+        roll.set(roll_filter.getAngle(), now);
+        pitch.set(pitch_filter.getAngle(), now);
 
         // Limit the angles between -PI and PI
         if (apply_modulo) {
@@ -130,28 +455,241 @@ void Sensors::run()
                 pitch.value += M_PI*2;
             }
         }
+    }
+
+    attitude.altitude = altitude.value;
+    attitude.roll = roll.value;
+    attitude.pitch = pitch.value;
+    attitude.roll_rate = roll_gyro_rate.value;
+    attitude.pitch_rate = pitch_gyro_rate.value;
+    attitude.has_yaw = estimator == CommandPacket::SensorsConfig::MAHONY;
+    attitude.yaw = yaw.value;
+    attitude.yaw_rate = yaw_rate.value;
+    attitude.timestamp = now;
+
+    controller->setAttitude(attitude, now);
+    if (recorder->isRecording()) {
+        float outputs[4];
+        motors->getOutputs(outputs);
+        recorder->recordMotors(outputs);
+    }
+    fusion_tasks.tick();
+
+    // After the motors update, the replay applies the same calibration to
+    // the same samples
+    if (refine_calibration) {
+        refineCalibration(sample);
+    }
+}
+
+void Sensors::publishTelemetry()
+{
+    telemetry->setAttitude(attitude);
+    telemetry->setSwitches(switches);
+}
+
+void Sensors::setCalibration(const GyroCalibration &calibration)
+{
+    gyro_calibration = calibration;
+    refine_calibration = true;
+    window_count = 0;
+    if (!isnan(temperature)) {
+        applyCalibration();
+    }
+}
+
+void Sensors::applyCalibration()
+{
+    calibrated = Calibration::getBias(gyro_calibration, temperature, calibrated_bias);
+    orientation->rotate(calibrated_bias, body_bias);
+    roll_filter.setCalibration(body_bias[0]);
+    pitch_filter.setCalibration(body_bias[1]);
+    applyGyroBiases();
+}
+
+void Sensors::applyGyroBiases()
+{
+    // The calibration measures the whole bias of the gyroscope, the
+    // configured biases only correct a vehicle which has none
+    rate_bias[0] = calibrated ? 0.f : gyro_roll_bias;
+    rate_bias[1] = calibrated ? 0.f : gyro_pitch_bias;
+    rate_bias[2] = calibrated ? 0.f : gyro_yaw_bias;
+    roll_filter.setGyroBias(rate_bias[0]);
+    pitch_filter.setGyroBias(rate_bias[1]);
+}
 
-        yaw_rate.set(dof.calcGyro(dof.gz) * DEG_TO_RAD, now);
-        yaw_rate.value -= gyro_yaw_bias;
+void Sensors::refineCalibration(const RawSample &sample)
+{
+    // The vibrations of running motors would be averaged in the biases
+    bool stopped = motors->isStopped();
+    motors_started = motors_started || !stopped;
 
-        attitude.set_altitude(altitude.value);
-        attitude.set_roll(roll.value);
-        attitude.set_pitch(pitch.value);
-        attitude.set_yaw_rate(yaw_rate.value);
-        attitude.set_timestamp(now);
+    const int16_t values[6] = { sample.gx, sample.gy, sample.gz, sample.ax, sample.ay, sample.az };
+    if (window_count == 0) {
+        for (int i = 0; i < 6; i++) {
+            window_sum[i] = 0.;
+            window_squares[i] = 0.;
+        }
+        window_stopped = true;
+    }
+    for (int i = 0; i < 6; i++) {
+        window_sum[i] += values[i];
+        window_squares[i] += (double)values[i] * values[i];
+    }
+    window_stopped = window_stopped && stopped;
+    if (++window_count < CALIBRATION_WINDOW || isnan(temperature)) {
+        return;
+    }
+    window_count = 0;
+    if (!window_stopped) {
+        return;
+    }
 
-        controller->setAttitude(attitude, now);
-        telemetry->setAttitude(attitude);
-        telemetry->setSwitches(switches);
+    // Without biases to compare with, a slow rotation cannot be told from a
+    // bias: the first biases are only learned before the first flight
+    if (!calibrated && motors_started) {
+        return;
+    }
 
+    // The motors vibrations and the moves are seen by both sensors
+    float mean[6];
+    for (int i = 0; i < 6; i++) {
+        mean[i] = window_sum[i] / CALIBRATION_WINDOW;
+        float deviation = sqrt(fmax(window_squares[i] / CALIBRATION_WINDOW - (double)mean[i] * mean[i], 0.));
+        float limit = i < 3 ? STILL_GYRO_DEVIATION / RawSample::GYRO_RESOLUTION
+                            : STILL_ACCEL_DEVIATION / RawSample::ACCEL_RESOLUTION;
+        if (deviation > limit) {
+            return;
+        }
+    }
+
+    // A still vehicle only measures the gravity
+    float accel_norm = sqrtf(mean[3] * mean[3] + mean[4] * mean[4] + mean[5] * mean[5]) * RawSample::ACCEL_RESOLUTION;
+    if (fabsf(accel_norm - 1.f) > STILL_ACCEL_NORM_ERROR) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (calibrated && fabsf(mean[i] - calibrated_bias[i]) > MAX_BIAS_CHANGE / RawSample::GYRO_RESOLUTION) {
+            return;
+        }
+    }
+    Calibration::learn(gyro_calibration, temperature, mean);
+    applyCalibration();
+    calibration->save(gyro_calibration);
+}
+
+int Sensors::getScheduleCollisions() const
+{
+    return fusion_tasks.getCollisions();
+}
+
+void Sensors::account(const RawSample &sample)
+{
+    float latency = hal->now() - sample.accel_timestamp;
+    latency_sum += latency;
+    if (latency > latency_max) {
+        latency_max = latency;
+    }
+    if (++latency_count == LATENCY_REPORT_PERIOD) {
+        fprintf(stderr, "Sensors: %s latency avg %.0fus max %.0fus, %u samples dropped, %u heap operations\n",
+                pipelined ? "pipelined" : "single-thread",
+                latency_sum / latency_count * 1.e6,
+                latency_max * 1.e6,
+                samples_dropped.load(),
+                AllocationTracker::getViolations());
+        latency_sum = 0.;
+        latency_max = 0.;
+        latency_count = 0;
+        fusion_tasks.report();
+        if (!pipelined) {
+            acquisition_tasks.report();
+        }
+    }
+}
+
+void Sensors::run()
+{
+    fprintf(stderr, "Sensors: Thread started\n");
+    hal->beginImu();
+
+    // Start from the stored calibration, interpolated at the temperature of
+    // the first sample
+    GyroCalibration c;
+    if (calibration->load(c)) {
+        int bins = 0;
+        for (int i = 0; i < GyroCalibration::BINS; i++) {
+            bins += c.windows[i] ? 1 : 0;
+        }
+        fprintf(stderr, "Sensors: Calibration loaded, %d temperatures\n", bins);
+    } else {
+        memset(&c, 0, sizeof(c));
+        fprintf(stderr, "Sensors: Not calibrated, keep the vehicle still\n");
+    }
+    setCalibration(c);
+    if (recorder->isRecording()) {
+        recorder->recordCalibration(c);
+    }
+
+    if (pipelined) {
+        // Fusion and control
+        acquisition.start(ACQUISITION_CPU);
+        setAffinity(FUSION_CPU);
+        RawSample sample;
+        int count = 0;
+        while(true) {
+            while (sem_wait(&samples_available) == -1) {
+                // Interrupted by a signal
+            }
+            if (samples.pop(sample)) {
+                process(sample);
+                account(sample);
+            }
+            if (++count == WARMUP_SAMPLES) {
+                AllocationTracker::arm();
+            }
+        }
+    } else {
+        RawSample sample;
+        int count = 0;
+        while(true) {
+            acquire(sample);
+            process(sample);
+            account(sample);
+            if (++count == WARMUP_SAMPLES) {
+                AllocationTracker::arm();
+            }
+            usleep(2500); // about 400 Hz
+        }
+    }
+}
+
+void Sensors::Acquisition::run()
+{
+    fprintf(stderr, "Sensors: Acquisition thread started\n");
+    RawSample sample;
+    int count = 0;
+    while(true) {
+        if (++count == WARMUP_SAMPLES) {
+            AllocationTracker::arm();
+        }
+        sensors->acquire(sample);
+        if (count % LATENCY_REPORT_PERIOD == 0) {
+            sensors->acquisition_tasks.report();
+        }
+        if (sensors->samples.push(sample)) {
+            sem_post(&sensors->samples_available);
+        } else {
+            // The fusion thread is late, this sample is lost
+            sensors->samples_dropped++;
+        }
         usleep(2500); // about 400 Hz
     }
 }
 
 void Sensors::reset()
 {
-    roll_gyro.reset();
-    pitch_gyro.reset();
+    reset_requested = true;
 }
 
 }
@@ -21,8 +21,20 @@
 #include "Thread.h"
 #include "Object.h"
 #include "Value.h"
+#include "SpscQueue.h"
+#include "Snapshot.h"
+#include "Scheduler.h"
+#include "FlightData.h"
+#include "Hal.h"
+#include "Calibration.h"
+#include "Orientation.h"
+#include "Mahony.h"
+#include "AttitudeEkf.h"
+#include "BiquadBank.h"
+#include "ComplementaryFilter.h"
+#include "SpectrumAnalyzer.h"
 #include "Communication.pb.h"
-#include <SFE_LSM9DS0.h>
+#include <semaphore.h>
 
 namespace org {
 namespace hummingdroid {
@@ -30,8 +42,58 @@ namespace flightapp {
 
 class Controller;
 class Telemetry;
+class Receiver;
+class Recorder;
+class Motors;
 class FlightService;
 
+/**
+ * Sensors configuration, flattened from SensorsConfig.
+ */
+struct SensorsSettings {
+    float accel_lowpass_constant;
+    float gyro_roll_bias;
+    float gyro_roll_gain;
+    float accel_roll_bias;
+    float gyro_pitch_bias;
+    float gyro_pitch_gain;
+    float accel_pitch_bias;
+    float gyro_yaw_bias;
+    bool apply_modulo;
+    int estimator;
+    float mahony_kp;
+    float mahony_ki;
+    bool use_magnetometer;
+    float ekf_gyro_noise;
+    float ekf_bias_noise;
+    float ekf_angle_noise;
+    float ekf_accel_noise;
+    float ekf_vertical_time_constant;
+    bool ekf_altitude;
+    float gyro_sample_rate;
+    int filter_count;
+    struct {
+        bool notch;
+        float frequency;
+        float q;
+    } filters[BiquadBank::MAX_SECTIONS];
+    bool dynamic_notch;
+    float dynamic_notch_min;
+    float dynamic_notch_max;
+    float dynamic_notch_q;
+    int orientation;
+};
+
+/**
+ * Number type of the complementary filter, the fixed-point pipeline is built
+ * with FIXED_POINT_SENSORS defined.
+ */
+#ifdef FIXED_POINT_SENSORS
+typedef Fixed<24> SensorsNumber;
+#else
+typedef float SensorsNumber;
+#endif
+
 /**
  * Attitude determination using the phone gyroscope and accelerometer.
  * 
@@ -39,33 +101,118 @@ class FlightService;
  * This class listens for gyroscope and accelerometer values and compute the
  * current attitude of the QuadCopter.
  * </p>
+ *
+ * <p>
+ * The attitude is estimated either by a complementary filter on each axis,
+ * by a Mahony quaternion filter which also uses the magnetometer and provides
+ * the yaw angle, or by an extended Kalman filter which also estimates the
+ * gyroscope biases and the vertical motion.
+ * </p>
+ *
+ * <p>
+ * The complementary filter works on the raw values, with the number type
+ * SensorsNumber, and is updated at each sample whatever the estimator.
+ * </p>
+ *
+ * <p>
+ * The gyroscope rates go through a bank of biquad filters. Optionally, the
+ * spectrum of the unfiltered rates is analyzed and a notch section of the bank
+ * follows the dominant vibration of each axis.
+ * </p>
+ *
+ * <p>
+ * The configuration is published as an immutable snapshot and applied by the
+ * fusion thread when it changes, so that the fusion never waits for a lock.
+ * </p>
+ *
+ * <p>
+ * The sensors are read by tasks of different rates, run by a scheduler at
+ * each sample: the accelerometer and the gyroscope at every sample, the
+ * magnetometer every MAG_DIVISOR samples and the temperature every
+ * TEMPERATURE_DIVISOR samples. The values which are not read keep their
+ * previous value, except the temperature which is only present in the samples
+ * where it was read. Another scheduler publishes the telemetry every
+ * TELEMETRY_DIVISOR samples.
+ * </p>
+ *
+ * <p>
+ * The gyroscope biases of the calibration file, a table of the sensor
+ * temperature, are interpolated at each new temperature, and subtracted from
+ * each sample. The table is
+ * refined with the average of the gyroscope over each window of
+ * CALIBRATION_WINDOW samples during which the vehicle is still, with the
+ * motors stopped and the accelerometer measuring 1g, and saved back. A vehicle
+ * without calibration only learns its first biases before the motors have
+ * run. The calibration replaces the gyroscope biases of SensorsConfig, which
+ * only apply until a bias is learned.
+ * </p>
+ *
+ * <p>
+ * The samples are converted to the body axes by the functions of the
+ * configured board orientation, instantiated at compile time for each
+ * orientation of SensorsConfig, and the whole fusion works in the body axes.
+ * </p>
+ *
+ * <p>
+ * In pipelined mode, the I2C acquisition runs in a separate thread pinned to
+ * the first CPU, and feeds the fusion and control thread, pinned to the second
+ * CPU, through a lock-free queue. The bus latency of the next sample then
+ * overlaps with the computation of the current one.
+ * </p>
  */
-class Sensors : public Thread, public Object {
+class Sensors : public Thread {
 
 private:
+    /**
+     * Acquisition thread of the pipelined mode.
+     */
+    class Acquisition : public Thread {
+    public:
+        Acquisition(Sensors *sensors) : sensors(sensors) {}
+        void run();
+    private:
+        Sensors *sensors;
+    };
+
+    static const int ACQUISITION_CPU = 0;
+    static const int FUSION_CPU = 1;
+
+    // Number of samples between two latency reports
+    static const int LATENCY_REPORT_PERIOD = 2000;
+
+    // Number of samples after which the heap must not be used anymore
+    static const int WARMUP_SAMPLES = 400;
+
+    // Samples between two reads of the magnetometer and of the temperature
+    static const int MAG_DIVISOR = 8;
+    static const int TEMPERATURE_DIVISOR = 400;
+
+    // Samples between two telemetry updates, the fastest telemetry rate is
+    // 100 Hz
+    static const int TELEMETRY_DIVISOR = 4;
+
+    // Samples averaged for one refinement of the calibration
+    static const int CALIBRATION_WINDOW = 400;
+
+    Hal* hal;
     Controller* controller;
     Telemetry* telemetry;
-
-    // LSM3DS0 sensor
-    LSM9DS0 dof;
+    Receiver* receiver;
+    Recorder* recorder;
+    Motors* motors;
+    Calibration* calibration;
 
 	// Roll
-    Integrator roll_gyro;
-    Value roll_accel;
+    ComplementaryFilter<SensorsNumber> roll_filter;
     Value roll_gyro_rate;
-    LowPass roll_accel_lowpass;
-    HighPass roll_gyro_highpass;
     Value roll;
     float gyro_roll_bias;
     float gyro_roll_gain;
     float accel_roll_bias;
 
 	// Pitch
-    Integrator pitch_gyro;
-    Value pitch_accel;
+    ComplementaryFilter<SensorsNumber> pitch_filter;
     Value pitch_gyro_rate;
-    LowPass pitch_accel_lowpass;
-    HighPass pitch_gyro_highpass;
     Value pitch;
     float gyro_pitch_bias;
     float gyro_pitch_gain;
@@ -75,18 +222,101 @@ private:
     Value yaw_rate;
     float gyro_yaw_bias;
 
+    // Mounting of the sensor board
+    const OrientationFunctions *orientation;
+
+    // Gyroscope timestamp of the last complementary filter update
+    Timestamp filter_timestamp;
+
+    // Gyroscope filters, roll, pitch and yaw rates in the first 3 lanes
+    BiquadBank gyro_filters;
+
+    // Dynamic notch, section of gyro_filters tracking the vibration peaks
+    SpectrumAnalyzer spectrum;
+    int dynamic_notch;
+    float dynamic_notch_q;
+
+    // Quaternion estimator
+    CommandPacket::SensorsConfig::Estimator estimator;
+    Mahony mahony;
+    Timestamp mahony_timestamp;
+    float mag_weight;
+    std::atomic<bool> read_mag;
+    Value yaw;
+
+    // Kalman filter
+    AttitudeEkf ekf;
+    Timestamp ekf_timestamp;
+    bool ekf_altitude;
+
 	// Altitude
     Value altitude;
 
+    // Gyroscope calibration, its biases at the current temperature in the
+    // sensor and in the body axes, and the sums of the current still window, gyroscope then accelerometer
+    GyroCalibration gyro_calibration;
+    bool refine_calibration;
+    float temperature;
+    float calibrated_bias[3];
+    float body_bias[3];
+    bool calibrated;
+    // Biases subtracted from the calibrated rates, in radians per second: the
+    // configured ones until the vehicle is calibrated, then zero
+    float rate_bias[3];
+    // Whether the motors have run since the startup, and during the whole
+    // current window
+    bool motors_started;
+    int window_count;
+    bool window_stopped;
+    double window_sum[6];
+    double window_squares[6];
+
     // Computed attitude
-    Attitude attitude;
+    AttitudeState attitude;
 
     // Switches
-    Switches switches;
+    SwitchesState switches;
 
     // Misc
     bool apply_modulo;
 
+    // Config
+    Snapshot<SensorsSettings> settings;
+    unsigned int settings_version;
+    std::atomic<bool> reset_requested;
+
+    // Tasks of the acquisition, which fill acquired, and of the fusion, whose
+    // phases avoid those of the acquisition: both are ticked at each sample
+    Scheduler<Sensors> acquisition_tasks;
+    Scheduler<Sensors> fusion_tasks;
+    RawSample acquired;
+
+    // Pipelined mode
+    bool pipelined;
+    Acquisition acquisition;
+    SpscQueue<RawSample, 16> samples;
+    sem_t samples_available;
+    std::atomic<unsigned int> samples_dropped;
+
+    // End-to-end latency, from the first bus read to the motors update
+    float latency_sum;
+    float latency_max;
+    int latency_count;
+
+    static bool loadSettings(const CommandPacket::SensorsConfig & config, SensorsSettings & settings);
+    void applySettings(const SensorsSettings & settings);
+    void acquire(RawSample & sample);
+    void readAccel();
+    void readGyro();
+    void readMag();
+    void readTemperature();
+    void publishTelemetry();
+    void refineCalibration(const RawSample & sample);
+    void applyCalibration();
+    void applyGyroBiases();
+    // Latency statistics of a processed sample
+    void account(const RawSample & sample);
+
 public:
 	/**
 	 * Constructor.
@@ -96,11 +326,51 @@ public:
 	 */
     Sensors(FlightService *context);
 
+    /**
+     * Sets the sensors configuration, an invalid configuration is ignored.
+     */
     void setConfig(const CommandPacket::SensorsConfig & config);
 
+    /**
+     * Selects the pipelined mode, must be called before run().
+     */
+    void setPipelined(bool pipelined);
+
     void run();
 
+    /**
+     * Acquires and processes one sample, for a simulated vehicle which is
+     * stepped by its owner instead of running the sensor thread.
+     */
+    void step();
+
+    /**
+     * Processes one sample, called by run() or by the replay.
+     *
+     * <p>
+     * The pending commands are applied first, and the sample is processed
+     * with its own timestamps as the clock.
+     * </p>
+     */
+    void process(const RawSample & sample);
+
+    /**
+     * Sets the gyroscope calibration and starts refining it, from the control
+     * thread. Called by run() with the calibration file, or by the replay.
+     */
+    void setCalibration(const GyroCalibration & calibration);
+
+    /**
+     * Resets the attitude estimation at the next sample.
+     */
     void reset();
+
+    /**
+     * Number of samples of the hyperperiod at which several periodic tasks of
+     * the acquisition and of the fusion run, 0 when their phases are
+     * disjoint.
+     */
+    int getScheduleCollisions() const;
 };
 
 }
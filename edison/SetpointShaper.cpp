@@ -0,0 +1,120 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SetpointShaper.h"
+#include <math.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float SetpointShaper::MAX_INTERVAL;
+
+SetpointShaper::SetpointShaper() :
+    mode(STEP),
+    interval(0.),
+    last_timestamp(NAN),
+    arrival(),
+    pushed_timestamp(NAN),
+    has_pushed(false),
+    output_time(),
+    started(false)
+{
+    for (int i = 0; i < AXES; i++) {
+        max_slew[i] = INFINITY;
+        previous[i] = 0.;
+        last[i] = 0.;
+        pushed[i] = 0.;
+        output[i] = 0.;
+    }
+}
+
+void SetpointShaper::setConfig(Mode mode, const float max_slew[AXES])
+{
+    this->mode = mode;
+    for (int i = 0; i < AXES; i++) {
+        this->max_slew[i] = max_slew[i];
+    }
+}
+
+void SetpointShaper::push(const float values[AXES], double timestamp)
+{
+    for (int i = 0; i < AXES; i++) {
+        pushed[i] = values[i];
+    }
+    pushed_timestamp = timestamp;
+    has_pushed = true;
+}
+
+void SetpointShaper::reset()
+{
+    interval = 0.;
+    started = false;
+}
+
+void SetpointShaper::update(const Timestamp &now, float values[AXES])
+{
+    if (has_pushed) {
+        has_pushed = false;
+        // Interval from the remote clock, which does not include the network
+        // jitter, or from the arrival times
+        float received = now - arrival;
+        if (!isnan(pushed_timestamp) && !isnan(last_timestamp) && pushed_timestamp > last_timestamp) {
+            received = pushed_timestamp - last_timestamp;
+        }
+        interval = started && received > 0. && received <= MAX_INTERVAL ? received : 0.;
+        for (int i = 0; i < AXES; i++) {
+            previous[i] = last[i];
+            last[i] = pushed[i];
+        }
+        last_timestamp = pushed_timestamp;
+        arrival = now;
+    }
+
+    // Position between the last two commands, 1 at the last one
+    float position = 1.;
+    if (mode != STEP && interval > 0.) {
+        float elapsed = (now - arrival) / interval;
+        if (mode == INTERPOLATE) {
+            position = elapsed < 1. ? elapsed : 1.;
+        } else {
+            position = 1. + (elapsed < 1. ? elapsed : 1.);
+        }
+    }
+
+    float dt = started ? now - output_time : 0.;
+    for (int i = 0; i < AXES; i++) {
+        float target = previous[i] + (last[i] - previous[i]) * position;
+        if (started) {
+            float step = max_slew[i] * dt;
+            if (target > output[i] + step) {
+                target = output[i] + step;
+            } else if (target < output[i] - step) {
+                target = output[i] - step;
+            }
+        }
+        output[i] = target;
+        values[i] = target;
+    }
+    output_time = now;
+    started = true;
+}
+
+}
+}
+}
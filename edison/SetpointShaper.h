@@ -0,0 +1,128 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SETPOINTSHAPER_H_
+#define _SETPOINTSHAPER_H_
+
+#include "Timestamp.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Shaping of the commands received between two packets.
+ *
+ * <p>
+ * The commands arrive at the packet rate of the remote, much lower than the
+ * control rate, and a command applied as a step is a spike of the derivative
+ * terms. The shaper either interpolates from the previous command to the
+ * last one over the packet interval, one interval late, or extrapolates the
+ * trend of the last two commands for at most one interval. The result is then
+ * limited to a maximum rate of change per axis.
+ * </p>
+ *
+ * <p>
+ * The packet interval is measured with the timestamps of the remote when
+ * both packets have one, otherwise with their arrival times. Commands more
+ * than MAX_INTERVAL apart are not a stream, the last one is applied as a step,
+ * only limited by the slew rate.
+ * </p>
+ *
+ * <p>
+ * The commands are pushed and read by the control thread, each update is a
+ * constant number of operations.
+ * </p>
+ */
+class SetpointShaper {
+
+public:
+    /**
+     * Number of shaped values.
+     */
+    static const int AXES = 3;
+
+    /**
+     * Longest interval between two packets of a command stream, in seconds.
+     */
+    static constexpr float MAX_INTERVAL = .2f;
+
+    /**
+     * Shaping modes, the values of ControllerConfig.SetpointMode.
+     */
+    enum Mode {
+        STEP = 0,
+        INTERPOLATE = 1,
+        EXTRAPOLATE = 2
+    };
+
+    SetpointShaper();
+
+    /**
+     * Sets the shaping mode and the largest rate of change of each axis in
+     * units per second, INFINITY to disable the limit.
+     */
+    void setConfig(Mode mode, const float max_slew[AXES]);
+
+    /**
+     * Sets a new command, which is stamped with the time of the next update.
+     *
+     * @param timestamp
+     *            Time of the command on the remote clock, in seconds, NAN if
+     *            unknown.
+     */
+    void push(const float values[AXES], double timestamp);
+
+    /**
+     * Computes the shaped command at the given time.
+     */
+    void update(const Timestamp & now, float values[AXES]);
+
+    /**
+     * Forgets the previous commands, the next update jumps to the last one.
+     */
+    void reset();
+
+private:
+    Mode mode;
+    float max_slew[AXES];
+
+    // Last two commands and their interval, remote timestamp and arrival
+    // time of the last one
+    float previous[AXES];
+    float last[AXES];
+    float interval;
+    double last_timestamp;
+    Timestamp arrival;
+
+    // Command received since the last update
+    float pushed[AXES];
+    double pushed_timestamp;
+    bool has_pushed;
+
+    // Output of the last update, false when reset
+    float output[AXES];
+    Timestamp output_time;
+    bool started;
+};
+
+}
+}
+}
+
+#endif
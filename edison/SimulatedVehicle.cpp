@@ -0,0 +1,309 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SimulatedVehicle.h"
+#include "Orientation.h"
+#include <math.h>
+
+#define G 9.80665f
+#define RAD_TO_DEG 57.295779513082320876798154814105f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float SimulatedVehicle::MAX_STEP;
+
+// Motors order of the HAL
+enum {
+    FL,
+    FR,
+    BR,
+    BL
+};
+
+// Earth magnetic field in the world frame, in Gauss
+static const float MAGNETIC_FIELD[3] = { .2f, 0.f, .4f };
+
+// Conversion to a raw value, saturated like the sensor
+static inline int16_t raw(float value, float resolution)
+{
+    float r = roundf(value / resolution);
+    return r > 32767.f ? 32767 : r < -32768.f ? -32768 : (int16_t)r;
+}
+
+void VehicleParameters::nominal(VehicleParameters &p)
+{
+    p.mass = .5f;
+    p.arm = .12f;
+    p.inertia[0] = 3.e-3f;
+    p.inertia[1] = 3.e-3f;
+    p.inertia[2] = 5.e-3f;
+    for (int i = 0; i < 4; i++) {
+        // Hover at half throttle
+        p.max_thrust[i] = p.mass * G / 2.f;
+    }
+    p.motor_time_constant = .03f;
+    p.yaw_coefficient = .015f;
+    p.drag = .3f;
+    for (int i = 0; i < 3; i++) {
+        p.gyro_bias[i] = 0.f;
+        p.initial_attitude[i] = 0.f;
+        p.initial_rates[i] = 0.f;
+    }
+    p.gyro_noise = .005f;
+    p.accel_noise = .01f;
+    p.temperature = 25.f;
+}
+
+void VehicleParameters::randomize(uint32_t seed, VehicleParameters &p)
+{
+    Random random(seed);
+    nominal(p);
+    p.mass *= random.uniform(.9f, 1.1f);
+    for (int i = 0; i < 3; i++) {
+        p.inertia[i] *= random.uniform(.8f, 1.2f);
+        p.gyro_bias[i] = random.uniform(-.03f, .03f);
+        p.initial_rates[i] = random.uniform(-1.f, 1.f);
+    }
+    for (int i = 0; i < 4; i++) {
+        p.max_thrust[i] *= random.uniform(.95f, 1.05f);
+    }
+    p.motor_time_constant = random.uniform(.02f, .05f);
+    p.initial_attitude[0] = random.uniform(-.3f, .3f);
+    p.initial_attitude[1] = random.uniform(-.3f, .3f);
+    p.initial_attitude[2] = random.uniform(-M_PI, M_PI);
+}
+
+Random::Random(uint32_t seed) :
+    state(seed * 2654435761u ^ 0x9e3779b9u)
+{
+    if (!state) {
+        state = 1;
+    }
+}
+
+float Random::uniform(float min, float max)
+{
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return min + (max - min) * (state >> 8) * (1.f / 16777216.f);
+}
+
+float Random::gaussian()
+{
+    // Box-Muller, u1 is never 0
+    float u1 = uniform(1.f / 16777216.f, 1.f);
+    float u2 = uniform(0.f, 1.f);
+    return sqrtf(-2.f * logf(u1)) * cosf(2.f * (float)M_PI * u2);
+}
+
+SimulatedVehicle::SimulatedVehicle(const VehicleParameters &parameters, uint32_t seed) :
+    parameters(parameters),
+    random(seed)
+{
+    // Any non-zero time, zero is an invalid timestamp
+    time.t.tv_sec = 1;
+    for (int i = 0; i < 3; i++) {
+        attitude[i] = parameters.initial_attitude[i];
+        rates[i] = parameters.initial_rates[i];
+        position[i] = 0.f;
+        velocity[i] = 0.f;
+    }
+    // Released in flight, at the hover thrust
+    for (int i = 0; i < 4; i++) {
+        duty[i] = 0.f;
+        thrust[i] = parameters.mass * G / 4.f;
+    }
+    force[0] = 0.f;
+    force[1] = 0.f;
+    force[2] = -G;
+}
+
+void SimulatedVehicle::rotation(float R[3][3]) const
+{
+    // Body to world, yaw-pitch-roll order
+    float sr = sinf(attitude[0]), cr = cosf(attitude[0]);
+    float sp = sinf(attitude[1]), cp = cosf(attitude[1]);
+    float sy = sinf(attitude[2]), cy = cosf(attitude[2]);
+    R[0][0] = cp * cy;
+    R[0][1] = sr * sp * cy - cr * sy;
+    R[0][2] = cr * sp * cy + sr * sy;
+    R[1][0] = cp * sy;
+    R[1][1] = sr * sp * sy + cr * cy;
+    R[1][2] = cr * sp * sy - sr * cy;
+    R[2][0] = -sp;
+    R[2][1] = sr * cp;
+    R[2][2] = cr * cp;
+}
+
+void SimulatedVehicle::integrate(float dt)
+{
+    // Motors
+    float k = dt / parameters.motor_time_constant;
+    if (k > 1.f) {
+        k = 1.f;
+    }
+    float total = 0.f;
+    for (int i = 0; i < 4; i++) {
+        thrust[i] += (duty[i] * parameters.max_thrust[i] - thrust[i]) * k;
+        total += thrust[i];
+    }
+
+    // Torques, the motors are on the diagonals
+    float d = parameters.arm * (float)M_SQRT1_2;
+    float torque[3] = {
+        d * (thrust[FL] + thrust[BL] - thrust[FR] - thrust[BR]),
+        d * (thrust[FL] + thrust[FR] - thrust[BR] - thrust[BL]),
+        parameters.yaw_coefficient * (thrust[FR] + thrust[BL] - thrust[FL] - thrust[BR])
+    };
+
+    // Euler equations
+    const float *I = parameters.inertia;
+    float p = rates[0], q = rates[1], r = rates[2];
+    rates[0] += (torque[0] - (I[2] - I[1]) * q * r) / I[0] * dt;
+    rates[1] += (torque[1] - (I[0] - I[2]) * r * p) / I[1] * dt;
+    rates[2] += (torque[2] - (I[1] - I[0]) * p * q) / I[2] * dt;
+
+    // Euler angles kinematics
+    float sr = sinf(attitude[0]), cr = cosf(attitude[0]);
+    float cp = cosf(attitude[1]), tp = tanf(attitude[1]);
+    attitude[0] += (p + (q * sr + r * cr) * tp) * dt;
+    attitude[1] += (q * cr - r * sr) * dt;
+    attitude[2] += (q * sr + r * cr) / cp * dt;
+    for (int i = 0; i < 3; i += 2) {
+        if (attitude[i] > M_PI) {
+            attitude[i] -= 2.f * M_PI;
+        } else if (attitude[i] < -M_PI) {
+            attitude[i] += 2.f * M_PI;
+        }
+    }
+
+    // Translation, the specific force is the thrust and the drag
+    float R[3][3];
+    rotation(R);
+    for (int i = 0; i < 3; i++) {
+        float v = R[0][i] * velocity[0] + R[1][i] * velocity[1] + R[2][i] * velocity[2];
+        force[i] = -parameters.drag * v;
+    }
+    force[2] -= total / parameters.mass;
+    for (int i = 0; i < 3; i++) {
+        float a = R[i][0] * force[0] + R[i][1] * force[1] + R[i][2] * force[2];
+        if (i == 2) {
+            a += G;
+        }
+        velocity[i] += a * dt;
+        position[i] += velocity[i] * dt;
+    }
+}
+
+void SimulatedVehicle::advance(float dt)
+{
+    int steps = (int)ceilf(dt / MAX_STEP);
+    for (int i = 0; i < steps; i++) {
+        integrate(dt / steps);
+    }
+    long nsec = time.t.tv_nsec + (long)(dt * 1.e9f);
+    time.t.tv_sec += nsec / 1000000000;
+    time.t.tv_nsec = nsec % 1000000000;
+}
+
+void SimulatedVehicle::getAttitude(float &roll, float &pitch, float &yaw) const
+{
+    roll = attitude[0];
+    pitch = attitude[1];
+    yaw = attitude[2];
+}
+
+Timestamp SimulatedVehicle::now()
+{
+    return time;
+}
+
+void SimulatedVehicle::beginImu()
+{
+}
+
+void SimulatedVehicle::readAccel(RawSample &sample)
+{
+    // The accelerometer measures the specific force, in the sensor axes of the
+    // Edison board
+    float body[3] = { force[0] / G, force[1] / G, force[2] / G };
+    float measured[3];
+    BoardOrientation::unrotate(body, measured);
+    float noise = parameters.accel_noise;
+    sample.ax = raw(measured[0] + noise * random.gaussian(), RawSample::ACCEL_RESOLUTION);
+    sample.ay = raw(measured[1] + noise * random.gaussian(), RawSample::ACCEL_RESOLUTION);
+    sample.az = raw(measured[2] + noise * random.gaussian(), RawSample::ACCEL_RESOLUTION);
+    sample.accel_timestamp = time;
+}
+
+void SimulatedVehicle::readGyro(RawSample &sample)
+{
+    float body[3];
+    for (int i = 0; i < 3; i++) {
+        body[i] = (rates[i] + parameters.gyro_bias[i] + parameters.gyro_noise * random.gaussian()) * RAD_TO_DEG;
+    }
+    float measured[3];
+    BoardOrientation::unrotate(body, measured);
+    sample.gx = raw(measured[0], RawSample::GYRO_RESOLUTION);
+    sample.gy = raw(measured[1], RawSample::GYRO_RESOLUTION);
+    sample.gz = raw(measured[2], RawSample::GYRO_RESOLUTION);
+    sample.gyro_timestamp = time;
+}
+
+void SimulatedVehicle::readMag(RawSample &sample)
+{
+    float R[3][3];
+    rotation(R);
+    float field[3];
+    for (int i = 0; i < 3; i++) {
+        field[i] = R[0][i] * MAGNETIC_FIELD[0] + R[1][i] * MAGNETIC_FIELD[1] + R[2][i] * MAGNETIC_FIELD[2];
+    }
+    float measured[3];
+    BoardOrientation::unrotate(field, measured);
+    sample.mx = raw(measured[0], RawSample::MAG_RESOLUTION);
+    sample.my = raw(measured[1], RawSample::MAG_RESOLUTION);
+    sample.mz = raw(measured[2], RawSample::MAG_RESOLUTION);
+}
+
+void SimulatedVehicle::readTemperature(RawSample &sample)
+{
+    sample.temp = raw(parameters.temperature - RawSample::TEMPERATURE_OFFSET, RawSample::TEMPERATURE_RESOLUTION);
+}
+
+void SimulatedVehicle::beginMotors(int period_ns)
+{
+}
+
+void SimulatedVehicle::setMotorsPeriod(int period_ns)
+{
+}
+
+void SimulatedVehicle::writeMotors(const float duty[4])
+{
+    for (int i = 0; i < 4; i++) {
+        this->duty[i] = duty[i] < 0.f ? 0.f : duty[i] > 1.f ? 1.f : duty[i];
+    }
+}
+
+}
+}
+}
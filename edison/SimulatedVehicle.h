@@ -0,0 +1,138 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SIMULATEDVEHICLE_H_
+#define _SIMULATEDVEHICLE_H_
+
+#include "Hal.h"
+#include <stdint.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Physical parameters of a simulated vehicle, in SI units.
+ */
+struct VehicleParameters {
+    float mass;
+    float arm; // Distance from the center to each motor
+    float inertia[3]; // Roll, pitch and yaw moments of inertia
+    float max_thrust[4]; // Thrust of each motor at full duty cycle
+    float motor_time_constant;
+    float yaw_coefficient; // Yaw torque per thrust unit
+    float drag; // Linear drag per mass unit
+    float gyro_bias[3];
+    float gyro_noise; // Standard deviation, in rad/s
+    float accel_noise; // Standard deviation, in g
+    float temperature; // Sensor temperature, in degrees Celsius
+    float initial_attitude[3]; // Roll, pitch and yaw
+    float initial_rates[3]; // Roll, pitch and yaw rates
+
+    /**
+     * Parameters of a 500g quadcopter hovering at half throttle.
+     */
+    static void nominal(VehicleParameters & parameters);
+
+    /**
+     * Nominal parameters with random manufacturing and sensor errors, and a
+     * random initial attitude. The same seed gives the same vehicle.
+     */
+    static void randomize(uint32_t seed, VehicleParameters & parameters);
+};
+
+/**
+ * Small deterministic random generator, owned by each simulated vehicle so
+ * that the vehicles are independent of the thread which runs them.
+ */
+class Random {
+public:
+    Random(uint32_t seed);
+    float uniform(float min, float max);
+    float gaussian();
+private:
+    uint32_t state;
+};
+
+/**
+ * Rigid body model of a quadcopter in X configuration, seen by the flight
+ * software through the HAL.
+ *
+ * <p>
+ * The vehicle has its own clock, which only moves when advance() is called:
+ * the owner alternates advance() and a step of the flight software, which
+ * runs as fast as the host allows. The samples are generated with the scales
+ * and the axes of the LSM9DS0 as mounted on the vehicle, the duty cycles
+ * written by the motors are the thrust commands of a first-order motor model.
+ * There is no ground, the vehicle flies in free space.
+ * </p>
+ */
+class SimulatedVehicle : public Hal {
+public:
+    SimulatedVehicle(const VehicleParameters & parameters, uint32_t seed);
+
+    /**
+     * Integrates the motion over dt seconds and advances the clock.
+     */
+    void advance(float dt);
+
+    /**
+     * True attitude, in radians.
+     */
+    void getAttitude(float & roll, float & pitch, float & yaw) const;
+
+    // Hal
+    Timestamp now();
+    void beginImu();
+    void readAccel(RawSample & sample);
+    void readGyro(RawSample & sample);
+    void readMag(RawSample & sample);
+    void readTemperature(RawSample & sample);
+    void beginMotors(int period_ns);
+    void setMotorsPeriod(int period_ns);
+    void writeMotors(const float duty[4]);
+
+private:
+    // Longest integration step
+    static constexpr float MAX_STEP = .0005f;
+
+    VehicleParameters parameters;
+    Random random;
+    Timestamp time;
+
+    // Euler angles, body rates, and world position and velocity (z down)
+    float attitude[3];
+    float rates[3];
+    float position[3];
+    float velocity[3];
+
+    float duty[4];
+    float thrust[4];
+
+    // Specific force in the body frame, from the last step
+    float force[3];
+
+    void integrate(float dt);
+    void rotation(float R[3][3]) const;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Simulation.h"
+#include "WorkStealingRunner.h"
+#include <math.h>
+#include <stdio.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+constexpr float Simulation::CRASH_INCLINATION;
+constexpr float Simulation::STEP;
+constexpr float Simulation::STEP_PERIOD;
+
+// Altitude commands of the successive setpoints of the scenario, never 0
+// which resets the controller. The scheduled configuration flies them at
+// collective throttles from 0.35 to 0.75.
+static const float ALTITUDES[] = { -.15f, .05f, .25f, -.05f, .15f };
+
+// Throttle points of the scheduled configuration, between the entries of the
+// table of GainSchedule, and the rate loop proportional gains at each point
+static const float SCHEDULE_THROTTLES[] = { .33f, .46f, .59f, .71f };
+static const float SCHEDULE_RATE_KP[] = { .065f, .055f, .045f, .04f };
+
+static void setGains(hummingdroid::PID *pid, float kp, float ki, float kd, float ko, float td)
+{
+    pid->set_kp(kp);
+    pid->set_ki(ki);
+    pid->set_kd(kd);
+    pid->set_ko(ko);
+    pid->set_td(td);
+}
+
+/**
+ * Flight of the randomized vehicle of each index.
+ */
+class MonteCarloTask : public WorkStealingRunner::Task {
+public:
+    MonteCarloTask(const char *config, int config_size, float duration, SimulationResult *results) :
+        config(config),
+        config_size(config_size),
+        duration(duration),
+        results(results)
+    {
+    }
+
+    void execute(int index)
+    {
+        VehicleParameters parameters;
+        VehicleParameters::randomize(index, parameters);
+        Simulation simulation(parameters, index);
+        simulation.send(config, config_size);
+        simulation.fly(duration, results[index]);
+    }
+
+private:
+    const char *config;
+    int config_size;
+    float duration;
+    SimulationResult *results;
+};
+
+Simulation::Simulation(const VehicleParameters &parameters, uint32_t seed) :
+    vehicle(parameters, seed),
+    service(&vehicle)
+{
+    service.motors.begin();
+}
+
+void Simulation::send(const CommandPacket &packet)
+{
+    char data[Receiver::MAX_PACKET_SIZE];
+    if (!packet.SerializeToArray(data, sizeof(data))) {
+        fprintf(stderr, "Simulation: Cannot serialize the command packet\n");
+        return;
+    }
+    send(data, packet.GetCachedSize());
+}
+
+void Simulation::send(const void *data, int size)
+{
+    service.receiver.dispatch(data, size);
+}
+
+void Simulation::command(float roll, float pitch, float altitude)
+{
+    CommandPacket packet;
+    Attitude *command = packet.mutable_command();
+    command->set_altitude(altitude);
+    command->set_roll(roll);
+    command->set_pitch(pitch);
+    command->set_yaw_rate(0.);
+    command->set_timestamp(vehicle.now());
+    send(packet);
+}
+
+void Simulation::fly(float duration, SimulationResult &result)
+{
+    const float dt = 1.f / SAMPLE_RATE;
+    const int samples = (int)(duration * SAMPLE_RATE);
+    const int period = (int)(STEP_PERIOD * SAMPLE_RATE);
+    float roll_command = 0.;
+    float pitch_command = 0.;
+    double sum = 0.;
+    double effort = 0.;
+    float previous[4];
+    service.motors.getOutputs(previous);
+
+    result.max_inclination = 0.;
+    result.overshoot = 0.;
+    result.crashed = false;
+    int i;
+    for (i = 0; i < samples && !result.crashed; i++) {
+        if (i % period == 0) {
+            // Hover, roll step, hover, pitch step
+            int phase = (i / period) % 4;
+            roll_command = phase == 1 ? STEP : 0.f;
+            pitch_command = phase == 3 ? STEP : 0.f;
+            float altitude = ALTITUDES[i / period % (sizeof(ALTITUDES) / sizeof(ALTITUDES[0]))];
+            command(roll_command, pitch_command, altitude);
+        }
+        vehicle.advance(dt);
+        service.sensors.step();
+
+        float roll, pitch, yaw;
+        vehicle.getAttitude(roll, pitch, yaw);
+        sum += (roll_command - roll) * (roll_command - roll) + (pitch_command - pitch) * (pitch_command - pitch);
+        float overshoot = fmaxf(roll_command ? roll - roll_command : 0.f,
+                                pitch_command ? pitch - pitch_command : 0.f) / STEP;
+        if (overshoot > result.overshoot) {
+            result.overshoot = overshoot;
+        }
+        float outputs[4];
+        service.motors.getOutputs(outputs);
+        for (int j = 0; j < 4; j++) {
+            effort += fabsf(outputs[j] - previous[j]);
+            previous[j] = outputs[j];
+        }
+        float inclination = fmaxf(fabsf(roll), fabsf(pitch));
+        if (inclination > result.max_inclination) {
+            result.max_inclination = inclination;
+        }
+        result.crashed = inclination > CRASH_INCLINATION;
+    }
+    result.rms_error = i ? sqrt(sum / (2 * i)) : 0.;
+    result.effort = i ? effort / i : 0.;
+    result.duration = i * dt;
+}
+
+void Simulation::getDefaultConfig(CommandPacket &packet)
+{
+    CommandPacket::ControllerConfig *controller = packet.mutable_controller_config();
+    // The altitude is not measured, the offset holds the hover throttle
+    setGains(controller->mutable_altitude_pid(), 0., 0., 0., .5, 0.);
+    // Cascaded loops, the damping comes from the measured rates: the
+    // derivative term of the angle loops rings at half the sample rate
+    setGains(controller->mutable_roll_pid(), 4., 0., 0., 0., 0.);
+    setGains(controller->mutable_pitch_pid(), 4., 0., 0., 0., 0.);
+    setGains(controller->mutable_roll_rate_pid(), .05, .05, 0., 0., 0.);
+    setGains(controller->mutable_pitch_rate_pid(), .05, .05, 0., 0., 0.);
+    setGains(controller->mutable_yaw_rate_pid(), .2, 0., 0., 0., 0.);
+    controller->set_max_inclinaison(CRASH_INCLINATION);
+    controller->set_max_yaw_rate(10.);
+
+    CommandPacket::SensorsConfig *sensors = packet.mutable_sensors_config();
+    sensors->set_accel_lowpass_constant(1.);
+    sensors->set_gyro_roll_bias(0.);
+    sensors->set_gyro_pitch_bias(0.);
+    sensors->set_gyro_yaw_bias(0.);
+    sensors->set_gyro_roll_gain(1.);
+    sensors->set_gyro_pitch_gain(1.);
+    sensors->set_gyro_yaw_gain(1.);
+    sensors->set_accel_roll_bias(0.);
+    sensors->set_accel_pitch_bias(0.);
+    sensors->set_apply_modulo(false);
+
+    CommandPacket::MotorsConfig *motors = packet.mutable_motors_config();
+    motors->set_min_pwm(0.);
+    motors->set_max_pwm(1.);
+}
+
+void Simulation::getScheduledConfig(CommandPacket &packet)
+{
+    getDefaultConfig(packet);
+    CommandPacket::ControllerConfig *controller = packet.mutable_controller_config();
+    // The throttle is the offset plus the altitude command, the altitude
+    // itself is not measured
+    setGains(controller->mutable_altitude_pid(), 1., 0., 0., .5, 0.);
+    for (unsigned int i = 0; i < sizeof(SCHEDULE_THROTTLES) / sizeof(SCHEDULE_THROTTLES[0]); i++) {
+        CommandPacket::ControllerConfig::GainPoint *point = controller->add_gain_schedule();
+        point->set_throttle(SCHEDULE_THROTTLES[i]);
+        setGains(point->mutable_roll_rate_pid(), SCHEDULE_RATE_KP[i], .05, 0., 0., 0.);
+        setGains(point->mutable_pitch_rate_pid(), SCHEDULE_RATE_KP[i], .05, 0., 0., 0.);
+    }
+}
+
+bool Simulation::runMonteCarlo(int vehicles, float duration, const CommandPacket &packet)
+{
+    if (vehicles < 1) {
+        fprintf(stderr, "Simulation: Invalid number of vehicles\n");
+        return false;
+    }
+
+    char config[Receiver::MAX_PACKET_SIZE];
+    if (!packet.SerializeToArray(config, sizeof(config))) {
+        fprintf(stderr, "Simulation: Cannot serialize the configuration\n");
+        return false;
+    }
+
+    SimulationResult *results = new SimulationResult[vehicles];
+    MonteCarloTask task(config, packet.GetCachedSize(), duration, results);
+    WorkStealingRunner runner;
+    Timestamp start = Timestamp::now();
+    runner.run(task, vehicles);
+    float elapsed = Timestamp::now() - start;
+
+    int crashed = 0;
+    int worst = 0;
+    float sum = 0.;
+    float simulated = 0.;
+    float max_inclination = 0.;
+    for (int i = 0; i < vehicles; i++) {
+        const SimulationResult & r = results[i];
+        if (r.crashed) {
+            crashed++;
+        } else {
+            sum += r.rms_error;
+            if (r.rms_error > results[worst].rms_error || results[worst].crashed) {
+                worst = i;
+            }
+            if (r.max_inclination > max_inclination) {
+                max_inclination = r.max_inclination;
+            }
+        }
+        simulated += r.duration;
+    }
+    fprintf(stderr, "Simulation: %d vehicles, %.0fs each, %d crashed\n", vehicles, duration, crashed);
+    if (crashed < vehicles) {
+        fprintf(stderr, "Simulation: RMS error avg %.3f worst %.3f rad (vehicle %d), max inclination %.3f rad\n",
+                sum / (vehicles - crashed), results[worst].rms_error, worst, max_inclination);
+    }
+    fprintf(stderr, "Simulation: %.2fs on %d workers, %.0f simulated seconds per second\n",
+            elapsed, runner.getWorkers(), simulated / elapsed);
+    delete[] results;
+    return crashed == 0;
+}
+
+}
+}
+}
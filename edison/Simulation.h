@@ -0,0 +1,115 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SIMULATION_H_
+#define _SIMULATION_H_
+
+#include "FlightService.h"
+#include "SimulatedVehicle.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Outcome of a simulated flight.
+ */
+struct SimulationResult {
+    float rms_error; // Roll and pitch errors, in radians
+    float max_inclination; // Largest roll or pitch, in radians
+    float overshoot; // Largest overshoot of the steps, relative to the step
+    float effort; // Average duty cycle variation per sample, sum of the 4 motors
+    bool crashed; // The inclination went over CRASH_INCLINATION
+    float duration; // Simulated time, in seconds
+};
+
+/**
+ * Flight software in the loop with a simulated vehicle.
+ *
+ * <p>
+ * The flight software is an ordinary FlightService, with the simulated vehicle
+ * as HAL. No thread is started: each sample is acquired and processed by
+ * fly(), in the caller thread, so that many simulations can run in parallel.
+ * </p>
+ */
+class Simulation {
+public:
+    static const int SAMPLE_RATE = 400;
+
+    // Inclination from which the vehicle is considered lost
+    static constexpr float CRASH_INCLINATION = 1.f;
+
+    // Roll and pitch steps of the scenario, in radians
+    static constexpr float STEP = .2f;
+
+    // Duration of each setpoint of the scenario, in seconds
+    static constexpr float STEP_PERIOD = 1.f;
+
+    Simulation(const VehicleParameters & parameters, uint32_t seed);
+
+    /**
+     * Sends a packet to the flight software, as the ground station does.
+     */
+    void send(const CommandPacket & packet);
+
+    /**
+     * Sends a serialized packet, the same packet can then be sent to several
+     * simulations from different threads.
+     */
+    void send(const void *data, int size);
+
+    /**
+     * Flies the scenario: hover, roll step, hover, pitch step, and again,
+     * with the same gains as the configuration sent before. The altitude
+     * command changes with each setpoint, which moves the collective
+     * throttle when the altitude PID has a proportional gain.
+     */
+    void fly(float duration, SimulationResult & result);
+
+    /**
+     * Configuration for the nominal vehicle, used by default.
+     */
+    static void getDefaultConfig(CommandPacket & packet);
+
+    /**
+     * Default configuration with gain schedules on the rate loops, and an
+     * altitude PID which turns the altitude commands of the scenario into
+     * collective throttles over the scheduled range.
+     */
+    static void getScheduledConfig(CommandPacket & packet);
+
+    /**
+     * Flies the randomized vehicles with the given configuration on all the
+     * CPUs, and prints the statistics.
+     *
+     * @return true if no vehicle crashed.
+     */
+    static bool runMonteCarlo(int vehicles, float duration, const CommandPacket & config);
+
+private:
+    SimulatedVehicle vehicle;
+    FlightService service;
+
+    void command(float roll, float pitch, float altitude);
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,154 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include <atomic>
+#include <stddef.h>
+#include <string.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Immutable copies of a plain structure, published by one thread and read
+ * without lock by a fixed number of reader threads.
+ *
+ * <p>
+ * The writer copies the new value in a free buffer and publishes it with a
+ * single atomic pointer store. Each reader thread has its own index, and
+ * get() records the returned buffer in the slot of the reader before the
+ * reader uses it. The buffer stays valid until the next get() of the same
+ * reader: readers call get() again at each iteration instead of keeping the
+ * pointer.
+ * </p>
+ *
+ * <p>
+ * The writer never reuses the current buffer or a buffer recorded in a slot.
+ * With READERS + 2 buffers one of them is always free, so publish() never
+ * waits, however long a reader is preempted, and the reclamation does not
+ * depend on the time.
+ * </p>
+ *
+ * <p>
+ * The values are copied and compared with memcpy and memcmp, so T must be a
+ * plain structure, cleared with memset before being filled so that the
+ * padding bytes compare equal.
+ * </p>
+ *
+ * @param T
+ *            Value type.
+ * @param READERS
+ *            Number of reader threads.
+ */
+template <class T, int READERS = 1>
+class Snapshot {
+
+public:
+    static const int BUFFERS = READERS + 2;
+
+    /**
+     * Initializes the value with zeros.
+     */
+    Snapshot() : current(&buffers[0]), version(0) {
+        memset(buffers, 0, sizeof(buffers));
+        for (int i = 0; i < READERS; i++) {
+            readers[i].store(NULL, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Current value, valid until the next call with the same reader index.
+     *
+     * @param reader
+     *            Index of the calling thread, between 0 and READERS - 1.
+     */
+    const T * get(int reader = 0) {
+        const T *value = current.load();
+        while (true) {
+            readers[reader].store(value);
+            // The buffer may have been replaced, then reused, before the slot
+            // was set: it is only safe if it is still the current one
+            const T *check = current.load();
+            if (check == value) {
+                return value;
+            }
+            value = check;
+        }
+    }
+
+    /**
+     * Number of values published so far.
+     *
+     * <p>
+     * A reader which caches data derived from the value compares the version
+     * before calling get(), so that a buffer reused at the same address is
+     * not mistaken for the value it has already seen.
+     * </p>
+     */
+    unsigned int getVersion() const {
+        return version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Publishes a new value, from the writer thread only. Never blocks.
+     *
+     * @return false if the value is the same as the current one, in which
+     *         case nothing is published.
+     */
+    bool publish(const T & value) {
+        const T *old = current.load(std::memory_order_relaxed);
+        if (!memcmp(old, &value, sizeof(T))) {
+            return false;
+        }
+        T *free = findFree(old);
+        memcpy(free, &value, sizeof(T));
+        current.store(free);
+        version.fetch_add(1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T buffers[BUFFERS];
+    // Buffer used by each reader, NULL before its first get()
+    std::atomic<const T *> readers[READERS];
+    std::atomic<const T *> current;
+    std::atomic<unsigned int> version;
+
+    T * findFree(const T *used) {
+        for (int i = 0; i < BUFFERS; i++) {
+            bool free = &buffers[i] != used;
+            for (int r = 0; r < READERS && free; r++) {
+                free = readers[r].load() != &buffers[i];
+            }
+            if (free) {
+                return &buffers[i];
+            }
+        }
+        // Not reached, at most READERS + 1 buffers are in use
+        return &buffers[0];
+    }
+};
+
+}
+}
+}
+
+#endif
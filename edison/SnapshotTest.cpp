@@ -0,0 +1,117 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SnapshotTest.h"
+#include "Snapshot.h"
+#include "Thread.h"
+#include <atomic>
+#include <stdio.h>
+#include <unistd.h>
+
+// Time a reader holds a value, in microseconds, and reads between two holds
+#define HOLD_TIME 30000
+#define HOLD_INTERVAL 1000
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+struct SequenceValue {
+    unsigned int words[64];
+};
+
+static const int READERS = 2;
+
+class SequenceReader : public Thread {
+public:
+    SequenceReader(Snapshot<SequenceValue, READERS> *snapshot, int index, int holds) :
+        snapshot(snapshot),
+        index(index),
+        holds(holds),
+        errors(0),
+        done(false)
+    {
+    }
+
+    void run()
+    {
+        unsigned int last = 0;
+        for (int i = 0; i < holds * HOLD_INTERVAL; i++) {
+            const SequenceValue *value = snapshot->get(index);
+            unsigned int sequence = value->words[0];
+            if (sequence < last) {
+                errors++;
+            }
+            last = sequence;
+            if (i % HOLD_INTERVAL == HOLD_INTERVAL - 1) {
+                usleep(HOLD_TIME);
+            }
+            for (unsigned int j = 0; j < sizeof(value->words) / sizeof(value->words[0]); j++) {
+                if (value->words[j] != sequence) {
+                    errors++;
+                    break;
+                }
+            }
+        }
+        done.store(true);
+    }
+
+    Snapshot<SequenceValue, READERS> *snapshot;
+    int index;
+    int holds;
+    int errors;
+    std::atomic<bool> done;
+};
+
+bool SnapshotTest::run(int holds)
+{
+    Snapshot<SequenceValue, READERS> snapshot;
+    SequenceReader first(&snapshot, 0, holds);
+    SequenceReader second(&snapshot, 1, holds);
+    SequenceReader *readers[READERS] = { &first, &second };
+    for (int r = 0; r < READERS; r++) {
+        readers[r]->start();
+    }
+
+    SequenceValue value;
+    unsigned int sequence = 0;
+    bool running = true;
+    while (running) {
+        sequence++;
+        for (unsigned int j = 0; j < sizeof(value.words) / sizeof(value.words[0]); j++) {
+            value.words[j] = sequence;
+        }
+        snapshot.publish(value);
+        running = false;
+        for (int r = 0; r < READERS; r++) {
+            running = running || !readers[r]->done.load();
+        }
+    }
+
+    int errors = 0;
+    for (int r = 0; r < READERS; r++) {
+        readers[r]->join();
+        errors += readers[r]->errors;
+    }
+    fprintf(stderr, "SnapshotTest: %u values published, %d inconsistent reads\n", sequence, errors);
+    return !errors;
+}
+
+}
+}
+}
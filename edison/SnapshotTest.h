@@ -0,0 +1,53 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SNAPSHOTTEST_H_
+#define _SNAPSHOTTEST_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the buffer reclamation of Snapshot.
+ *
+ * <p>
+ * The main thread publishes new values as fast as it can, while two reader
+ * threads get the current value and, from time to time, keep it for longer
+ * than any publishing period, as a preempted reader would. Each value is
+ * filled with its sequence number, so a buffer reused while a reader holds it
+ * shows up as a value which changes under the reader.
+ * </p>
+ */
+class SnapshotTest {
+public:
+    /**
+     * Runs the readers until each one has held a value the given number of
+     * times, and prints the number of values published meanwhile.
+     *
+     * @return false if a reader saw a value change, or values going
+     *         backwards.
+     */
+    static bool run(int holds);
+};
+
+}
+}
+}
+
+#endif
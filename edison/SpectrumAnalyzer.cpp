@@ -0,0 +1,180 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SpectrumAnalyzer.h"
+#include <math.h>
+
+// Weight of a new peak measurement in the smoothed peak frequency
+#define PEAK_SMOOTHING .3f
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+SpectrumAnalyzer::SpectrumAnalyzer() :
+    position(0),
+    axis(0),
+    stage(-1),
+    rate(0.f),
+    min_frequency(0.f),
+    max_frequency(0.f)
+{
+    for (int i = 0; i < SIZE; i++) {
+        hann[i] = .5f - .5f * cosf(2.f * (float)M_PI * i / SIZE);
+        int r = 0;
+        for (int b = 0; b < STAGES; b++) {
+            r |= ((i >> b) & 1) << (STAGES - 1 - b);
+        }
+        reversed[i] = r;
+    }
+    for (int i = 0; i < SIZE / 2; i++) {
+        twiddle_re[i] = cosf(2.f * (float)M_PI * i / SIZE);
+        twiddle_im[i] = -sinf(2.f * (float)M_PI * i / SIZE);
+    }
+    for (int a = 0; a < AXES; a++) {
+        for (int i = 0; i < SIZE; i++) {
+            window[a][i] = 0.f;
+        }
+    }
+    setRange(400.f, 60.f, 190.f);
+}
+
+void SpectrumAnalyzer::setRange(float rate, float min_frequency, float max_frequency)
+{
+    if (rate == this->rate && min_frequency == this->min_frequency && max_frequency == this->max_frequency) {
+        return;
+    }
+    this->rate = rate;
+    this->min_frequency = min_frequency;
+    this->max_frequency = max_frequency;
+    for (int a = 0; a < AXES; a++) {
+        peak[a] = .5f * (min_frequency + max_frequency);
+    }
+}
+
+void SpectrumAnalyzer::push(const float sample[AXES])
+{
+    for (int a = 0; a < AXES; a++) {
+        window[a][position] = sample[a];
+    }
+    position = (position + 1) % SIZE;
+}
+
+int SpectrumAnalyzer::step()
+{
+    if (stage == -1) {
+        // Copy the window of the current axis in bit reversed order, with
+        // the mean removed and a Hann window applied
+        const float *w = window[axis];
+        float mean = 0.f;
+        for (int i = 0; i < SIZE; i++) {
+            mean += w[i];
+        }
+        mean /= SIZE;
+        for (int i = 0; i < SIZE; i++) {
+            int j = reversed[i];
+            re[j] = (w[(position + i) % SIZE] - mean) * hann[i];
+            im[j] = 0.f;
+        }
+        stage = 0;
+        return -1;
+    } else if (stage < STAGES) {
+        butterflies(stage++);
+        return -1;
+    } else {
+        float frequency = findPeak();
+        int updated = axis;
+        if (frequency > 0.f) {
+            peak[axis] += PEAK_SMOOTHING * (frequency - peak[axis]);
+        } else {
+            updated = -1;
+        }
+        axis = (axis + 1) % AXES;
+        stage = -1;
+        return updated;
+    }
+}
+
+void SpectrumAnalyzer::butterflies(int stage)
+{
+    int half = 1 << stage;
+    int step = SIZE / (2 * half);
+    for (int start = 0; start < SIZE; start += 2 * half) {
+        for (int k = 0; k < half; k++) {
+            float wr = twiddle_re[k * step];
+            float wi = twiddle_im[k * step];
+            int a = start + k;
+            int b = a + half;
+            float tr = wr * re[b] - wi * im[b];
+            float ti = wr * im[b] + wi * re[b];
+            re[b] = re[a] - tr;
+            im[b] = im[a] - ti;
+            re[a] += tr;
+            im[a] += ti;
+        }
+    }
+}
+
+float SpectrumAnalyzer::findPeak()
+{
+    float resolution = rate / SIZE;
+    int first = (int)ceilf(min_frequency / resolution);
+    int last = (int)floorf(max_frequency / resolution);
+    if (first < 1) {
+        first = 1;
+    }
+    if (last > SIZE / 2 - 1) {
+        last = SIZE / 2 - 1;
+    }
+    if (first > last) {
+        return -1.f;
+    }
+
+    // Power spectrum, only for the bins of the search range and their
+    // neighbours
+    float power[SIZE / 2 + 1];
+    for (int i = first - 1; i <= last + 1; i++) {
+        power[i] = re[i] * re[i] + im[i] * im[i];
+    }
+
+    int best = first;
+    float total = 0.f;
+    for (int i = first; i <= last; i++) {
+        total += power[i];
+        if (power[i] > power[best]) {
+            best = i;
+        }
+    }
+
+    // A peak which does not stand out of the noise is not tracked
+    if (power[best] * (last - first + 1) < 2.f * total) {
+        return -1.f;
+    }
+
+    // Parabolic interpolation between the neighbour bins
+    float l = sqrtf(power[best - 1]);
+    float c = sqrtf(power[best]);
+    float r = sqrtf(power[best + 1]);
+    float d = l - 2.f * c + r;
+    float offset = d != 0.f ? .5f * (l - r) / d : 0.f;
+    return (best + offset) * resolution;
+}
+
+}
+}
+}
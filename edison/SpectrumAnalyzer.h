@@ -0,0 +1,103 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPECTRUMANALYZER_H_
+#define _SPECTRUMANALYZER_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Incremental spectrum analysis of the gyroscope rates.
+ *
+ * <p>
+ * The analyzer keeps a sliding window of the last SIZE samples of the 3 axes.
+ * The FFT of one axis is spread over several calls to step(): the windowing,
+ * each butterfly stage and the peak search are each done on a separate
+ * control tick, so that a tick never pays for more than a small part of an
+ * FFT. The axes are analyzed in turn.
+ * </p>
+ */
+class SpectrumAnalyzer {
+
+public:
+    static const int SIZE = 64;
+    static const int AXES = 3;
+
+    SpectrumAnalyzer();
+
+    /**
+     * Sets the sample rate and the frequency range of the peak search, in Hz.
+     * The peaks are reset to the middle of the range, unless the range is
+     * unchanged.
+     */
+    void setRange(float rate, float min_frequency, float max_frequency);
+
+    /**
+     * Appends a sample of the 3 axes to the window.
+     */
+    void push(const float sample[AXES]);
+
+    /**
+     * Does the next part of the analysis.
+     *
+     * @return The axis whose peak frequency has just been updated, -1 if none.
+     */
+    int step();
+
+    /**
+     * Smoothed frequency of the dominant peak of an axis, in Hz.
+     */
+    float getPeak(int axis) const {
+        return peak[axis];
+    }
+
+private:
+    static const int STAGES = 6; // log2(SIZE)
+
+    // Sliding windows
+    float window[AXES][SIZE];
+    int position;
+
+    // FFT in progress
+    float re[SIZE];
+    float im[SIZE];
+    int axis;
+    int stage;
+
+    // Precomputed tables
+    float hann[SIZE];
+    float twiddle_re[SIZE / 2];
+    float twiddle_im[SIZE / 2];
+    int reversed[SIZE];
+
+    float rate;
+    float min_frequency;
+    float max_frequency;
+    float peak[AXES];
+
+    void butterflies(int stage);
+    float findPeak();
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SPSCQUEUE_H_
+#define _SPSCQUEUE_H_
+
+#include <atomic>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Lock-free single-producer single-consumer queue.
+ *
+ * <p>
+ * One thread may call push() while another one calls pop(). The elements are
+ * copied in a fixed ring buffer, so the queue never allocates memory.
+ * </p>
+ *
+ * @param T
+ *            Element type.
+ * @param N
+ *            Capacity, must be a power of 2.
+ */
+template <class T, unsigned int N>
+class SpscQueue {
+
+public:
+    SpscQueue() : head(0), tail(0) {
+    }
+
+    /**
+     * Appends an element, called by the producer thread only.
+     *
+     * @return false if the queue is full.
+     */
+    bool push(const T & element) {
+        unsigned int t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) {
+            return false;
+        }
+        ring[t & (N - 1)] = element;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Removes the oldest element, called by the consumer thread only.
+     *
+     * @return false if the queue is empty.
+     */
+    bool pop(T & element) {
+        unsigned int h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        element = ring[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T ring[N];
+    // head and tail are on separate cache lines to avoid false sharing
+    // between the producer and the consumer
+    alignas(64) std::atomic<unsigned int> head;
+    alignas(64) std::atomic<unsigned int> tail;
+};
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,177 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SysfsPwm.h"
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+SysfsPwm::SysfsPwm(const char *chip) :
+    period_ns(0),
+    mode(UPDATE_SYNCHRONIZED),
+    write_count(0)
+{
+    snprintf(this->chip, sizeof(this->chip), "%s", chip);
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        outputs[i].channel = -1;
+        outputs[i].duty_fd = -1;
+        outputs[i].pending = 0;
+        outputs[i].current = -1;
+    }
+    memset(table, 0, sizeof(table));
+}
+
+SysfsPwm::~SysfsPwm()
+{
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        if (outputs[i].duty_fd != -1) {
+            close(outputs[i].duty_fd);
+        }
+    }
+}
+
+bool SysfsPwm::open(int output, int channel)
+{
+    if (output < 0 || output >= MAX_OUTPUTS) {
+        return false;
+    }
+    char path[192];
+    snprintf(path, sizeof(path), "%s/pwm%d/duty_cycle", chip, channel);
+    int fd = ::open(path, O_WRONLY);
+    if (fd == -1) {
+        perror(path);
+        return false;
+    }
+    Output & o = outputs[output];
+    if (o.duty_fd != -1) {
+        close(o.duty_fd);
+    }
+    o.channel = channel;
+    o.duty_fd = fd;
+    o.pending = 0;
+    o.current = -1;
+    return true;
+}
+
+bool SysfsPwm::writeAttribute(int channel, const char *attribute, int value)
+{
+    char path[192];
+    snprintf(path, sizeof(path), "%s/pwm%d/%s", chip, channel, attribute);
+    int fd = ::open(path, O_WRONLY);
+    if (fd == -1) {
+        perror(path);
+        return false;
+    }
+    char text[16];
+    int length = snprintf(text, sizeof(text), "%d", value);
+    bool ok = (::write(fd, text, length) == length);
+    if (!ok) {
+        perror(path);
+    }
+    close(fd);
+    return ok;
+}
+
+bool SysfsPwm::setPeriod(int period_ns)
+{
+    // The duty cycle must never exceed the period, so we clear it first
+    bool ok = true;
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        Output & o = outputs[i];
+        if (o.duty_fd != -1) {
+            ok &= writeAttribute(o.channel, "duty_cycle", 0);
+            ok &= writeAttribute(o.channel, "period", period_ns);
+            o.pending = 0;
+            o.current = 0;
+        }
+    }
+
+    this->period_ns = period_ns;
+    for (int i = 0; i < STEPS; i++) {
+        long long duty_ns = ((long long)period_ns * i + (STEPS - 1) / 2) / (STEPS - 1);
+        table[i].length = snprintf(table[i].text, sizeof(table[i].text), "%lld", duty_ns);
+    }
+    return ok;
+}
+
+bool SysfsPwm::enable(bool enabled)
+{
+    bool ok = true;
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        if (outputs[i].duty_fd != -1) {
+            ok &= writeAttribute(outputs[i].channel, "enable", enabled ? 1 : 0);
+        }
+    }
+    return ok;
+}
+
+void SysfsPwm::setUpdateMode(UpdateMode mode)
+{
+    this->mode = mode;
+}
+
+void SysfsPwm::write(int output, float duty)
+{
+    Output & o = outputs[output];
+    if (duty <= 0.f) {
+        o.pending = 0;
+    } else if (duty >= 1.f) {
+        o.pending = STEPS - 1;
+    } else {
+        o.pending = (int)(duty * (STEPS - 1) + .5f);
+    }
+    if (mode == UPDATE_IMMEDIATE) {
+        flush(o);
+    }
+}
+
+void SysfsPwm::update()
+{
+    if (mode != UPDATE_SYNCHRONIZED) {
+        return;
+    }
+    // All the values are ready, the writes are issued back to back to keep
+    // the skew between the outputs as small as possible
+    for (int i = 0; i < MAX_OUTPUTS; i++) {
+        flush(outputs[i]);
+    }
+}
+
+void SysfsPwm::flush(Output & o)
+{
+    if (o.duty_fd == -1 || o.pending == o.current || !period_ns) {
+        return;
+    }
+    const DutyString & s = table[o.pending];
+    write_count++;
+    if (pwrite(o.duty_fd, s.text, s.length, 0) == s.length) {
+        o.current = o.pending;
+    } else {
+        // Force a new write on the next update
+        o.current = -1;
+    }
+}
+
+}
+}
+}
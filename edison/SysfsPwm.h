@@ -0,0 +1,159 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SYSFSPWM_H_
+#define _SYSFSPWM_H_
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * PWM outputs driven through the Linux sysfs PWM interface.
+ *
+ * <p>
+ * mraa_pwm_write() opens, formats and writes the duty_cycle file on every
+ * call. This class keeps the duty_cycle files open and writes the duty cycles
+ * from a table of nanosecond strings precomputed when the period is set, so
+ * that an update costs exactly one pwrite() per modified output.
+ * </p>
+ *
+ * <p>
+ * The sysfs directory of the PWM chip is a constructor parameter, which allows
+ * running the class against a fake sysfs tree on a host computer.
+ * </p>
+ */
+class SysfsPwm {
+
+public:
+    /**
+     * Maximum number of outputs.
+     */
+    static const int MAX_OUTPUTS = 4;
+
+    /**
+     * Number of precomputed duty cycle values over one period.
+     */
+    static const int STEPS = 2048;
+
+    enum UpdateMode {
+        /**
+         * Each call to write() is immediately sent to the hardware.
+         */
+        UPDATE_IMMEDIATE,
+        /**
+         * Calls to write() are staged, and update() sends all the modified
+         * outputs back to back.
+         */
+        UPDATE_SYNCHRONIZED
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param chip
+     *            sysfs directory of the PWM chip.
+     */
+    SysfsPwm(const char *chip = "/sys/class/pwm/pwmchip0");
+    ~SysfsPwm();
+
+    /**
+     * Opens an output.
+     *
+     * <p>
+     * The channel must already be exported, either by mraa_pwm_init() or by
+     * the fake sysfs tree.
+     * </p>
+     *
+     * @param output
+     *            Output index, between 0 and MAX_OUTPUTS - 1.
+     * @param channel
+     *            PWM channel number of the chip.
+     * @return true on success.
+     */
+    bool open(int output, int channel);
+
+    /**
+     * Sets the period of all the opened outputs and rebuilds the duty cycle
+     * table. The duty cycles are reset to 0.
+     *
+     * @param period_ns
+     *            Period in nanoseconds.
+     * @return true on success.
+     */
+    bool setPeriod(int period_ns);
+
+    /**
+     * Enables or disables all the opened outputs.
+     */
+    bool enable(bool enabled);
+
+    void setUpdateMode(UpdateMode mode);
+
+    /**
+     * Sets the duty cycle of an output.
+     *
+     * @param output
+     *            Output index.
+     * @param duty
+     *            Duty cycle, between 0 and 1.
+     */
+    void write(int output, float duty);
+
+    /**
+     * Sends the staged duty cycles to the hardware, in UPDATE_SYNCHRONIZED
+     * mode. Does nothing in UPDATE_IMMEDIATE mode.
+     */
+    void update();
+
+    /**
+     * Number of write system calls issued since the creation of the object.
+     */
+    unsigned long getWriteCount() const {
+        return write_count;
+    }
+
+private:
+    struct Output {
+        int channel;
+        int duty_fd;
+        int pending; // Staged table index
+        int current; // Table index written to the hardware, -1 if unknown
+    };
+
+    struct DutyString {
+        char text[12];
+        int length;
+    };
+
+    char chip[128];
+    int period_ns;
+    UpdateMode mode;
+    unsigned long write_count;
+    Output outputs[MAX_OUTPUTS];
+    DutyString table[STEPS];
+
+    void flush(Output & output);
+    bool writeAttribute(int channel, const char *attribute, int value);
+};
+
+}
+}
+}
+
+#endif
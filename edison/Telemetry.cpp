@@ -17,89 +17,512 @@
  */
 
 #include "Telemetry.h"
+#include "FlightService.h"
 #include "Timestamp.h"
+#include <google/protobuf/io/coded_stream.h>
+#include <google/protobuf/wire_format_lite.h>
+#include <math.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
-#define DEFAULT_PORT 49152
-
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+typedef CommandPacket::TelemetryConfig TelemetryConfig;
+
+// Encoded size of a message, ByteSizeLong() replaces ByteSize() from
+// protobuf 3.1
+static inline int messageSize(const google::protobuf::MessageLite &message)
+{
+#if GOOGLE_PROTOBUF_VERSION >= 3001000
+    return (int)message.ByteSizeLong();
+#else
+    return message.ByteSize();
+#endif
+}
+
+// Encoded size of a message field of the packet, with its tag and length
+static int fieldSize(int number, const google::protobuf::MessageLite &message)
+{
+    using google::protobuf::io::CodedOutputStream;
+    using google::protobuf::internal::WireFormatLite;
+    int size = messageSize(message);
+    return CodedOutputStream::VarintSize32(WireFormatLite::MakeTag(number, WireFormatLite::WIRETYPE_LENGTH_DELIMITED))
+            + CodedOutputStream::VarintSize32(size) + size;
+}
+
+Telemetry::Telemetry(FlightService *context) :
+    hal(context->hal),
+    default_port(context->telemetry_port),
+    values(),
+    ack_sequence(0),
+    ack_count(0),
+    has_ack(false),
+    sending(),
+    tick(0),
+    ping_tick(0),
+    ping_sequence(0),
+    sequence(0),
+    rate_packets(0),
+    rate(0.)
+{
+    sem_init(&configured, 0, 0);
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        sent_versions[i] = 0;
+        sent_ticks[i] = 0;
+    }
+}
+
 void Telemetry::setConfig(const CommandPacket::TelemetryConfig &config)
 {
-    synchronized
-    bool new_host = config.has_host() && (!this->config.has_host() || this->config.host() != config.host());
-    this->config = config;
-    if (new_host) {
-        // We want to avoid doing too many DNS requests
-        socket.connect(config.host().c_str(),
-                       config.has_port() ? config.port() : DEFAULT_PORT);
-        notify();
+    TelemetrySettings s;
+    memset(&s, 0, sizeof(s));
+    if (config.has_host()) {
+        if (config.host().size() >= sizeof(s.host)) {
+            fprintf(stderr, "Telemetry: Host name too long, configuration ignored\n");
+            return;
+        }
+        strcpy(s.host, config.host().c_str());
+    }
+    s.port = config.has_port() ? config.port() : default_port;
+    s.command_enabled = config.has_commandenabled() && config.commandenabled();
+    s.attitude_enabled = config.has_attitudeenabled() && config.attitudeenabled();
+    s.control_enabled = config.has_controlenabled() && config.controlenabled();
+    s.switches_enabled = config.has_switchesenabled() && config.switchesenabled();
+    s.vibration_enabled = config.has_vibrationenabled() && config.vibrationenabled();
+    s.latency_enabled = config.has_latencyenabled() && config.latencyenabled();
+    for (int i = 0; i < TELEMETRY_FIELDS; i++) {
+        s.divisors[i] = DEFAULT_DIVISOR;
+    }
+    for (int i = 0; i < config.field_rates_size(); i++) {
+        const TelemetryConfig::FieldRate & rate = config.field_rates(i);
+        if (rate.divisor() > MAX_DIVISOR) {
+            fprintf(stderr, "Telemetry: Field divisor above %d, configuration ignored\n", MAX_DIVISOR);
+            return;
+        }
+        s.divisors[rate.field()] = (int)rate.divisor();
+        s.priorities[rate.field()] = rate.priority();
+    }
+    uint32_t mtu = config.mtu();
+    if (mtu < MIN_PACKET_SIZE || mtu > MAX_PACKET_SIZE) {
+        fprintf(stderr, "Telemetry: MTU not between %d and %d, configuration ignored\n", MIN_PACKET_SIZE, MAX_PACKET_SIZE);
+        return;
+    }
+    s.mtu = (int)mtu;
+    if (settings.publish(s)) {
+        sem_post(&configured);
+    }
+}
+
+void Telemetry::update(int field, bool changed)
+{
+    if (!values.versions[field] || changed) {
+        values.versions[field]++;
     }
 }
 
 void Telemetry::setCommand(const Attitude & command)
 {
-    synchronized
-    if (config.has_commandenabled() && config.commandenabled()) {
-        packet.mutable_command()->CopyFrom(command);
-        packet.mutable_command()->set_timestamp(Timestamp::now());
+    if (settings.get(CONTROL_READER)->command_enabled) {
+        AttitudeState c = {};
+        c.altitude = command.altitude();
+        c.roll = command.roll();
+        c.roll_rate = command.roll_rate();
+        c.pitch = command.pitch();
+        c.pitch_rate = command.pitch_rate();
+        c.yaw = command.yaw();
+        c.yaw_rate = command.yaw_rate();
+        c.has_yaw = command.has_yaw();
+        c.timestamp = hal->now();
+        synchronized
+        values.command = c;
+        update(TelemetryConfig::COMMAND, true);
     }
 }
 
-void Telemetry::setAttitude(const Attitude & attitude)
+void Telemetry::setAttitude(const AttitudeState & attitude)
 {
-    synchronized
-    if (config.has_attitudeenabled() && config.attitudeenabled())
-        packet.mutable_attitude()->CopyFrom(attitude);
+    if (settings.get(CONTROL_READER)->attitude_enabled) {
+        synchronized
+        update(TelemetryConfig::ATTITUDE, memcmp(&values.attitude, &attitude, sizeof(attitude)));
+        values.attitude = attitude;
+    }
 }
 
-void Telemetry::setControl(const MotorsControl & control)
+void Telemetry::setControl(const MotorsCommand & control)
 {
-    synchronized
-    if (config.has_controlenabled() && config.controlenabled())
-            packet.mutable_control()->CopyFrom(control);
+    if (settings.get(CONTROL_READER)->control_enabled) {
+        synchronized
+        update(TelemetryConfig::CONTROL, memcmp(&values.control, &control, sizeof(control)));
+        values.control = control;
+    }
 }
 
-void Telemetry::setSwitches(const Switches &switches)
+void Telemetry::setSwitches(const SwitchesState &switches)
 {
+    if (settings.get(CONTROL_READER)->switches_enabled) {
+        synchronized
+        update(TelemetryConfig::SWITCHES, memcmp(&values.switches, &switches, sizeof(switches)));
+        values.switches = switches;
+    }
+}
+
+void Telemetry::setVibration(const float frequencies[3])
+{
+    if (settings.get(CONTROL_READER)->vibration_enabled) {
+        synchronized
+        update(TelemetryConfig::VIBRATION, memcmp(values.vibration, frequencies, sizeof(values.vibration)));
+        for (int i = 0; i < 3; i++) {
+            values.vibration[i] = frequencies[i];
+        }
+    }
+}
+
+void Telemetry::setLatency(const LatencyState & latency)
+{
+    if (settings.get(CONTROL_READER)->latency_enabled) {
+        synchronized
+        update(TelemetryConfig::LATENCY, memcmp(&values.latency, &latency, sizeof(latency)));
+        values.latency = latency;
+    }
+}
+
+void Telemetry::acknowledge(const TelemetryAck & ack)
+{
+    unsigned int sequence = ack.sequence();
+    unsigned int count = ack.count();
     synchronized
-    if (config.has_switchesenabled() && config.switchesenabled())
-            packet.mutable_switches()->CopyFrom(switches);
+    ack_sequence = sequence;
+    ack_count = count;
+    has_ack = true;
+}
+
+// Milliradians or millimeters
+static inline int32_t milli(float value)
+{
+    return lrintf(value * 1000.f);
+}
+
+bool Telemetry::isEnabled(const TelemetrySettings & s, int field) const
+{
+    // Under congestion, only the compact attitude and the diagnostics of the
+    // link are sent
+    bool compact = link.isCompact();
+    switch (field) {
+    case TelemetryConfig::COMMAND:
+        return s.command_enabled && !compact;
+    case TelemetryConfig::ATTITUDE:
+        return s.attitude_enabled;
+    case TelemetryConfig::CONTROL:
+        return s.control_enabled && !compact;
+    case TelemetryConfig::SWITCHES:
+        return s.switches_enabled && !compact;
+    case TelemetryConfig::VIBRATION:
+        return s.vibration_enabled && !compact;
+    case TelemetryConfig::LATENCY:
+        return s.latency_enabled;
+    case TelemetryConfig::LINK:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool Telemetry::isDue(const TelemetrySettings & s, int field) const
+{
+    if (field == TelemetryConfig::LINK) {
+        // The state of the link is always known
+    } else if (!sending.versions[field]) {
+        return false;
+    }
+    if (!isEnabled(s, field)) {
+        return false;
+    }
+    if (s.divisors[field] == 0) {
+        return sending.versions[field] != sent_versions[field];
+    }
+    return tick - sent_ticks[field] >= (unsigned int)(s.divisors[field] * link.getDivisor());
+}
+
+int Telemetry::serializeField(int field)
+{
+    switch (field) {
+    case TelemetryConfig::COMMAND:
+        {
+            const AttitudeState & command = sending.command;
+            Attitude *c = packet.mutable_command();
+            c->set_altitude(command.altitude);
+            c->set_roll(command.roll);
+            c->set_roll_rate(command.roll_rate);
+            c->set_pitch(command.pitch);
+            c->set_pitch_rate(command.pitch_rate);
+            if (command.has_yaw) {
+                c->set_yaw(command.yaw);
+            }
+            c->set_yaw_rate(command.yaw_rate);
+            c->set_timestamp(command.timestamp);
+            return fieldSize(TelemetryPacket::kCommandFieldNumber, *c);
+        }
+    case TelemetryConfig::ATTITUDE:
+        {
+            const AttitudeState & attitude = sending.attitude;
+            if (link.isCompact()) {
+                CompactAttitude *a = packet.mutable_compact_attitude();
+                a->set_altitude(milli(attitude.altitude));
+                a->set_roll(milli(attitude.roll));
+                a->set_roll_rate(milli(attitude.roll_rate));
+                a->set_pitch(milli(attitude.pitch));
+                a->set_pitch_rate(milli(attitude.pitch_rate));
+                if (attitude.has_yaw) {
+                    a->set_yaw(milli(attitude.yaw));
+                }
+                a->set_yaw_rate(milli(attitude.yaw_rate));
+                a->set_timestamp((uint32_t)((int64_t)attitude.timestamp.t.tv_sec * 1000 + attitude.timestamp.t.tv_nsec / 1000000));
+                return fieldSize(TelemetryPacket::kCompactAttitudeFieldNumber, *a);
+            } else {
+                Attitude *a = packet.mutable_attitude();
+                a->set_altitude(attitude.altitude);
+                a->set_roll(attitude.roll);
+                a->set_roll_rate(attitude.roll_rate);
+                a->set_pitch(attitude.pitch);
+                a->set_pitch_rate(attitude.pitch_rate);
+                if (attitude.has_yaw) {
+                    a->set_yaw(attitude.yaw);
+                }
+                a->set_yaw_rate(attitude.yaw_rate);
+                a->set_timestamp(attitude.timestamp);
+                return fieldSize(TelemetryPacket::kAttitudeFieldNumber, *a);
+            }
+        }
+    case TelemetryConfig::CONTROL:
+        {
+            MotorsControl *c = packet.mutable_control();
+            c->set_altitude_throttle(sending.control.altitude_throttle);
+            c->set_roll_throttle(sending.control.roll_throttle);
+            c->set_pitch_throttle(sending.control.pitch_throttle);
+            c->set_yaw_throttle(sending.control.yaw_throttle);
+            c->set_timestamp(sending.control.timestamp);
+            return fieldSize(TelemetryPacket::kControlFieldNumber, *c);
+        }
+    case TelemetryConfig::SWITCHES:
+        {
+            Switches *s = packet.mutable_switches();
+            s->set_front_left(sending.switches.front_left);
+            s->set_front_right(sending.switches.front_right);
+            s->set_back_right(sending.switches.back_right);
+            s->set_back_left(sending.switches.back_left);
+            return fieldSize(TelemetryPacket::kSwitchesFieldNumber, *s);
+        }
+    case TelemetryConfig::VIBRATION:
+        {
+            Vibration *v = packet.mutable_vibration();
+            v->set_roll_frequency(sending.vibration[0]);
+            v->set_pitch_frequency(sending.vibration[1]);
+            v->set_yaw_frequency(sending.vibration[2]);
+            return fieldSize(TelemetryPacket::kVibrationFieldNumber, *v);
+        }
+    case TelemetryConfig::LATENCY:
+        {
+            Latency *l = packet.mutable_latency();
+            l->set_clock_offset(sending.latency.clock_offset);
+            l->set_clock_skew(sending.latency.clock_skew);
+            l->set_round_trip(sending.latency.round_trip);
+            l->set_count(sending.latency.count);
+            l->set_p50(sending.latency.p50);
+            l->set_p90(sending.latency.p90);
+            l->set_p99(sending.latency.p99);
+            l->set_max(sending.latency.max);
+            return fieldSize(TelemetryPacket::kLatencyFieldNumber, *l);
+        }
+    case TelemetryConfig::LINK:
+        {
+            LinkState *l = packet.mutable_link();
+            l->set_level(link.getLevel());
+            l->set_rate(rate);
+            l->set_loss(link.getLoss());
+            l->set_queued(link.getQueued());
+            l->set_errors(link.getErrors());
+            return fieldSize(TelemetryPacket::kLinkFieldNumber, *l);
+        }
+    }
+    return 0;
+}
+
+void Telemetry::clearField(int field)
+{
+    switch (field) {
+    case TelemetryConfig::COMMAND:
+        packet.clear_command();
+        break;
+    case TelemetryConfig::ATTITUDE:
+        packet.clear_attitude();
+        packet.clear_compact_attitude();
+        break;
+    case TelemetryConfig::CONTROL:
+        packet.clear_control();
+        break;
+    case TelemetryConfig::SWITCHES:
+        packet.clear_switches();
+        break;
+    case TelemetryConfig::VIBRATION:
+        packet.clear_vibration();
+        break;
+    case TelemetryConfig::LATENCY:
+        packet.clear_latency();
+        break;
+    case TelemetryConfig::LINK:
+        packet.clear_link();
+        break;
+    }
+}
+
+int Telemetry::serialize()
+{
+    const TelemetrySettings *s = settings.get(TELEMETRY_READER);
+
+    // Copy the values, the packet is built without the lock
+    {
+        synchronized
+        sending = values;
+    }
+
+    // Fields due at this tick, by decreasing priority
+    int due[TELEMETRY_FIELDS];
+    int count = 0;
+    for (int field = 0; field < TELEMETRY_FIELDS; field++) {
+        if (isDue(*s, field)) {
+            int i = count++;
+            while (i > 0 && s->priorities[due[i - 1]] < s->priorities[field]) {
+                due[i] = due[i - 1];
+                i--;
+            }
+            due[i] = field;
+        }
+    }
+    bool ping = s->latency_enabled && tick - ping_tick >= PING_DIVISOR;
+    if (count == 0 && !ping) {
+        return 0;
+    }
+
+    // The fields keep their memory when the packet is cleared
+    packet.Clear();
+    packet.set_sequence(sequence + 1);
+    if (ping) {
+        ClockPing *p = packet.mutable_ping();
+        p->set_sequence(++ping_sequence);
+        p->set_air_time(0.);
+        ping_tick = tick;
+    }
+
+    // Pack the fields up to the MTU, the others wait for the next tick. The
+    // size is summed field by field, instead of measuring the whole packet
+    // again after each one
+    int size = messageSize(packet);
+    int packed = 0;
+    for (int i = 0; i < count; i++) {
+        int field_size = serializeField(due[i]);
+        if (size + field_size > s->mtu) {
+            clearField(due[i]);
+            continue;
+        }
+        size += field_size;
+        sent_ticks[due[i]] = tick;
+        sent_versions[due[i]] = sending.versions[due[i]];
+        packed++;
+    }
+    if (packed == 0 && !ping) {
+        return 0;
+    }
+    sequence++;
+
+    // Clock ping, stamped as late as possible
+    if (ping) {
+        packet.mutable_ping()->set_air_time(hal->now());
+    }
+    if (!packet.SerializeToArray(data, s->mtu)) {
+        return -1;
+    }
+    return packet.GetCachedSize();
 }
 
 void Telemetry::run()
 {
     fprintf(stderr, "Telemetry: Thread started\n");
+    char host[sizeof(TelemetrySettings::host)] = "";
+    int port = 0;
+    unsigned int handled = 0;
 
     while(true) {
         // Wait for the telemetry to be configured
-        {
-            synchronized
-            while(!config.has_host()) {
-                wait();
+        while (settings.getVersion() == handled) {
+            while (sem_wait(&configured) == -1) {
+                // Interrupted by a signal
             }
         }
+        handled = settings.getVersion();
+        const TelemetrySettings *s = settings.get(TELEMETRY_READER);
+        if (!s->host[0]) {
+            continue;
+        }
+        if (strcmp(host, s->host) || port != s->port) {
+            strcpy(host, s->host);
+            port = s->port;
+            // We want to avoid doing too many DNS requests
+            socket.connect(host, port);
+            link.reset();
+        }
         fprintf(stderr,
                 "Telemetry: Telemetry requested by %s\n",
-                config.host().c_str());
+                host);
 
         // Main connection loop
+        int level = link.getLevel();
+        bool unreachable = link.isUnreachable();
         while (true) {
-            // Send a telemetry packet
+            // Send the fields due at this tick
+            tick++;
+            link.tick();
+            int size = serialize();
+            if (size == -1) {
+                fprintf(stderr, "Telemetry: Cannot serialize the telemetry packet\n");
+            } else if (size > 0) {
+                bool sent = socket.send(data, size);
+                link.sent(sent ? 0 : socket.getError(), socket.getQueued());
+                rate_packets++;
+            }
+            if (tick % RATE_DIVISOR == 0) {
+                rate = rate_packets * 1.e6f / (PERIOD * RATE_DIVISOR);
+                rate_packets = 0;
+            }
+            if (link.isUnreachable() != unreachable) {
+                unreachable = link.isUnreachable();
+                fprintf(stderr, unreachable ? "Telemetry: %s unreachable\n" : "Telemetry: %s reachable\n", host);
+            }
+            if (link.getLevel() != level) {
+                level = link.getLevel();
+                fprintf(stderr, "Telemetry: Link level %d, field periods multiplied by %d\n",
+                        level, link.getDivisor());
+            }
+            bool acknowledged;
+            unsigned int ack_sequence, ack_count;
             {
                 synchronized
-                std::string data = packet.SerializeAsString();
-                if (socket.send(data.c_str(), data.length()) == -1) {
-                    // The telemetry client is not here anymore, wait for another one to register
-                    config.clear_host();
-                    break;
-                }
+                acknowledged = has_ack;
+                ack_sequence = this->ack_sequence;
+                ack_count = this->ack_count;
+                has_ack = false;
+            }
+            if (acknowledged) {
+                link.acknowledged(ack_sequence, ack_count);
+            }
+            if (settings.getVersion() != handled) {
+                // New configuration
+                break;
             }
             // Sleep
-            usleep(50000);
+            usleep(PERIOD);
         }
     }
 }
@@ -23,25 +23,188 @@
 #include "DatagramSocket.h"
 #include "Thread.h"
 #include "Object.h"
+#include "Snapshot.h"
+#include "FlightData.h"
+#include "Hal.h"
+#include "LinkAdaptation.h"
+#include <semaphore.h>
 
 namespace org {
 namespace hummingdroid {
 namespace flightapp {
 
+class FlightService;
+
+/**
+ * Number of scheduled telemetry fields, see TelemetryConfig.Field.
+ */
+static const int TELEMETRY_FIELDS = CommandPacket::TelemetryConfig::Field_ARRAYSIZE;
+
+/**
+ * Telemetry configuration, flattened from TelemetryConfig.
+ */
+struct TelemetrySettings {
+    char host[64]; // Empty if the telemetry is disabled
+    int port;
+    bool command_enabled;
+    bool attitude_enabled;
+    bool control_enabled;
+    bool switches_enabled;
+    bool vibration_enabled;
+    bool latency_enabled;
+    // Ticks between two sends of each field, 0 when sent on change only, and
+    // their priorities
+    int divisors[TELEMETRY_FIELDS];
+    int priorities[TELEMETRY_FIELDS];
+    int mtu;
+};
+
+/**
+ * Telemetry sender.
+ *
+ * <p>
+ * The setters copy the latest values, which are sent by the telemetry thread.
+ * The values given by the control loop are plain structures, copied under the
+ * lock without any heap allocation. At each tick the telemetry thread copies
+ * them in turn under the lock, then builds the protobuf packet and serializes
+ * it in a fixed buffer without the lock, so that the control loop never
+ * waits for the serialization. The configuration is published as an
+ * immutable snapshot, so that the setters only take the lock for the enabled
+ * values, and the telemetry thread resolves the host itself. setConfig() is
+ * applied by the control thread, so it takes no lock: it posts a semaphore,
+ * and the sending loop polls the version of the snapshot.
+ * </p>
+ *
+ * <p>
+ * The telemetry thread ticks every PERIOD. Each field has its own divisor of
+ * the tick rate, or is only sent when it changes, and a priority. At each
+ * tick the due fields are packed by decreasing priority until the packet
+ * reaches the configured MTU, the others stay due for the next tick, and
+ * nothing is sent if no field is due. Only the fields which are sent are
+ * serialized.
+ * </p>
+ *
+ * <p>
+ * The rate and the encoding adapt to the link, see LinkAdaptation: under
+ * congestion, only a compact attitude is sent, at a lower rate, so that the
+ * telemetry does not compete with the commands. An unreachable ground station
+ * is probed at the lowest rate until it comes back or another one is
+ * configured.
+ * </p>
+ */
 class Telemetry : public Thread, public Object {
+    // Drives serialize() without the thread
+    friend class TelemetryTest;
 
 public:
+    Telemetry(FlightService *context);
     void setConfig(const CommandPacket::TelemetryConfig & config);
     void setCommand(const Attitude & command);
-    void setAttitude(const Attitude & attitude);
-    void setControl(const MotorsControl & control);
-    void setSwitches(const Switches & switches);
+    void setAttitude(const AttitudeState & attitude);
+    void setControl(const MotorsCommand & control);
+    void setSwitches(const SwitchesState & switches);
+    // Peak frequencies of the roll, pitch and yaw rates
+    void setVibration(const float frequencies[3]);
+
+    /**
+     * Clock synchronization and command latency, the telemetry also sends
+     * the clock pings when enabled.
+     */
+    void setLatency(const LatencyState & latency);
+
+    /**
+     * Telemetry acknowledgement of the ground station.
+     */
+    void acknowledge(const TelemetryAck & ack);
+
     // Thread entry point, do not call directly
     void run();
 private:
+    // Largest MTU, an Ethernet frame without the IP and UDP headers
+    static const int MAX_PACKET_SIZE = 1472;
+
+    // Smallest MTU, above the largest packet holding the sequence, a clock
+    // ping and the state of the link
+    static const int MIN_PACKET_SIZE = 64;
+
+    // Tick period in microseconds, the fastest rate of a field
+    static const int PERIOD = 10000;
+
+    // Default divisor of the fields, 20 Hz
+    static const int DEFAULT_DIVISOR = 5;
+
+    // Largest divisor of a field, ten minutes, so that the period of the
+    // field multiplied by the divisor of LinkAdaptation fits in an int
+    static const int MAX_DIVISOR = 60000;
+
+    // Ticks between two clock pings
+    static const int PING_DIVISOR = 20;
+
+    // Ticks between two measures of the packet rate
+    static const int RATE_DIVISOR = 100;
+
+    Hal *hal;
+    // Port of the ground station when the configuration has none
+    int default_port;
+
+    // Threads reading the settings
+    enum {
+        CONTROL_READER, // Setters
+        TELEMETRY_READER,
+        READERS
+    };
+
     DatagramSocket socket;
-    CommandPacket::TelemetryConfig config;
+    Snapshot<TelemetrySettings, READERS> settings;
+    // Posted by setConfig(), which never blocks the control thread, to wake
+    // up the telemetry thread waiting for its first configuration
+    sem_t configured;
+
+    // Values given by the setters
+    struct Values {
+        AttitudeState command;
+        AttitudeState attitude;
+        MotorsCommand control;
+        SwitchesState switches;
+        float vibration[3];
+        LatencyState latency;
+        // Incremented when a value is set for the first time or changes, 0
+        // until it is set
+        unsigned int versions[TELEMETRY_FIELDS];
+    };
+
+    // Latest values, protected by the lock
+    Values values;
+
+    // Last acknowledgement, not yet given to the link adaptation, protected
+    // by the lock
+    unsigned int ack_sequence;
+    unsigned int ack_count;
+    bool has_ack;
+
+    // Telemetry thread only
+    Values sending; // Copy of the values at the current tick
     TelemetryPacket packet;
+    char data[MAX_PACKET_SIZE];
+    unsigned int tick;
+    unsigned int sent_versions[TELEMETRY_FIELDS];
+    unsigned int sent_ticks[TELEMETRY_FIELDS];
+    unsigned int ping_tick;
+    unsigned int ping_sequence;
+    unsigned int sequence;
+    unsigned int rate_packets;
+    float rate;
+    LinkAdaptation link;
+
+    // Updates a value from a setter, with the lock
+    void update(int field, bool changed);
+    bool isDue(const TelemetrySettings & settings, int field) const;
+    bool isEnabled(const TelemetrySettings & settings, int field) const;
+    // Adds a field to the packet, returns its encoded size
+    int serializeField(int field);
+    void clearField(int field);
+    // Size of the packet, 0 if nothing is due
+    int serialize();
 };
 
 }
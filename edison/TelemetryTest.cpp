@@ -0,0 +1,256 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TelemetryTest.h"
+#include "FlightService.h"
+#include "SimulatedVehicle.h"
+#include <stdio.h>
+
+// Divisors of the fields checked at each tick
+#define ATTITUDE_DIVISOR 2
+#define CONTROL_DIVISOR 5
+#define LINK_DIVISOR 10
+
+// MTUs of the priority check, the smallest one holds a single field and the
+// largest one all of them
+#define SMALL_MTU 64
+#define LARGE_MTU 1472
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+typedef CommandPacket::TelemetryConfig TelemetryConfig;
+
+// Configuration sending the command, the attitude, the control and the
+// switches, the host is empty
+static void getConfig(TelemetryConfig & config, int mtu)
+{
+    config.set_host("");
+    config.set_port(FlightService::DEFAULT_TELEMETRY_PORT);
+    config.set_commandenabled(true);
+    config.set_attitudeenabled(true);
+    config.set_controlenabled(true);
+    config.set_switchesenabled(true);
+    config.set_vibrationenabled(false);
+    config.set_latencyenabled(false);
+    config.set_mtu(mtu);
+}
+
+static void addRate(TelemetryConfig & config, TelemetryConfig::Field field, unsigned int divisor, int priority)
+{
+    TelemetryConfig::FieldRate *rate = config.add_field_rates();
+    rate->set_field(field);
+    rate->set_divisor(divisor);
+    rate->set_priority(priority);
+}
+
+static AttitudeState getAttitude(float roll)
+{
+    AttitudeState attitude = {};
+    attitude.roll = roll;
+    return attitude;
+}
+
+static MotorsCommand getControl(float throttle)
+{
+    MotorsCommand control = {};
+    control.altitude_throttle = throttle;
+    return control;
+}
+
+int TelemetryTest::tick(Telemetry & telemetry, TelemetryPacket & packet)
+{
+    telemetry.tick++;
+    int size = telemetry.serialize();
+    packet.Clear();
+    if (size > 0 && !packet.ParseFromArray(telemetry.data, size)) {
+        fprintf(stderr, "TelemetryTest: Cannot parse the packet of tick %u\n", telemetry.tick);
+        return -1;
+    }
+    return size;
+}
+
+bool TelemetryTest::checkDivisors(Telemetry & telemetry, int ticks)
+{
+    TelemetryConfig config;
+    getConfig(config, LARGE_MTU);
+    addRate(config, TelemetryConfig::ATTITUDE, ATTITUDE_DIVISOR, 0);
+    addRate(config, TelemetryConfig::CONTROL, CONTROL_DIVISOR, 0);
+    addRate(config, TelemetryConfig::SWITCHES, 0, 0);
+    addRate(config, TelemetryConfig::LINK, LINK_DIVISOR, 0);
+    telemetry.setConfig(config);
+
+    // The switches change once, halfway, and are set again without change
+    // before
+    SwitchesState switches = {};
+    telemetry.setControl(getControl(.5f));
+    telemetry.setSwitches(switches);
+    TelemetryPacket packet;
+    for (int i = 1; i <= ticks; i++) {
+        telemetry.setAttitude(getAttitude(i * .001f));
+        if (i == ticks / 4) {
+            telemetry.setSwitches(switches);
+        } else if (i == ticks / 2 + 1) {
+            switches.front_left = true;
+            telemetry.setSwitches(switches);
+        }
+        int size = tick(telemetry, packet);
+        if (size < 0) {
+            return false;
+        }
+        bool attitude = i % ATTITUDE_DIVISOR == 0;
+        bool control = i % CONTROL_DIVISOR == 0;
+        bool link = i % LINK_DIVISOR == 0;
+        bool sent_switches = i == 1 || i == ticks / 2 + 1;
+        if (packet.has_attitude() != attitude || packet.has_control() != control
+                || packet.has_link() != link || packet.has_switches() != sent_switches
+                || packet.has_command() || (size > 0) != (attitude || control || link || sent_switches)) {
+            fprintf(stderr, "TelemetryTest: Tick %d sends%s%s%s%s%s, instead of%s%s%s%s\n", i,
+                    packet.has_attitude() ? " attitude" : "", packet.has_control() ? " control" : "",
+                    packet.has_link() ? " link" : "", packet.has_switches() ? " switches" : "",
+                    packet.has_command() ? " command" : "",
+                    attitude ? " attitude" : "", control ? " control" : "",
+                    link ? " link" : "", sent_switches ? " switches" : "");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TelemetryTest::checkPriorities(Telemetry & telemetry)
+{
+    // Sent on change only, by priorities opposite to the order of the
+    // fields. The state of the link has no version, so it is never sent
+    TelemetryConfig config;
+    getConfig(config, SMALL_MTU);
+    addRate(config, TelemetryConfig::COMMAND, 0, 1);
+    addRate(config, TelemetryConfig::ATTITUDE, 0, 3);
+    addRate(config, TelemetryConfig::CONTROL, 0, 2);
+    addRate(config, TelemetryConfig::LINK, 0, 0);
+    telemetry.setConfig(config);
+
+    Attitude command;
+    command.set_roll(.1f);
+    command.set_pitch(.1f);
+    command.set_yaw_rate(0.f);
+    command.set_timestamp(0.);
+    telemetry.setCommand(command);
+    telemetry.setAttitude(getAttitude(.1f));
+    telemetry.setControl(getControl(.5f));
+
+    // One field per packet, the others are deferred
+    const TelemetryConfig::Field order[] = {
+        TelemetryConfig::ATTITUDE, TelemetryConfig::CONTROL, TelemetryConfig::COMMAND
+    };
+    TelemetryPacket packet;
+    for (int i = 0; i < 3; i++) {
+        int size = tick(telemetry, packet);
+        int fields = packet.has_command() + packet.has_attitude() + packet.has_control() + packet.has_link();
+        bool expected = (order[i] == TelemetryConfig::COMMAND && packet.has_command())
+                || (order[i] == TelemetryConfig::ATTITUDE && packet.has_attitude())
+                || (order[i] == TelemetryConfig::CONTROL && packet.has_control());
+        if (size <= 0 || size > SMALL_MTU || fields != 1 || !expected) {
+            fprintf(stderr, "TelemetryTest: Packet %d of %d bytes with %d field(s), instead of field %d alone\n",
+                    i + 1, size, fields, order[i]);
+            return false;
+        }
+    }
+    if (tick(telemetry, packet) != 0) {
+        fprintf(stderr, "TelemetryTest: Packet sent after the deferred fields\n");
+        return false;
+    }
+
+    // The same fields fit in a single packet of the largest MTU
+    getConfig(config, LARGE_MTU);
+    telemetry.setConfig(config);
+    telemetry.setCommand(command);
+    telemetry.setAttitude(getAttitude(.2f));
+    telemetry.setControl(getControl(.6f));
+    int size = tick(telemetry, packet);
+    if (size <= SMALL_MTU || !packet.has_command() || !packet.has_attitude() || !packet.has_control()) {
+        fprintf(stderr, "TelemetryTest: Fields of %d bytes not sent together\n", size);
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryTest::checkLimits(Telemetry & telemetry)
+{
+    // The largest divisor is accepted, and the field waits for it
+    TelemetryConfig config;
+    getConfig(config, LARGE_MTU);
+    addRate(config, TelemetryConfig::ATTITUDE, Telemetry::MAX_DIVISOR, 0);
+    addRate(config, TelemetryConfig::LINK, 0, 0);
+    unsigned int version = telemetry.settings.getVersion();
+    telemetry.setConfig(config);
+    if (telemetry.settings.getVersion() == version) {
+        fprintf(stderr, "TelemetryTest: Divisor %d ignored\n", Telemetry::MAX_DIVISOR);
+        return false;
+    }
+    telemetry.setAttitude(getAttitude(.1f));
+    telemetry.tick = telemetry.sent_ticks[TelemetryConfig::ATTITUDE] + Telemetry::MAX_DIVISOR - 2;
+    TelemetryPacket packet;
+    if (tick(telemetry, packet) != 0 || tick(telemetry, packet) <= 0 || !packet.has_attitude()) {
+        fprintf(stderr, "TelemetryTest: Attitude not sent after %d ticks\n", Telemetry::MAX_DIVISOR);
+        return false;
+    }
+
+    // Larger ones, which would be negative or overflow once multiplied by the
+    // divisor of the link, are rejected
+    const unsigned int invalid[] = { Telemetry::MAX_DIVISOR + 1, 1u << 28, 1u << 31, 0xffffffffu };
+    for (unsigned int i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        config.clear_field_rates();
+        addRate(config, TelemetryConfig::ATTITUDE, invalid[i], 0);
+        version = telemetry.settings.getVersion();
+        telemetry.setConfig(config);
+        if (telemetry.settings.getVersion() != version) {
+            fprintf(stderr, "TelemetryTest: Divisor %u accepted\n", invalid[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TelemetryTest::run(int ticks)
+{
+    VehicleParameters parameters;
+    VehicleParameters::nominal(parameters);
+    SimulatedVehicle vehicle(parameters, 1);
+    bool passed;
+    {
+        FlightService service(&vehicle);
+        passed = checkDivisors(service.telemetry, ticks);
+    }
+    if (passed) {
+        FlightService service(&vehicle);
+        passed = checkPriorities(service.telemetry);
+    }
+    if (passed) {
+        FlightService service(&vehicle);
+        passed = checkLimits(service.telemetry);
+    }
+    if (passed) {
+        fprintf(stderr, "TelemetryTest: %d ticks at the field divisors, fields deferred by priority under a %d bytes MTU, divisors up to %d\n",
+                ticks, SMALL_MTU, Telemetry::MAX_DIVISOR);
+    }
+    return passed;
+}
+
+}
+}
+}
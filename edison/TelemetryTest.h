@@ -0,0 +1,63 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _TELEMETRYTEST_H_
+#define _TELEMETRYTEST_H_
+
+#include "Telemetry.h"
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Test of the packing of the telemetry fields.
+ *
+ * <p>
+ * The ticks of the telemetry thread are driven by hand, and each packet given
+ * by serialize() is parsed back: the fields must be sent at their divisor of
+ * the tick rate, the on-change ones only after a new value, and under a small
+ * MTU the due fields must go out one per packet by decreasing priority, the
+ * others waiting for the next tick. The configurations with a divisor above
+ * Telemetry::MAX_DIVISOR must be ignored.
+ * </p>
+ */
+class TelemetryTest {
+public:
+    /**
+     * Runs the checks, and prints the first one which fails.
+     *
+     * @return false if a field is sent at the wrong tick or in the wrong
+     *         order, if a packet exceeds the MTU, or if an invalid divisor is
+     *         accepted.
+     */
+    static bool run(int ticks);
+
+private:
+    // Next tick of the telemetry thread, the packet is cleared if nothing is
+    // sent. Returns the size given by serialize()
+    static int tick(Telemetry & telemetry, TelemetryPacket & packet);
+    static bool checkDivisors(Telemetry & telemetry, int ticks);
+    static bool checkPriorities(Telemetry & telemetry);
+    static bool checkLimits(Telemetry & telemetry);
+};
+
+}
+}
+}
+
+#endif
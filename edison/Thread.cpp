@@ -1,5 +1,8 @@
 #include "Thread.h"
 #include "pthread.h"
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
 
 static void *start_routine (void *obj)
 {
@@ -7,8 +10,37 @@ static void *start_routine (void *obj)
     return 0;
 }
 
-void Thread::start()
+void Thread::start(int cpu)
 {
-    pthread_t thread;
-    pthread_create(&thread, NULL, start_routine, this);
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    if (cpu != -1) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpu, &cpuset);
+        pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+    }
+    if (pthread_create(&thread, &attr, start_routine, this) && cpu != -1) {
+        fprintf(stderr, "Thread: cannot start on CPU %d, starting unpinned\n", cpu);
+        pthread_create(&thread, NULL, start_routine, this);
+    }
+    pthread_attr_destroy(&attr);
+}
+
+void Thread::join()
+{
+    pthread_join(thread, NULL);
+}
+
+bool Thread::setAffinity(int cpu)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    int error = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+    if (error) {
+        fprintf(stderr, "Thread: cannot run on CPU %d: %s\n", cpu, strerror(error));
+        return false;
+    }
+    return true;
 }
@@ -1,11 +1,23 @@
 #ifndef THREAD_H
 #define THREAD_H
 
+#include <pthread.h>
+
 class Thread
 {
 public:
-    void start();
+    // Starts the thread, pinned to the given CPU if cpu is not -1
+    void start(int cpu = -1);
     virtual void run() = 0;
+
+    // Waits for the end of the run() method
+    void join();
+
+    // Pins the calling thread to a CPU
+    static bool setAffinity(int cpu);
+
+private:
+    pthread_t thread;
 };
 
 #endif // THREAD_H
@@ -88,6 +88,12 @@ void Derivator::derive(const Value & value)
     this->timestamp = value.timestamp;
 }
 
+void Derivator::reset()
+{
+    Value::reset();
+    prev = 0.0 / 0.0;
+}
+
 // ///////////////////////////////////////////////
 // LOW PASS FILTER
 // ///////////////////////////////////////////////
@@ -103,6 +109,9 @@ void LowPass::lowpass(const Value & value) {
     if (!T) {
         // No filter
         this->value = value.value;
+    } else if (!timestamp.t.tv_sec && !timestamp.t.tv_nsec) {
+        // First value after a reset
+        this->value = value.value;
     } else {
         float K = (value.timestamp - this->timestamp) * 2.3 / T;
         if (!isnan(K)) {
@@ -132,36 +141,68 @@ void HighPass::highpass(const Value & value) {
 // PID
 // ///////////////////////////////////////////////
 
+bool loadGains(const hummingdroid::PID & params, PIDGains & gains) {
+    if (!params.IsInitialized()) {
+        return false;
+    }
+    gains.kp = params.kp();
+    gains.ki = params.ki();
+    gains.kd = params.kd();
+    gains.ko = params.ko();
+    gains.td = params.td();
+    return isfinite(gains.kp) && isfinite(gains.ki) && isfinite(gains.kd) &&
+            isfinite(gains.ko) && isfinite(gains.td) && gains.td >= 0.;
+}
+
+PID::PID() :
+    configured(false)
+{
+}
+
 void PID::setParams(const hummingdroid::PID & params) {
+    PIDGains gains;
+    if (!loadGains(params, gains)) {
+        synchronized
+        configured = false;
+        return;
+    }
+    setGains(gains);
+}
+
+void PID::setGains(const PIDGains & gains) {
     synchronized
-    this->params = params;
-    low_pass.setT(params.td());
+    this->gains = gains;
+    configured = true;
+    low_pass.setT(gains.td);
 }
 
 void PID::pid(Value value) {
     synchronized
-    if (!params.IsInitialized()) {
+    if (!configured) {
         return;
     }
     // P
-    propo.amplify(value, params.kp());
+    propo.amplify(value, gains.kp);
     // I
     integ.integrate(value);
-    float max = 1. / params.ki();
+    float max = 1. / gains.ki;
     integ.limit(-max, max);
-    integ_factor.amplify(integ, params.ki());
+    integ_factor.amplify(integ, gains.ki);
     // D
     low_pass.lowpass(value);
     deriv.derive(low_pass);
-    deriv_factor.amplify(deriv, params.kd());
+    deriv_factor.amplify(deriv, gains.kd);
     // Sum
-    this->value = propo.value + integ_factor.value + deriv_factor.value + params.ko();
+    this->value = propo.value + integ_factor.value + deriv_factor.value + gains.ko;
     this->timestamp = value.timestamp;
 }
 
 void PID::reset() {
     synchronized
     integ.reset();
+    low_pass.reset();
+    deriv.reset();
+    Value::reset();
 }
 
 Integrator::Integrator() : prev(0.0 / 0.0)
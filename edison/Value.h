@@ -61,6 +61,7 @@ private:
 public:
     Derivator();
     void derive(const Value & value);
+    void reset();
 };
 
 class Integrator : public Value {
@@ -91,6 +92,25 @@ public:
     void highpass(const Value & value);
 };
 
+/**
+ * PID coefficients, see the PID message.
+ */
+struct PIDGains {
+    float kp;
+    float ki;
+    float kd;
+    float ko;
+    float td;
+};
+
+/**
+ * Copies the coefficients of a PID message.
+ *
+ * @return false if the message is incomplete or a coefficient is not finite
+ *         or the derivative time constant is negative.
+ */
+bool loadGains(const hummingdroid::PID & params, PIDGains & gains);
+
 class PID : public Object, public Value {
 private:
     Value propo;
@@ -99,10 +119,13 @@ private:
     LowPass low_pass;
     Derivator deriv;
     Value deriv_factor;
-    hummingdroid::PID params;
+    PIDGains gains;
+    bool configured;
 
 public:
+    PID();
     void setParams(const hummingdroid::PID & params);
+    void setGains(const PIDGains & gains);
     void pid(Value value);
     void reset();
 };
@@ -0,0 +1,106 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "WorkStealingRunner.h"
+#include <unistd.h>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+WorkStealingRunner::WorkStealingRunner(int workers) :
+    task(0)
+{
+    int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    worker_count = workers > 0 ? workers : cpus;
+    // One worker per CPU, otherwise the scheduler places them
+    pinned = worker_count <= cpus;
+    this->workers = new Worker[worker_count];
+    for (int i = 0; i < worker_count; i++) {
+        this->workers[i].runner = this;
+        this->workers[i].id = i;
+    }
+}
+
+WorkStealingRunner::~WorkStealingRunner()
+{
+    delete[] workers;
+}
+
+int WorkStealingRunner::getWorkers() const
+{
+    return worker_count;
+}
+
+void WorkStealingRunner::run(Task &task, int count)
+{
+    this->task = &task;
+    for (int i = 0; i < worker_count; i++) {
+        workers[i].next = (int)((long)count * i / worker_count);
+        workers[i].end = (int)((long)count * (i + 1) / worker_count);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        workers[i].start(pinned ? i : -1);
+    }
+    for (int i = 0; i < worker_count; i++) {
+        workers[i].join();
+    }
+    this->task = 0;
+}
+
+bool WorkStealingRunner::steal(int &index)
+{
+    while (true) {
+        // Victim with the most remaining indexes
+        Worker *victim = 0;
+        int remaining = 0;
+        for (int i = 0; i < worker_count; i++) {
+            int r = workers[i].end - workers[i].next.load(std::memory_order_relaxed);
+            if (r > remaining) {
+                remaining = r;
+                victim = &workers[i];
+            }
+        }
+        if (!victim) {
+            return false;
+        }
+        index = victim->next.fetch_add(1);
+        if (index < victim->end) {
+            return true;
+        }
+        // Taken by another worker meanwhile
+    }
+}
+
+void WorkStealingRunner::Worker::run()
+{
+    int index;
+    while ((index = next.fetch_add(1)) < end) {
+        runner->task->execute(index);
+    }
+    while (runner->steal(index)) {
+        runner->task->execute(index);
+    }
+}
+
+}
+}
+}
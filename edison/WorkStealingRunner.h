@@ -0,0 +1,91 @@
+/*
+ * HummingDroid, Android QuadCopter Controller
+ * Copyright (C) 2013 Cedric Priscal
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WORKSTEALINGRUNNER_H_
+#define _WORKSTEALINGRUNNER_H_
+
+#include "Thread.h"
+#include <atomic>
+
+namespace org {
+namespace hummingdroid {
+namespace flightapp {
+
+/**
+ * Runs independent tasks on all the CPUs of the host.
+ *
+ * <p>
+ * The task indexes are split in one contiguous range per worker. Each worker
+ * takes the indexes of its own range in order, then steals the next indexes
+ * of the worker which has the most remaining, so that the CPUs stay busy
+ * until the end even when the tasks have very different durations. An index
+ * is claimed with a single atomic increment, by its owner or by a thief.
+ * </p>
+ */
+class WorkStealingRunner {
+public:
+    /**
+     * Work to do for each index.
+     */
+    class Task {
+    public:
+        virtual ~Task() {}
+        // Called once for each index, from any worker thread
+        virtual void execute(int index) = 0;
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param workers
+     *            Number of worker threads, 0 for one per online CPU.
+     */
+    WorkStealingRunner(int workers = 0);
+    ~WorkStealingRunner();
+
+    int getWorkers() const;
+
+    /**
+     * Executes the task for the indexes 0 to count - 1, and returns when all
+     * of them are done.
+     */
+    void run(Task & task, int count);
+
+private:
+    class Worker : public Thread {
+    public:
+        WorkStealingRunner *runner;
+        int id;
+        std::atomic<int> next;
+        int end;
+        void run();
+    };
+
+    Worker *workers;
+    int worker_count;
+    bool pinned;
+    Task *task;
+
+    bool steal(int & index);
+};
+
+}
+}
+}
+
+#endif